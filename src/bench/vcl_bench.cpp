@@ -0,0 +1,431 @@
+// Micro-benchmarks of the vcl kernels (no window nor OpenGL context is created)
+//
+// Usage: vcl_bench [--filter substring] [--min-time seconds] [--output file.json] [--check]
+//
+// The consistency checks (results of the optimized kernels against their reference) run before the benchmarks,
+// the program stops with an error if one of them fails. --check runs them only.
+// Each benchmark is repeated until it runs for at least min-time seconds.
+// The results are written as JSON (standard output by default):
+//  {"benchmarks":[{"name":..., "iterations":..., "ns_per_op":..., "items_per_op":..., "items_per_second":...}, ...]}
+// where an operation is one call of the benchmarked function, processing items_per_op items (vertices, nodes, products, etc).
+
+#include "vcl/vcl.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace vcl;
+
+
+// Keep a value computed by a benchmark from being optimized out
+template <typename T>
+static void do_not_optimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct benchmark_result
+{
+    std::string name;
+    size_t iterations;
+    double ns_per_op;
+    double items_per_op;
+};
+
+struct benchmark_runner
+{
+    std::string filter;
+    double min_time = 0.2;
+    std::vector<benchmark_result> results;
+
+    /** Time operation() (preceded by setup() at each iteration, not timed) until min_time is reached */
+    void run(const std::string& name, double items_per_op, const std::function<void()>& operation, const std::function<void()>& setup=nullptr);
+};
+
+void benchmark_runner::run(const std::string& name, double items_per_op, const std::function<void()>& operation, const std::function<void()>& setup)
+{
+    if(!filter.empty() && name.find(filter)==std::string::npos)
+        return;
+
+    typedef std::chrono::steady_clock clock;
+    size_t iterations = 0;
+    double duration = 0.0;
+
+    // Warm up (caches, first allocations)
+    if(setup) setup();
+    operation();
+
+    // Batches of doubling size: without setup, the clock is read once per batch
+    size_t batch = 1;
+    while(duration<min_time)
+    {
+        if(setup==nullptr) {
+            const clock::time_point start = clock::now();
+            for(size_t k=0; k<batch; ++k)
+                operation();
+            duration += std::chrono::duration<double>(clock::now()-start).count();
+        }
+        else {
+            for(size_t k=0; k<batch; ++k) {
+                setup();
+                const clock::time_point start = clock::now();
+                operation();
+                duration += std::chrono::duration<double>(clock::now()-start).count();
+            }
+        }
+        iterations += batch;
+        batch *= 2;
+    }
+
+    const benchmark_result result = {name, iterations, 1e9*duration/double(iterations), items_per_op};
+    results.push_back(result);
+    std::cerr<<name<<": "<<result.ns_per_op<<" ns/op ("<<iterations<<" iterations)"<<std::endl;
+}
+
+static std::string to_json(const std::vector<benchmark_result>& results)
+{
+    std::ostringstream s;
+    s<<"{\"benchmarks\":[\n";
+    for(size_t k=0; k<results.size(); ++k)
+    {
+        const benchmark_result& r = results[k];
+        char values[256];
+        std::snprintf(values, sizeof(values), "\"iterations\":%lu,\"ns_per_op\":%.3f,\"items_per_op\":%.0f,\"items_per_second\":%.6g",
+                      static_cast<unsigned long>(r.iterations), r.ns_per_op, r.items_per_op, r.items_per_op*1e9/r.ns_per_op);
+        s<<"{\"name\":\""<<r.name<<"\","<<values<<"}"<<(k+1<results.size()? ",\n" : "\n");
+    }
+    s<<"]}\n";
+    return s.str();
+}
+
+
+// perlin_grid and perlin_points must be bitwise equal to perlin() for every instruction set
+static bool check_perlin_batched()
+{
+    const perlin_simd initial = perlin_simd_current();
+    bool valid = true;
+    for(perlin_simd level : {perlin_simd::scalar, perlin_simd::sse2, perlin_simd::avx2})
+    {
+        if(int(level)>int(perlin_simd_supported()))
+            continue;
+        perlin_set_simd(level);
+
+        for(int octave : {1, 5, 9})
+        {
+            // Grids starting at 0 (floor of -1 at the corner) and at negative coordinates, with a width which is not a multiple of 4
+            for(float origin : {0.0f, -3.7f})
+            {
+                buffer2D<float> grid(123, 45);
+                perlin_grid(grid, origin, origin, 0.05f, 0.07f, octave, 0.4f, 2.0f);
+                for(size_t kv=0; kv<grid.dimension[1]; ++kv)
+                    for(size_t ku=0; ku<grid.dimension[0]; ++ku) {
+                        const float expected = perlin(origin+ku*0.05f, origin+kv*0.07f, octave, 0.4f, 2.0f);
+                        valid = valid && std::memcmp(&expected, &grid(ku,kv), sizeof(float))==0;
+                    }
+            }
+
+            buffer<vec2> p(1001);
+            for(size_t k=0; k<p.size(); ++k)
+                p[k] = {0.37f*float(k%41)-5.0f, 0.23f*float(k/41)-2.0f};
+            p[0] = {0.0f, 0.0f};
+            buffer<float> values;
+            perlin_points(p, values, octave, 0.4f, 2.0f);
+            for(size_t k=0; k<p.size(); ++k) {
+                const float expected = perlin(p[k].x, p[k].y, octave, 0.4f, 2.0f);
+                valid = valid && std::memcmp(&expected, &values[k], sizeof(float))==0;
+            }
+        }
+        if(!valid) {
+            std::cerr<<"perlin_grid/perlin_points differ from perlin() (instruction set "<<int(level)<<")"<<std::endl;
+            break;
+        }
+    }
+    perlin_set_simd(initial);
+    return valid;
+}
+
+static void bench_perlin(benchmark_runner& runner)
+{
+    // Batch of evaluations along a line: the coordinates change at every call
+    const size_t N = 1024;
+    for(int octave : {1, 5, 9})
+    {
+        const std::string suffix = "/octave:"+str(octave);
+        runner.run("perlin_1d"+suffix, N, [=]{
+            float sum = 0.0f;
+            for(size_t k=0; k<N; ++k)
+                sum += perlin(0.013f*k, octave);
+            do_not_optimize(sum);
+        });
+        runner.run("perlin_2d"+suffix, N, [=]{
+            float sum = 0.0f;
+            for(size_t k=0; k<N; ++k)
+                sum += perlin(0.013f*k, 0.7f+0.011f*k, octave);
+            do_not_optimize(sum);
+        });
+        runner.run("perlin_3d"+suffix, N, [=]{
+            float sum = 0.0f;
+            for(size_t k=0; k<N; ++k)
+                sum += perlin(0.013f*k, 0.7f+0.011f*k, 0.3f+0.017f*k, octave);
+            do_not_optimize(sum);
+        });
+    }
+}
+
+static void bench_normal(benchmark_runner& runner)
+{
+    for(size_t N : {100, 256, 512, 1024, 2048})
+    {
+        mesh grid = mesh_primitive_grid(N, N);
+        for(size_t k=0; k<grid.position.size(); ++k)
+            grid.position[k].z = 0.1f*std::sin(0.37f*float(k%N)) * std::cos(0.23f*float(k/N));
+
+        buffer<vec3> normals;
+        runner.run("normal/grid:"+str(N), double(grid.position.size()), [&]{
+            normal(grid.position, grid.connectivity, normals);
+            do_not_optimize(normals[0]);
+        });
+    }
+}
+
+static void bench_mesh(benchmark_runner& runner)
+{
+    for(size_t N : {10, 100})
+    {
+        const mesh sphere = mesh_primitive_sphere(1.0f, {0,0,0}, N, 2*N);
+        const size_t copies = 64;
+        mesh m;
+        runner.run("mesh_push_back/vertices:"+str(sphere.position.size())+"/copies:"+str(copies), double(copies*sphere.position.size()), [&]{
+            for(size_t k=0; k<copies; ++k)
+                m.push_back(sphere);
+            do_not_optimize(m.position[0]);
+        }, [&]{ m = mesh(); });
+    }
+
+    for(size_t N : {20, 200, 1000})
+    {
+        runner.run("mesh_primitive_sphere/Nu:"+str(N), double(2*N*N), [=]{
+            const mesh sphere = mesh_primitive_sphere(1.0f, {0,0,0}, N, 2*N);
+            do_not_optimize(sphere.position[0]);
+        });
+    }
+}
+
+static void bench_obj(benchmark_runner& runner)
+{
+    // The files are generated from spheres (positions, texture coordinates, normals)
+    for(size_t N : {20, 200})
+    {
+        const mesh sphere = mesh_primitive_sphere(1.0f, {0,0,0}, N, 2*N);
+        const std::string filename = "vcl_bench_sphere_"+str(N)+".obj";
+        {
+            std::ofstream stream(filename);
+            for(const vec3& p : sphere.position)   stream<<"v "<<p.x<<" "<<p.y<<" "<<p.z<<"\n";
+            for(const vec2& uv : sphere.texture_uv) stream<<"vt "<<uv.x<<" "<<uv.y<<"\n";
+            for(const vec3& n : sphere.normal)     stream<<"vn "<<n.x<<" "<<n.y<<" "<<n.z<<"\n";
+            for(const uint3& f : sphere.connectivity) {
+                stream<<"f";
+                for(size_t i=0; i<3; ++i)
+                    stream<<" "<<f[i]+1<<"/"<<f[i]+1<<"/"<<f[i]+1;
+                stream<<"\n";
+            }
+        }
+
+        // Text parsing (the binary cache is disabled), then reading from the binary cache
+        const std::string triangles = str(sphere.connectivity.size());
+        mesh_obj_cache_enable(false);
+        runner.run("mesh_load_file_obj/triangles:"+triangles, double(sphere.connectivity.size()), [&]{
+            const mesh m = mesh_load_file_obj(filename);
+            do_not_optimize(m.position[0]);
+        });
+        mesh_obj_cache_enable(true);
+        runner.run("mesh_load_file_obj_cached/triangles:"+triangles, double(sphere.connectivity.size()), [&]{
+            const mesh m = mesh_load_file_obj(filename);
+            do_not_optimize(m.position[0]);
+        });
+        runner.run("mesh_binary_file_open/triangles:"+triangles, double(sphere.connectivity.size()), [&]{
+            mesh_binary_file file;
+            file.open(mesh_obj_cache_filename(filename));
+            do_not_optimize(file.position);
+        });
+        std::remove(filename.c_str());
+        std::remove(mesh_obj_cache_filename(filename).c_str());
+    }
+}
+
+static void bench_texture(benchmark_runner& runner)
+{
+    // Smooth gradients with noise: the block compression works on varying colors
+    for(unsigned int N : {256, 1024})
+    {
+        image_raw im(N, N, image_color_type::rgba, std::vector<unsigned char>(4*size_t(N)*N));
+        for(size_t k=0; k<size_t(N)*N; ++k) {
+            const float u = float(k%N)/N, v = float(k/N)/N;
+            im.data[4*k+0] = static_cast<unsigned char>(255*u);
+            im.data[4*k+1] = static_cast<unsigned char>(255*v);
+            im.data[4*k+2] = static_cast<unsigned char>(127+127*perlin(8*u, 8*v, 3));
+            im.data[4*k+3] = 255;
+        }
+
+        const std::string size = "/size:"+str(N);
+        for(texture_format format : {texture_format::rgba8, texture_format::bc1, texture_format::bc3})
+        {
+            const std::string name = format==texture_format::rgba8? "rgba8" : (format==texture_format::bc1? "bc1" : "bc3");
+            runner.run("texture_build_mipmaps/"+name+size, double(N)*N, [&]{
+                const texture_mipmaps mipmaps = texture_build_mipmaps(im, format);
+                do_not_optimize(mipmaps.levels[0][0]);
+            });
+        }
+
+        // Startup cost of a texture: PNG decoding (then glGenerateMipmap) or mapping of the baked container
+        const std::string filename = "vcl_bench_texture_"+str(N)+".png";
+        image_save_png(filename, im);
+        runner.run("image_load_png"+size, double(N)*N, [&]{
+            const image_raw loaded = image_load_png(filename);
+            do_not_optimize(loaded.data[0]);
+        });
+        texture_file container;
+        texture_load_file_png(filename, true, container);
+        container.close();
+        runner.run("texture_file_open"+size, double(N)*N, [&]{
+            texture_file file;
+            file.open(texture_cache_filename(filename));
+            size_t sum = 0;
+            for(unsigned int k=0; k<file.level_count(); ++k)
+                for(size_t i=0; i<file.level_size(k); i+=64)
+                    sum += file.level(k)[i];
+            do_not_optimize(sum);
+        });
+        std::remove(filename.c_str());
+        std::remove(texture_cache_filename(filename).c_str());
+    }
+}
+
+static void bench_hierarchy(benchmark_runner& runner)
+{
+    // Chains of 8 nodes attached to the root frame: depth of a typical articulated character
+    for(size_t N : {64, 1024})
+    {
+        hierarchy_mesh_drawable hierarchy;
+        const mesh_drawable element; // No GPU data: the update doesn't use OpenGL
+        for(size_t k=0; k<N; ++k) {
+            const std::string parent = (k%8==0)? "global_frame" : "node"+str(k-1);
+            hierarchy.add(element, "node"+str(k), parent, affine_transform({0.1f,0,0}, rotation_from_axis_angle_mat3({0,0,1}, 0.01f*k)));
+        }
+
+        runner.run("hierarchy_update/all_dirty/nodes:"+str(N), double(N), [&]{
+            hierarchy.mark_all_dirty();
+            hierarchy.update_local_to_global_coordinates();
+            do_not_optimize(hierarchy.elements[N-1].global_transform);
+        });
+        // Items are the N nodes visited by the update (8 of them are recomputed): comparable with all_dirty
+        runner.run("hierarchy_update/one_root_dirty/nodes:"+str(N), double(N), [&]{
+            hierarchy.node(0).transform.rotation = rotation_from_axis_angle_mat3({0,0,1}, 0.5f);
+            hierarchy.update_local_to_global_coordinates();
+            do_not_optimize(hierarchy.elements[7].global_transform);
+        });
+    }
+}
+
+static void bench_transform(benchmark_runner& runner)
+{
+    const size_t N = 1024;
+    std::vector<affine_transform> transforms(N);
+    std::vector<mat3> m3(N);
+    std::vector<mat4> m4(N);
+    for(size_t k=0; k<N; ++k) {
+        transforms[k] = affine_transform({0.1f*k,0,1}, rotation_from_axis_angle_mat3(normalize(vec3{1,float(k),2}), 0.01f*k), 1.0f+0.001f*k);
+        m3[k] = transforms[k].rotation;
+        m4[k] = transforms[k].matrix();
+    }
+
+    runner.run("affine_transform_product", double(N), [&]{
+        affine_transform T;
+        for(size_t k=0; k<N; ++k)
+            T = T*transforms[k];
+        do_not_optimize(T);
+    });
+    runner.run("mat3_product", double(N), [&]{
+        mat3 M = mat3::identity();
+        for(size_t k=0; k<N; ++k)
+            M = M*m3[k];
+        do_not_optimize(M);
+    });
+    runner.run("mat4_product", double(N), [&]{
+        mat4 M = mat4::identity();
+        for(size_t k=0; k<N; ++k)
+            M = M*m4[k];
+        do_not_optimize(M);
+    });
+    runner.run("mat4_vec4_product", double(N), [&]{
+        vec4 sum = {0,0,0,0};
+        for(size_t k=0; k<N; ++k)
+            sum += m4[k]*vec4{1.0f,2.0f,3.0f,1.0f};
+        do_not_optimize(sum);
+    });
+}
+
+
+int main(int argc, char* argv[])
+{
+    benchmark_runner runner;
+    std::string output;
+    bool check_only = false;
+    for(int k=1; k<argc; ++k)
+    {
+        const std::string arg = argv[k];
+        const bool has_value = k+1<argc;
+        if(arg=="--filter" && has_value)
+            runner.filter = argv[++k];
+        else if(arg=="--min-time" && has_value)
+            runner.min_time = std::stod(argv[++k]);
+        else if(arg=="--output" && has_value)
+            output = argv[++k];
+        else if(arg=="--check")
+            check_only = true;
+        else {
+            std::cerr<<"Unknown or incomplete option ("<<arg<<")"<<std::endl;
+            std::cerr<<"Usage: vcl_bench [--filter substring] [--min-time seconds] [--output file.json] [--check]"<<std::endl;
+            return 1;
+        }
+    }
+
+    if(!check_perlin_batched())
+        return 1;
+    if(check_only)
+        return 0;
+
+    bench_perlin(runner);
+    bench_normal(runner);
+    bench_mesh(runner);
+    bench_obj(runner);
+    bench_texture(runner);
+    bench_hierarchy(runner);
+    bench_transform(runner);
+
+    const std::string json = to_json(runner.results);
+    if(output.empty())
+        std::cout<<json;
+    else {
+        std::ofstream stream(output);
+        if(!stream.is_open()) {
+            std::cerr<<"Cannot write "<<output<<std::endl;
+            return 1;
+        }
+        stream<<json;
+    }
+    return 0;
+}
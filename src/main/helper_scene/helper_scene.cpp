@@ -5,18 +5,67 @@
 using namespace vcl;
 
 
-GLFWwindow* create_window(const std::string& window_title)
+run_options parse_command_line(int argc, char* argv[])
+{
+    run_options options;
+    for(int k=1; k<argc; ++k)
+    {
+        const std::string arg = argv[k];
+        const bool has_value = k+1<argc;
+        if(arg=="--headless" && has_value) {
+            options.headless = true;
+            options.frame_count = std::stoi(argv[++k]);
+        }
+        else if(arg=="--time-step" && has_value)
+            options.time_step = std::stod(argv[++k]);
+        else if(arg=="--dump" && has_value)
+            options.dump_directory = argv[++k];
+        else if(arg=="--size" && has_value) {
+            const std::string size = argv[++k];
+            const size_t x = size.find('x');
+            if(x==std::string::npos) {
+                std::cerr<<"Incorrect size ("<<size<<"), expected WxH"<<std::endl;
+                exit(1);
+            }
+            options.width = std::stoi(size.substr(0,x));
+            options.height = std::stoi(size.substr(x+1));
+        }
+        else if(arg=="--context" && has_value)
+            options.context_api = argv[++k];
+        else if(arg=="--trace" && has_value)
+            options.trace_file = argv[++k];
+        else {
+            std::cerr<<"Unknown or incomplete option ("<<arg<<")"<<std::endl;
+            std::cerr<<"Usage: pgm [--headless N] [--time-step dt] [--dump directory] [--size WxH] [--context egl|osmesa] [--trace file.json]"<<std::endl;
+            exit(1);
+        }
+    }
+    return options;
+}
+
+GLFWwindow* create_window(const std::string& window_title, const run_options& options)
 {
     const int opengl_version_major = 3;
     const int opengl_version_minor = 3;
-    const int window_width  = 1280;
-    const int window_height = 1000;
 
-    GLFWwindow* window = vcl::glfw_create_window(window_width, window_height, window_title, opengl_version_major, opengl_version_minor);
+    // Offscreen rendering: the window only provides the OpenGL context
+    glfwWindowHint(GLFW_VISIBLE, options.headless? 0 : 1);
+#if defined(GLFW_CONTEXT_CREATION_API)
+    if(options.context_api=="egl")
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+#if defined(GLFW_OSMESA_CONTEXT_API)
+    else if(options.context_api=="osmesa")
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+    else if(!options.context_api.empty())
+        std::cerr<<"Context creation API ("<<options.context_api<<") not available: use the native one"<<std::endl;
+#endif
+
+    GLFWwindow* window = vcl::glfw_create_window(options.width, options.height, window_title, opengl_version_major, opengl_version_minor);
     return window;
 }
 
-void initialize_interface(gui_structure& gui)
+void initialize_interface(gui_structure& gui, const run_options& options)
 {
     std::cout<<"*** Init GLFW ***"<<std::endl;
     vcl::glfw_init();
@@ -25,7 +74,7 @@ void initialize_interface(gui_structure& gui)
 
     std::cout<<"*** Create window ***"<<std::endl;
     gui.window_title = "OpenGL Window";
-    gui.window = create_window(gui.window_title);
+    gui.window = create_window(gui.window_title, options);
     std::cout<<"\t [OK] Window Created"<<std::endl;
 
     std::cout<<"*** Init GLAD ***"<<std::endl;
@@ -53,6 +102,14 @@ void load_shaders(std::map<std::string,GLuint>& shaders)
     shaders["wireframe_quads"] = create_shader_program("scenes/shared_assets/shaders/wireframe_quads/shader.vert.glsl","scenes/shared_assets/shaders/wireframe_quads/shader.geom.glsl","scenes/shared_assets/shaders/wireframe_quads/shader.frag.glsl");
     shaders["curve"] = create_shader_program("scenes/shared_assets/shaders/curve/shader.vert.glsl","scenes/shared_assets/shaders/curve/shader.frag.glsl");
     shaders["segment_im"] = create_shader_program("scenes/shared_assets/shaders/segment_immediate_mode/shader.vert.glsl","scenes/shared_assets/shaders/segment_immediate_mode/shader.frag.glsl");
+    shaders["mesh_instanced"] = create_shader_program("scenes/shared_assets/shaders/mesh_instanced/shader.vert.glsl","scenes/shared_assets/shaders/mesh/shader.frag.glsl");
+    shaders["wireframe_instanced"] = create_shader_program("scenes/shared_assets/shaders/wireframe_instanced/shader.vert.glsl","scenes/shared_assets/shaders/wireframe/shader.geom.glsl","scenes/shared_assets/shaders/wireframe/shader.frag.glsl");
+    shaders["mesh_palette"] = create_shader_program("scenes/shared_assets/shaders/mesh_palette/shader.vert.glsl","scenes/shared_assets/shaders/mesh/shader.frag.glsl");
+    shaders["mesh_array"] = create_shader_program("scenes/shared_assets/shaders/mesh_array/shader.vert.glsl","scenes/shared_assets/shaders/mesh_array/shader.frag.glsl");
+    shaders["mesh_array_instanced"] = create_shader_program("scenes/shared_assets/shaders/mesh_array_instanced/shader.vert.glsl","scenes/shared_assets/shaders/mesh_array/shader.frag.glsl");
+    shaders["mesh_array_palette"] = create_shader_program("scenes/shared_assets/shaders/mesh_array_palette/shader.vert.glsl","scenes/shared_assets/shaders/mesh_array/shader.frag.glsl");
+    shaders["wireframe_palette"] = create_shader_program("scenes/shared_assets/shaders/wireframe_palette/shader.vert.glsl","scenes/shared_assets/shaders/wireframe/shader.geom.glsl","scenes/shared_assets/shaders/wireframe/shader.frag.glsl");
+    shaders["heightfield"] = create_shader_program("scenes/shared_assets/shaders/heightfield/shader.vert.glsl","scenes/shared_assets/shaders/mesh/shader.frag.glsl");
     shaders["normals"] = create_shader_program("scenes/shared_assets/shaders/normals/shader.vert.glsl","scenes/shared_assets/shaders/normals/shader.geom.glsl","scenes/shared_assets/shaders/normals/shader.frag.glsl");
 
     std::cout<<"\t [OK] Shader loaded"<<std::endl;
@@ -75,6 +132,7 @@ void setup_scene(scene_structure &scene, gui_structure& gui, const std::map<std:
 
     const image_raw white{1,1,image_color_type::rgba,{255,255,255,255}};
     scene.texture_white = create_texture_gpu(white);
+    scene.texture_white_array = create_texture_array_gpu(texture_array_build_mipmaps({white}, 1, 1, texture_format::rgba8));
 }
 
 void clear_screen()
@@ -82,7 +140,7 @@ void clear_screen()
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
     glClear(GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
+    gl_state().set_capability(GL_DEPTH_TEST, true);
 }
 
 void update_fps_title(GLFWwindow* window, const std::string& title, glfw_fps_counter& fps_counter)
@@ -104,6 +162,12 @@ void gui_start_basic_structure(gui_structure& gui, scene_structure& scene)
     ImGui::Text("Frame: "); ImGui::SameLine();
     ImGui::Checkbox("Camera", &gui.show_frame_camera); ImGui::SameLine();
     ImGui::Checkbox("Worldspace", &gui.show_frame_worldspace);
+    ImGui::Checkbox("Profiler", &gui.show_profiler);
+    if(!gui.trace_file.empty()) {
+        ImGui::SameLine();
+        if(ImGui::Button("Save trace"))
+            std::cout<<(vcl::trace_write_json(gui.trace_file)? "Trace saved in " : "Cannot write trace ")<<gui.trace_file<<std::endl;
+    }
     ImGui::Spacing();
 
     if(gui.show_frame_camera)
@@ -115,3 +179,35 @@ void gui_start_basic_structure(gui_structure& gui, scene_structure& scene)
         draw(scene.frame_worldspace, scene.camera);
 
 }
+
+void gui_profiler(const vcl::profiler& profiler)
+{
+    ImGui::Begin("Profiler",NULL,ImGuiWindowFlags_AlwaysAutoResize);
+    ImGui::Text("Times in ms over the last frames (GPU times are read %lu frames later)", static_cast<unsigned long>(vcl::profiler::latency));
+
+    ImGui::Columns(6, "profiler_columns");
+    ImGui::Text("Pass");           ImGui::NextColumn();
+    ImGui::Text("CPU min/avg/p99"); ImGui::NextColumn();
+    ImGui::Text("GPU min/avg/p99"); ImGui::NextColumn();
+    ImGui::Text("Frames");         ImGui::NextColumn();
+    ImGui::Text("Draw calls");     ImGui::NextColumn();
+    ImGui::Text("Triangles");      ImGui::NextColumn();
+    ImGui::Separator();
+
+    for(const vcl::profiler_zone_result& zone : profiler.results())
+    {
+        // Nested scopes are indented below their parent
+        ImGui::Text("%*s%s", 2*zone.depth, "", zone.name.c_str()); ImGui::NextColumn();
+        ImGui::Text("%.3f / %.3f / %.3f", double(zone.cpu.min), double(zone.cpu.average), double(zone.cpu.p99)); ImGui::NextColumn();
+        if(zone.gpu.samples>0)
+            ImGui::Text("%.3f / %.3f / %.3f", double(zone.gpu.min), double(zone.gpu.average), double(zone.gpu.p99));
+        else
+            ImGui::Text("-");
+        ImGui::NextColumn();
+        ImGui::Text("%lu", static_cast<unsigned long>(zone.cpu.samples)); ImGui::NextColumn();
+        ImGui::Text("%lu", zone.draw_calls); ImGui::NextColumn();
+        ImGui::Text("%lu", zone.triangles);  ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+    ImGui::End();
+}
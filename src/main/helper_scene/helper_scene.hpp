@@ -10,6 +10,8 @@ struct scene_structure
     vcl::mesh_drawable frame_camera;
     vcl::mesh_drawable frame_worldspace;
     GLuint texture_white;
+    GLuint texture_white_array; // Texture array with a single white layer
+    vcl::asset_loader assets; // Textures and meshes loaded in the background, uploaded at the beginning of each frame
 };
 
 struct gui_structure
@@ -19,13 +21,36 @@ struct gui_structure
 
     bool show_frame_camera     = true;
     bool show_frame_worldspace = false;
+    bool show_profiler         = false;
+    std::string trace_file;    // Chrome trace written on demand from the GUI (empty: tracing disabled)
+};
+
+// Options given on the command line
+//  --headless N       : render N frames offscreen (hidden window, framebuffer object) with a fixed time step, then exit
+//  --time-step dt     : time step of the simulated clock in headless mode (default 1/60 s)
+//  --dump directory   : save each headless frame as directory/frame_00000.png (the directory must exist)
+//  --size WxH         : size of the window/rendered images
+//  --context egl|osmesa : context creation API (ex. Mesa llvmpipe without display server, requires a GLFW built with it)
+//  --trace file.json  : record the trace zones from the start and write them as a Chrome trace (chrome://tracing, ui.perfetto.dev) at exit
+struct run_options
+{
+    bool headless = false;
+    int frame_count = 0;
+    double time_step = 1.0/60.0;
+    std::string dump_directory;
+    int width = 1280;
+    int height = 1000;
+    std::string context_api;
+    std::string trace_file;
 };
 
 
-GLFWwindow* create_window(const std::string& window_title);
-void initialize_interface(gui_structure& gui);
+run_options parse_command_line(int argc, char* argv[]);
+GLFWwindow* create_window(const std::string& window_title, const run_options& options);
+void initialize_interface(gui_structure& gui, const run_options& options);
 void load_shaders(std::map<std::string,GLuint>& shaders);
 void setup_scene(scene_structure &scene, gui_structure& gui, const std::map<std::string,GLuint>& shaders);
 void clear_screen();
 void update_fps_title(GLFWwindow* window, const std::string& title, vcl::glfw_fps_counter& fps_counter);
 void gui_start_basic_structure(gui_structure& gui, scene_structure& scene);
+void gui_profiler(const vcl::profiler& profiler);
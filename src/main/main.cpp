@@ -8,6 +8,9 @@
 // Include exercises
 #include "scenes/scenes.hpp"
 
+#include <chrono>
+#include <cstdio>
+
 
 
 // ************************************** //
@@ -37,12 +40,31 @@ void mouse_click_callback(GLFWwindow* window, int button, int action, int mods);
 void mouse_scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void keyboard_input_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 
+// Compute and draw one frame (the GUI is rendered only if render_gui is true)
+void display_frame(bool render_gui);
+// Render frames offscreen with the simulated clock (headless mode)
+void run_headless(const run_options& options, vcl::clock_fixed_step& clock);
+
 // ************************************** //
 // Start program
 // ************************************** //
 
-int main()
+int main(int argc, char* argv[])
 {
+    const run_options options = parse_command_line(argc, argv);
+
+    // Headless mode: the timers follow a simulated clock advancing by a fixed time step at each frame
+    vcl::clock_fixed_step clock(options.time_step);
+    if(options.headless)
+        vcl::set_clock(&clock);
+
+    // Trace zones recorded from the start, written at exit (and on demand from the GUI)
+    if(!options.trace_file.empty()) {
+        vcl::trace_enable(true);
+        vcl::trace_set_thread_name("main");
+        vcl::trace_write_json_at_exit(options.trace_file);
+        gui.trace_file = options.trace_file;
+    }
 
 
     // ************************************** //
@@ -50,7 +72,10 @@ int main()
     // ************************************** //
 
     // Initialize external libraries and window
-    initialize_interface(gui);
+    {
+        VCL_TRACE_ZONE("initialize_interface");
+        initialize_interface(gui, options);
+    }
 
     // Set GLFW events listener
     glfwSetCursorPosCallback(gui.window, cursor_position_callback );
@@ -59,13 +84,19 @@ int main()
     glfwSetKeyCallback(gui.window, keyboard_input_callback);
     glfwSetWindowSizeCallback(gui.window, window_size_callback);
 
-    load_shaders(shaders);
+    {
+        VCL_TRACE_ZONE("load_shaders");
+        load_shaders(shaders);
+    }
     setup_scene(scene, gui, shaders);
 
     opengl_debug();
     std::cout<<"*** Setup Data ***"<<std::endl;
     scene_current.setup_data(shaders, scene, gui);
     std::cout<<"\t [OK] Data setup"<<std::endl;
+    // Reproducible frames: every asset is on the GPU before the first one
+    if(options.headless)
+        scene.assets.finish();
     opengl_debug();
 
 
@@ -75,39 +106,28 @@ int main()
 
 
 
-    std::cout<<"*** Start GLFW animation loop ***"<<std::endl;
-    vcl::glfw_fps_counter fps_counter;
-    while( !glfwWindowShouldClose(gui.window) )
+    if(options.headless)
+        run_headless(options, clock);
+    else
     {
-        opengl_debug();
-
-        // Clear all color and zbuffer information before drawing on the screen
-        clear_screen();opengl_debug();
-        // Set a white image texture by default
-        glBindTexture(GL_TEXTURE_2D,scene.texture_white);
+        std::cout<<"*** Start GLFW animation loop ***"<<std::endl;
+        vcl::glfw_fps_counter fps_counter;
+        while( !glfwWindowShouldClose(gui.window) )
+        {
+            display_frame(true);
 
-        // Create the basic gui structure with ImGui
-        gui_start_basic_structure(gui,scene);
+            update_fps_title(gui.window, gui.window_title, fps_counter);
 
-        // Perform computation and draw calls for each iteration loop
-        scene_current.frame_draw(shaders, scene, gui); opengl_debug();
-
-
-        // Render GUI and update window
-        ImGui::End();
-        scene.camera_control.update = !(ImGui::IsAnyWindowFocused());
-        vcl::imgui_render_frame(gui.window);
-
-        update_fps_title(gui.window, gui.window_title, fps_counter);
-
-        glfwSwapBuffers(gui.window);
-        glfwPollEvents();
-        opengl_debug();
+            glfwSwapBuffers(gui.window);
+            glfwPollEvents();
+            opengl_debug();
 
+        }
+        std::cout<<"*** Stop GLFW loop ***"<<std::endl;
     }
-    std::cout<<"*** Stop GLFW loop ***"<<std::endl;
 
     // Cleanup ImGui and GLFW
+    vcl::frame_profiler().clear();
     vcl::imgui_cleanup();
 
     glfwDestroyWindow(gui.window);
@@ -116,6 +136,86 @@ int main()
     return 0;
 }
 
+void display_frame(bool render_gui)
+{
+    VCL_TRACE_ZONE("display_frame");
+    opengl_debug();
+    vcl::gl_state().new_frame();
+    vcl::profiler& profiler = vcl::frame_profiler();
+    profiler.new_frame();
+    profiler.begin("Frame");
+
+    // Send to the GPU the assets finished by the workers (a bounded amount per frame)
+    if(scene.assets.pending()>0) {
+        profiler.begin("Asset upload");
+        scene.assets.upload();
+        profiler.end();
+    }
+
+    // Clear all color and zbuffer information before drawing on the screen
+    clear_screen();opengl_debug();
+    // Set a white image texture by default
+    vcl::gl_state().bind_texture(GL_TEXTURE_2D,scene.texture_white);
+    // Send the camera once for all the shaders using the camera_data uniform block
+    vcl::update_camera_uniform_buffer(scene.camera); opengl_debug();
+
+    // Create the basic gui structure with ImGui
+    gui_start_basic_structure(gui,scene);
+
+    // Perform computation and draw calls for each iteration loop
+    profiler.begin("Scene");
+    scene_current.frame_draw(shaders, scene, gui); opengl_debug();
+    profiler.end();
+
+
+    // Render GUI
+    ImGui::End();
+    if(gui.show_profiler)
+        gui_profiler(profiler);
+    scene.camera_control.update = !(ImGui::IsAnyWindowFocused());
+    profiler.begin("GUI");
+    if(render_gui)
+        vcl::imgui_render_frame(gui.window);
+    else
+        ImGui::EndFrame();
+    profiler.end();
+    // ImGui changes the OpenGL state behind the cache
+    vcl::gl_state().invalidate();
+
+    profiler.end();
+}
+
+void run_headless(const run_options& options, vcl::clock_fixed_step& clock)
+{
+    std::cout<<"*** Start headless rendering ("<<options.frame_count<<" frames, "<<options.width<<"x"<<options.height<<", time step "<<options.time_step<<"s) ***"<<std::endl;
+    vcl::framebuffer target(options.width, options.height);
+
+    const auto time_start = std::chrono::steady_clock::now();
+    for(int frame=0; frame<options.frame_count; ++frame)
+    {
+        clock.advance();
+
+        vcl::bind(target);
+        display_frame(false);
+
+        if(!options.dump_directory.empty()) {
+            char filename[32];
+            std::snprintf(filename, sizeof(filename), "/frame_%05d.png", frame);
+            vcl::image_save_png(options.dump_directory+filename, vcl::read_pixels(target));
+        }
+    }
+    glFinish();
+    const double duration = std::chrono::duration<double>(std::chrono::steady_clock::now()-time_start).count();
+
+    std::cout<<"*** Stop headless rendering ***"<<std::endl;
+    std::cout<<"\t "<<options.frame_count<<" frames in "<<duration<<"s";
+    if(options.frame_count>0)
+        std::cout<<" ("<<1000.0*duration/options.frame_count<<" ms/frame"<<(options.dump_directory.empty()? "" : ", including PNG export")<<")";
+    std::cout<<std::endl;
+
+    target.clear();
+}
+
 void window_size_callback(GLFWwindow* /*window*/, int width, int height)
 {
     glViewport(0, 0, width, height);
@@ -9,15 +9,16 @@ using namespace vcl;
 
 
 
-static size_t index_at_value(float t, const vcl::buffer<vec3t>& v);
-static vec3 cardinal_spline_interpolation(float t, float t0, float t1, float t2, float t3, const vec3& p0, const vec3& p1, const vec3& p2, const vec3& p3, float K);
-static vec3 cardinal_spline_interpolation_der(float t, float t0, float t1, float t2, float t3, const vec3& p0, const vec3& p1, const vec3& p2, const vec3& p3, float K);
+static keyframe_curve create_trajectory(const vcl::buffer<vec3t>& keyframes);
 
 
 
 float evaluate_perlin_terrain_z(float u, float v, const gui_scene_structure& gui_scene);
 vec3 evaluate_perlin_terrain(float u, float v, const gui_scene_structure& gui_scene);
-mesh create_terrain(const gui_scene_structure& gui_scene);
+mesh create_terrain(size_t N, const gui_scene_structure& gui_scene);
+void update_terrain_position(buffer<vec3>& position, buffer2D<float>& noise, size_t N, const gui_scene_structure& gui_scene);
+bounding_volume terrain_bounding_volume(const gui_scene_structure& gui_scene);
+void update_wave_height(buffer<vec3>& position, buffer<vec2>& samples, buffer<float>& noise, const gui_scene_structure& gui_scene);
 vec3 evaluate_perlin_island(float u, float v, const gui_scene_structure& gui_scene);
 mesh create_island(const gui_scene_structure& gui_scene);
 mesh create_box(float hight, float width, float length);
@@ -35,9 +36,25 @@ hierarchy_mesh_drawable create_plane();
 /** This function is called before the beginning of the animation loop
     It is used to initialize all part-specific data */
 void scene_model::setup_data(std::map<std::string,GLuint>& shaders, scene_structure& scene, gui_structure& ){
-    
-    update_terrain();
-    update_island();
+    VCL_TRACE_ZONE("setup_data");
+
+    // Create the sea surface once: only its positions and normals are updated afterwards
+    terrain_cpu = create_terrain(N_terrain, gui_scene);
+    terrain = mesh_drawable(terrain_cpu);
+    terrain.uniform.color = { 1.0f, 1.0f, 1.0f };
+    terrain.uniform.shading.specular = 0.0f;
+
+    // GPU version: unbounded sea made of nested grids following the camera, the waves are added in the vertex shader
+    // Same noise coordinates and texture coordinates as the CPU grid: (x,y) in [-10,10] -> (u,v) in [0,1]
+    // The levels beyond the skybox would be hidden by it: the coarsest one reaches its walls
+    const unsigned int N_ocean_level = clipmap_level_count(N_ocean_grid, ocean_spacing, sky_size / 2);
+    ocean = clipmap_drawable(N_ocean_level, N_ocean_grid, ocean_spacing, 1 / 20.0f, shaders["heightfield"]);
+    ocean.uniform = terrain.uniform;
+    ocean.heightfield.uv_scale = { 1 / 20.0f, 1 / 20.0f };
+    ocean.heightfield.uv_offset = { 0.5f, 0.5f };
+    ocean.heightfield.texture_uv_offset = { 0.5f, 0.5f };
+
+    update_island(scene.assets);
 
     // Create moving creature
     creature = create_creature();
@@ -46,18 +63,48 @@ void scene_model::setup_data(std::map<std::string,GLuint>& shaders, scene_struct
     // Create moving plane
     plane = create_plane();
     plane.set_shader_for_all_elements(shaders["mesh"]);
+
+    // Nodes modified at every frame by the animation
+    creature_node.bigbody = creature.index("bigbody");
+    creature_node.shoulder_left = creature.index("shoulder_left");
+    creature_node.arm_bottom_left = creature.index("arm_bottom_left");
+    creature_node.shoulder_right = creature.index("shoulder_right");
+    creature_node.arm_bottom_right = creature.index("arm_bottom_right");
+    creature_node.leg_left = creature.index("leg_left");
+    creature_node.leg2_left = creature.index("leg2_left");
+    creature_node.leg3_left = creature.index("leg3_left");
+    creature_node.leg_right = creature.index("leg_right");
+    creature_node.leg2_right = creature.index("leg2_right");
+    creature_node.leg3_right = creature.index("leg3_right");
+    plane_bigbody = plane.index("bigbody");
+
+    // All the nodes are drawn in a single call: the global transforms are sent as a matrix palette
+    creature_palette = hierarchy_mesh_palette_drawable(creature, 1, shaders["mesh_array_palette"]);
+    plane_palette = hierarchy_mesh_palette_drawable(plane, 1, shaders["mesh_array_palette"]);
+    creature_palette.uniform.texture_layer = layer_metal;
+    plane_palette.uniform.texture_layer = layer_metal;
      
     // Create boat
     boat = create_boat(5.f, 2.f, 1.f);
     boat.uniform.shading = { 1,0,0 };
+    boat.uniform.texture_layer = layer_boat;
 
     // Create flag
     flag = create_flag(4.f, 4.f);
     flag.uniform.shading = { 1,0,0 };
+    flag.uniform.texture_layer = layer_flag;
+    const mat3 R_boat = rotation_from_axis_angle_mat3({ 0,1,0 }, 3.14f / 6.0f);
+    instances.clear();
+    instances.push_back(mesh_instance(vec3{ -6,-6,0 }, R_boat));
+    instances.push_back(mesh_instance(vec3{ -5,-6,-1 }, R_boat));
+    instances.push_back(mesh_instance(vec3{ -6,-6.3f,0 }, R_boat));
+    instances.push_back(mesh_instance(vec3{ -5,-6.3f,-1 }, R_boat));
+    flag.update_instances(instances);
 
     // Create missle
     missle = create_missle(0.1f, 1.0f);
     missle.uniform.shading = {1,0,0};
+    missle.uniform.texture_layer = layer_metal;
 
     // Create fish
     fish = create_fish(0.2f, 0.4f);
@@ -68,9 +115,10 @@ void scene_model::setup_data(std::map<std::string,GLuint>& shaders, scene_struct
     const vec3 cylin_col = { 0.87f, 0.72f, 0.52f };
     box = create_box(0.1f, 0.4f, 1.0f);
     box.uniform.shading.specular = 0.0f;
+    box.uniform.texture_layer = layer_box;
     
     // Create skybox
-    sky = mesh_drawable(create_sky(50));
+    sky = mesh_drawable(create_sky(sky_size));
     sky.uniform.shading = { 1,0,0 };
     sky.uniform.color = { 1.0f,1.0f,1.0f };
     sky.uniform.transform.translation = vec3(0, 0, -25.0);
@@ -93,15 +141,20 @@ void scene_model::setup_data(std::map<std::string,GLuint>& shaders, scene_struct
     }
 
     
-    // Load a texture image on GPU and stores its ID
-    texture_id = create_texture_gpu(image_load_png("scenes/3D_graphics/02_texture/assets/sea2.png"));
-    island_id = create_texture_gpu(image_load_png("scenes/3D_graphics/02_texture/assets/island.png"), GL_REPEAT, GL_REPEAT);
-    box_id = create_texture_gpu(image_load_png("scenes/3D_graphics/02_texture/assets/box.png"), GL_REPEAT, GL_REPEAT);
-    boat_id = create_texture_gpu(image_load_png("scenes/3D_graphics/02_texture/assets/boat.png"), GL_REPEAT, GL_REPEAT);
-    flag_id = create_texture_gpu(image_load_png("scenes/3D_graphics/02_texture/assets/flag.png"), GL_REPEAT, GL_REPEAT);
-    fish_id = create_texture_gpu(image_load_png("scenes/3D_graphics/02_texture/assets/fish.png"), GL_REPEAT, GL_REPEAT);
-    skybox_id = create_texture_gpu(image_load_png("scenes/3D_graphics/02_texture/assets/skybox.png"));
-    metal_id = create_texture_gpu(image_load_png("scenes/3D_graphics/02_texture/assets/metal2.png"), GL_REPEAT, GL_REPEAT);
+    // Objects submitted without texture use the white image
+    queue.default_texture = scene.texture_white;
+    queue.default_texture_array = scene.texture_white_array;
+
+    // Decode the texture images on the worker threads, they are sent to the GPU by the main loop once ready
+    sea_texture = scene.assets.load_texture("scenes/3D_graphics/02_texture/assets/sea2.png", GL_MIRRORED_REPEAT, GL_MIRRORED_REPEAT);
+    fish_texture = scene.assets.load_texture("scenes/3D_graphics/02_texture/assets/fish.png", GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE); // avoids sampling artifacts
+    skybox_texture = scene.assets.load_texture("scenes/3D_graphics/02_texture/assets/skybox.png");
+    // The repeated materials (500 to 800 texels wide) are resampled to the same size, in the order of material_layer
+    materials = scene.assets.load_texture_array({"scenes/3D_graphics/02_texture/assets/island.png",
+                                                 "scenes/3D_graphics/02_texture/assets/boat.png",
+                                                 "scenes/3D_graphics/02_texture/assets/box.png",
+                                                 "scenes/3D_graphics/02_texture/assets/flag.png",
+                                                 "scenes/3D_graphics/02_texture/assets/metal2.png"}, 512, 512, GL_REPEAT, GL_REPEAT);
 
     
     // Set different timers
@@ -112,6 +165,8 @@ void scene_model::setup_data(std::map<std::string,GLuint>& shaders, scene_struct
     timer_height.t_max = 200;
     timer_height.t = timer_height.t_min;
     timer_missle.periodic_event_time_step = 1.2f;
+    particles.set_capacity(64);
+    particles.z_min = -1.0f;
 
     
     // Set animation of creature/plane
@@ -130,6 +185,10 @@ void scene_model::setup_data(std::map<std::string,GLuint>& shaders, scene_struct
 /** This function is called at each frame of the animation loop.
     It is used to compute time-varying argument and perform data data drawing */
 void scene_model::frame_draw(std::map<std::string,GLuint>& shaders, scene_structure& scene, gui_structure& ) {
+    VCL_TRACE_ZONE("frame_draw");
+
+    profiler& frame = frame_profiler();
+    frame.begin("Animation");
 
     // Update Timer
     const float eps = 1;
@@ -156,173 +215,156 @@ void scene_model::frame_draw(std::map<std::string,GLuint>& shaders, scene_struct
     set_gui();
 
 
-    // Draw terrain
-    glEnable( GL_POLYGON_OFFSET_FILL ); // avoids z-fighting when displaying wireframe
-    // Before displaying a textured surface: bind the associated texture id
-    // After the surface is displayed it is safe to set the texture id to a white image
-    // Avoids to use the previous texture for another object
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-    glPolygonOffset( 1.0, 1.0 );
-    draw(terrain, scene.camera, shaders["mesh"]);
-    glBindTexture(GL_TEXTURE_2D, scene.texture_white);
-
-    // Draw Island
-    glBindTexture(GL_TEXTURE_2D, island_id);
-    draw(island, scene.camera, shaders["mesh"]);
-    glBindTexture(GL_TEXTURE_2D, scene.texture_white);
-
-    // Draw Boat
-    glBindTexture(GL_TEXTURE_2D, boat_id);
-    boat.uniform.transform.translation = vec3{-6,-6,0};
-    mat3 R_boat = rotation_from_axis_angle_mat3({0,1,0}, 3.14f/6.0f);
-    boat.uniform.transform.rotation = R_boat;
-    draw(boat, scene.camera, shaders["mesh"]);
-    glBindTexture(GL_TEXTURE_2D, scene.texture_white);
-
-    // Draw Floating Box
-    glBindTexture(GL_TEXTURE_2D, box_id);
-    for (int i = 0; i < N_box; ++i) {
-        box.uniform.transform.translation = box_position[i];
-        draw(box, scene.camera, shaders["mesh"]);
-    }
-    glBindTexture(GL_TEXTURE_2D, scene.texture_white);
-    
-    // Draw Flag
-    glBindTexture(GL_TEXTURE_2D, flag_id);
-    flag.uniform.transform.rotation = R_boat;
-    flag.uniform.transform.translation = vec3{-6,-6,0};
-    draw(flag, scene.camera, shaders["mesh"]);
-    flag.uniform.transform.translation = vec3{ -5,-6,-1 };
-    draw(flag, scene.camera, shaders["mesh"]);
-    flag.uniform.transform.translation = vec3{ -6,-6.3,0 };
-    draw(flag, scene.camera, shaders["mesh"]);
-    flag.uniform.transform.translation = vec3{ -5,-6.3,-1 };
-    draw(flag, scene.camera, shaders["mesh"]);
-    glBindTexture(GL_TEXTURE_2D, scene.texture_white);
-    
-    // Draw skybox
-    glBindTexture(GL_TEXTURE_2D, skybox_id);
-    draw(sky, scene.camera, shaders["mesh"]);
-    glBindTexture(GL_TEXTURE_2D, scene.texture_white);
-    
-    // Draw Fish
-    // Enable use of alpha component as color blending for transparent elements
-    // new color = previous color + (1-alpha) current color
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-    // Disable depth buffer writing
-    //  - Transparent elements cannot use depth buffer
-    //  - They are supposed to be display from furest to nearest elements
-    glDepthMask(false);
-
-    glBindTexture(GL_TEXTURE_2D, fish_id);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // avoids sampling artifacts
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); // avoids sampling artifacts
-    fish.uniform.transform.rotation = scene.camera.orientation;
-    for (int i = 0; i < N_fish; ++i) {
-        fish.uniform.transform.translation = fish_position[i];
-        draw(fish, scene.camera, shaders["mesh"]);
-    }
-    glBindTexture(GL_TEXTURE_2D, scene.texture_white);
-
-
     // Update Position with wave
-    update_terrain();
     update_box();
     update_fish();
-    
+
     // Set animation of creature/plane/missle
     set_creature_rotation(t_creature);
     const vec3 p_der = set_plane_rotation(t_plane);
     set_missle_animation(p_der);
+    creature_palette.update_palette(creature);
+    creature_palette.upload_palette();
+    plane_palette.update_palette(plane);
+    plane_palette.upload_palette();
+    frame.end();
+
+    // Only the instances in the view frustum are sent to the GPU
+    frame.begin("Queue build");
+    queue.clear();
+    const frustum view_frustum = camera_frustum(scene.camera);
+
+    instances.resize(box_position.size());
+    for (size_t i = 0; i < box_position.size(); ++i)
+        instances[i] = mesh_instance(box_position[i]);
+    cull_instances(instances, box.data.bounds, box.uniform.transform, view_frustum, queue.counters);
+    box.update_instances(instances);
+
+    instances.resize(fish_position.size());
+    for (size_t i = 0; i < fish_position.size(); ++i)
+        instances[i] = mesh_instance(fish_position[i], scene.camera.orientation);
+    // Transparent billboards are blended from the furthest to the nearest one
+    // (sorted before culling: the full set keeps the same order from one frame to the next)
+    fish_sort.sort(instances, scene.camera, fish.uniform.transform);
+    cull_instances(instances, fish.data.bounds, fish.uniform.transform, view_frustum, queue.counters);
+    fish.update_instances(instances);
 
-    //Draw creature/plane/missle
-    glBindTexture(GL_TEXTURE_2D, metal_id);
-    draw(creature, scene.camera, shaders["mesh"]);
-    draw(plane, scene.camera, shaders["mesh"]);
-    draw(missle, scene.camera, shaders["mesh"]);
-    glBindTexture(GL_TEXTURE_2D, scene.texture_white);
-
-    // Finally
-    // Wireframe if asked from the GUI
+    boat.uniform.transform.translation = vec3{-6,-6,0};
+    boat.uniform.transform.rotation = rotation_from_axis_angle_mat3({0,1,0}, 3.14f/6.0f);
+
+
+    // Submit all the objects to the render queue
+    // The queue draws the opaque objects grouped by shader/texture/VAO, then the transparent ones from back to front
+    const bool draw_ocean = gui_scene.gpu_waves && !gui_scene.wireframe;
+    if (draw_ocean) {
+        // Only the noise parameters are sent: no vertex data is uploaded
+        ocean.heightfield.height = gui_scene.height;
+        ocean.heightfield.noise_scaling = gui_scene.scaling;
+        ocean.heightfield.octave = gui_scene.octave;
+        ocean.heightfield.persistency = gui_scene.persistency;
+        ocean.texture_id = sea_texture->id;
+    }
+    else {
+        frame.begin("Terrain update");
+        update_terrain();
+        frame.end();
+        queue.submit(terrain, shaders["mesh"], sea_texture->id);
+    }
+    // The materials of the array are bound once for all these objects, each one reads its own layer
+    const render_texture material_array(GL_TEXTURE_2D_ARRAY, materials->id);
+    if (island->ready())
+        queue.submit(island->drawable, shaders["mesh_array"], material_array);
+    queue.submit(boat, shaders["mesh_array"], material_array);
+    queue.submit(box, shaders["mesh_array_instanced"], material_array);
+    queue.submit(flag, shaders["mesh_array_instanced"], material_array);
+    queue.submit(creature_palette, shaders["mesh_array_palette"], material_array);
+    queue.submit(plane_palette, shaders["mesh_array_palette"], material_array);
+    queue.submit(missle, shaders["mesh_array_instanced"], material_array);
+    queue.submit(sky, shaders["mesh"], skybox_texture->id);
+    // Transparent billboards: blended with alpha, without writing the depth buffer
+    queue.submit(fish, shaders["mesh_instanced"], fish_texture->id, render_blend::alpha);
+    queue.sort(scene.camera);
+    frame.end();
+
+    gl_state().set_capability(GL_POLYGON_OFFSET_FILL, true); // avoids z-fighting when displaying wireframe
+    gl_state().polygon_offset( 1.0, 1.0 );
+    frame.begin("Opaque");
+    if (draw_ocean) // Opaque, drawn before the transparent objects of the queue
+        draw(ocean, scene.camera);
+    draw(queue, scene.camera, render_blend::opaque);
+    frame.end();
+
+    frame.begin("Transparent");
+    draw(queue, scene.camera, render_blend::alpha);
+    frame.end();
+
+    // Wireframe if asked from the GUI: replay the same list with the wireframe shaders
     if (gui_scene.wireframe) {
-        glPolygonOffset(1.0, 1.0);
-        draw(terrain, scene.camera, shaders["wireframe"]);
-        draw(island, scene.camera, shaders["wireframe"]);
-        draw(boat, scene.camera, shaders["wireframe"]);
-        flag.uniform.transform.translation = vec3{ -6,-6,0 };
-        draw(flag, scene.camera, shaders["wireframe"]);
-        flag.uniform.transform.translation = vec3{ -5,-6,-1 };
-        draw(flag, scene.camera, shaders["wireframe"]);
-        flag.uniform.transform.translation = vec3{ -6,-6.3,0 };
-        draw(flag, scene.camera, shaders["wireframe"]);
-        flag.uniform.transform.translation = vec3{ -5,-6.3,-1 };
-        draw(flag, scene.camera, shaders["wireframe"]);
-        draw(sky, scene.camera, shaders["wireframe"]);
-        draw(creature, scene.camera, shaders["wireframe"]);
-        draw(plane, scene.camera, shaders["wireframe"]);
-        draw(missle, scene.camera, shaders["wireframe"]);
-        for (int i = 0; i < N_box; ++i) {
-            box.uniform.transform.translation = box_position[i];
-            draw(box, scene.camera, shaders["wireframe"]);
-        }
-        for (int i = 0; i < N_fish; ++i) {
-            fish.uniform.transform.translation = fish_position[i];
-            draw(fish, scene.camera, shaders["wireframe"]);
-        }
+        frame.begin("Wireframe");
+        draw(queue, scene.camera, shaders["wireframe"], shaders["wireframe_instanced"], shaders["wireframe_palette"]);
+        frame.end();
     }
-    
-        
-    glDepthMask(true);
+
+    gl_state().bind_texture(GL_TEXTURE_2D, scene.texture_white);
 }
 
 
 void scene_model::update_terrain() {
+    VCL_TRACE_ZONE("update_terrain");
 
-    // Clear memory in case of pre-existing terrain
-    terrain.clear();
+    // Grid connectivity and texture coordinates are fixed: only rewrite positions and normals in place
+    update_terrain_position(terrain_cpu.position, terrain_noise, N_terrain, gui_scene);
+    // Regular grid: normals from central differences, no loop over the triangles
+    normal_grid(terrain_cpu.position, N_terrain, N_terrain, terrain_cpu.normal);
 
-    // Create visual terrain surface
-    terrain = create_terrain(gui_scene);
-    terrain.uniform.color = { 1.0f, 1.0f, 1.0f };
-    terrain.uniform.shading.specular = 0.0f;
+    // Update the existing VBO (no new allocation on the GPU)
+    // The bounds only depend on the wave parameters: the positions are not scanned again
+    terrain.update_position(terrain_cpu.position, terrain_bounding_volume(gui_scene));
+    terrain.update_normal(terrain_cpu.normal);
 }
 
 
-void scene_model::update_island() {
+void scene_model::update_island(asset_loader& assets) {
+    VCL_TRACE_ZONE("update_island");
 
     // Clear memory in case of pre-existing terrain
-    island.clear();
-
-    // Create visual terrain surface
-    island = create_island(gui_scene);
-    island.uniform.color = { 1.0f, 1.0f, 1.0f };
-    island.uniform.shading.specular = 0.0f;
+    if (island)
+        island->drawable.clear();
+
+    // Create visual terrain surface on a worker thread (with a copy of the current parameters)
+    const gui_scene_structure parameters = gui_scene;
+    island = assets.load_mesh([parameters]{ return create_island(parameters); });
+    island->drawable.uniform.color = { 1.0f, 1.0f, 1.0f };
+    island->drawable.uniform.shading.specular = 0.0f;
+    island->drawable.uniform.texture_layer = layer_island;
 }
 
 
 void scene_model::update_box() {
-    
-    for (int i = 0; i < N_box; ++i) {
-        float u = box_position[i][0];
-        float v = box_position[i][1];
-        vec3 pos = { u, v,  evaluate_perlin_terrain_z(u/20+0.5f,v/20+0.5f,gui_scene) };
-        box_position[i] = pos;
-    }
+    update_wave_height(box_position, wave_samples, wave_noise, gui_scene);
 }
 
 
 void scene_model::update_fish() {
+    update_wave_height(fish_position, wave_samples, wave_noise, gui_scene);
+}
 
-    for (int i = 0; i < N_fish; ++i) {
-        float u = fish_position[i][0];
-        float v = fish_position[i][1];
-        vec3 pos = { u, v,  evaluate_perlin_terrain_z(u / 20 + 0.5f,v / 20 + 0.5f,gui_scene) };
-        fish_position[i] = pos;
+
+// Set the z coordinate of all positions on the wave surface (single batched Perlin evaluation)
+void update_wave_height(buffer<vec3>& position, buffer<vec2>& samples, buffer<float>& noise, const gui_scene_structure& gui_scene) {
+
+    const size_t N = position.size();
+    const float scaling = gui_scene.scaling;
+    samples.resize(N);
+    for (size_t k = 0; k < N; ++k) {
+        const float u = position[k].x / 20 + 0.5f;
+        const float v = position[k].y / 20 + 0.5f;
+        samples[k] = { scaling * u, scaling * v };
     }
+
+    perlin_points(samples, noise, gui_scene.octave, gui_scene.persistency);
+    for (size_t k = 0; k < N; ++k)
+        position[k].z = gui_scene.height * noise[k];
 }
 
 
@@ -350,27 +392,58 @@ vec3 evaluate_perlin_terrain(float u, float v, const gui_scene_structure& gui_sc
 }
 
 
+// Fill the N x N terrain positions for the current wave parameters
+// The noise of the whole grid is evaluated in a single batched call
+void update_terrain_position(buffer<vec3>& position, buffer2D<float>& noise, size_t N, const gui_scene_structure& gui_scene) {
+
+    assert(position.size() == N * N);
+    const float du = gui_scene.scaling / (N - 1.0f);
+    noise.resize(N, N);
+    perlin_grid(noise, 0.0f, 0.0f, du, du, gui_scene.octave, gui_scene.persistency);
+
+    parallel_for(0, N, 16, [&](size_t ku_begin, size_t ku_end) {
+        for(size_t ku=ku_begin; ku<ku_end; ++ku) {
+            for(size_t kv=0; kv<N; ++kv) {
+                // Compute local parametric coordinates (u,v) \in [0,1]
+                const float u = ku/(N-1.0f);
+                const float v = kv/(N-1.0f);
+
+                position[kv + N * ku] = { 20 * (u - 0.5f), 20 * (v - 0.5f), gui_scene.height * noise(ku, kv) };
+            }
+        }
+    });
+}
+
+
+// Volume enclosing the terrain for any noise value: (x,y) in [-10,10], z between 0 and height times the maximal Perlin value
+bounding_volume terrain_bounding_volume(const gui_scene_structure& gui_scene) {
+
+    float amplitude = 0.0f;
+    float a = 1.0f;
+    for (int k = 0; k < gui_scene.octave; ++k) {
+        amplitude += a;
+        a *= std::abs(gui_scene.persistency);
+    }
+    const float z0 = std::min(0.0f, gui_scene.height * amplitude);
+    const float z1 = std::max(0.0f, gui_scene.height * amplitude);
+    return bounding_volume({ 0, 0, (z0 + z1) / 2 }, { 10, 10, (z1 - z0) / 2 });
+}
+
+
 // Generate terrain mesh
-mesh create_terrain(const gui_scene_structure& gui_scene) {
+mesh create_terrain(size_t N, const gui_scene_structure& gui_scene) {
 
     // Number of samples of the terrain is N x N
-    const size_t N = 100;
-
     mesh terrain; // temporary terrain storage (CPU only)
     terrain.position.resize(N * N);
     terrain.texture_uv.resize(N * N);
 
     // Fill terrain geometry
+    buffer2D<float> noise;
+    update_terrain_position(terrain.position, noise, N, gui_scene);
     for(size_t ku=0; ku<N; ++ku) {
         for(size_t kv=0; kv<N; ++kv) {
-            // Compute local parametric coordinates (u,v) \in [0,1]
-            const float u = ku/(N-1.0f);
-            const float v = kv/(N-1.0f);
-
-            // Compute coordinates
-            terrain.position[kv + N * ku] = evaluate_perlin_terrain(u,v,gui_scene);
             terrain.texture_uv[kv + N * ku] = {5*ku/(float)N,5*kv/(float)N};
-         
         }
     }
 
@@ -389,6 +462,7 @@ mesh create_terrain(const gui_scene_structure& gui_scene) {
             terrain.connectivity.push_back(triangle_2);
         }
     }
+    normal_grid(terrain.position, N, N, terrain.normal);
 
     return terrain;
 }
@@ -419,18 +493,20 @@ mesh create_island(const gui_scene_structure& gui_scene) {
     island.position.resize(N * N);
     island.texture_uv.resize(N * N);
 
-    // Fill terrain geometry
-    for (size_t ku = 0; ku < N; ++ku) {
-        for (size_t kv = 0; kv < N; ++kv) {
-            // Compute local parametric coordinates (u,v) \in [0,1]
-            const float u = ku / (N - 1.0f);
-            const float v = kv / (N - 1.0f);
-
-            // Compute coordinates
-            island.position[kv + N * ku] = evaluate_perlin_island(u, v, gui_scene);
-            island.texture_uv[kv + N * ku] = { 5 * ku / (float)N,5 * kv / (float)N };
+    // Fill terrain geometry (tiles of rows are filled in parallel)
+    parallel_for(0, N, 4, [&](size_t ku_begin, size_t ku_end) {
+        for (size_t ku = ku_begin; ku < ku_end; ++ku) {
+            for (size_t kv = 0; kv < N; ++kv) {
+                // Compute local parametric coordinates (u,v) \in [0,1]
+                const float u = ku / (N - 1.0f);
+                const float v = kv / (N - 1.0f);
+
+                // Compute coordinates
+                island.position[kv + N * ku] = evaluate_perlin_island(u, v, gui_scene);
+                island.texture_uv[kv + N * ku] = { 5 * ku / (float)N,5 * kv / (float)N };
+            }
         }
-    }
+    });
 
     // Generate triangle organization
     // Parametric surface with uniform grid sampling: generate 2 triangles for each grid cell
@@ -828,8 +904,11 @@ void scene_model::set_data_creature_animation(std::map<std::string, GLuint>& sha
                   { {-10,-7.5,2}, 80.0f },
     };
     
-    timer_creature.t_min = keyframes_creature[1].t;                   // first time of the keyframe
-    timer_creature.t_max = keyframes_creature[keyframes_creature.size() - 2].t;  // last time of the keyframe
+    // Spline coefficients computed once for all the segments
+    trajectory_creature = create_trajectory(keyframes_creature);
+
+    timer_creature.t_min = trajectory_creature.t_min();                   // first time of the keyframe
+    timer_creature.t_max = trajectory_creature.t_max();  // last time of the keyframe
     timer_creature.t = timer_creature.t_min;
 
     timer_creature.scale = 0.5f;
@@ -851,8 +930,11 @@ void scene_model::set_data_plane_animation(std::map<std::string, GLuint>& shader
                   { {5,-7,6}    , 7.5f  }
     };
 
-    timer_plane.t_min = keyframes_plane[1].t;                   // first time of the keyframe
-    timer_plane.t_max = keyframes_plane[keyframes_plane.size() - 2].t;  // last time of the keyframe
+    // Spline coefficients computed once for all the segments
+    trajectory_plane = create_trajectory(keyframes_plane);
+
+    timer_plane.t_min = trajectory_plane.t_min();                   // first time of the keyframe
+    timer_plane.t_max = trajectory_plane.t_max();  // last time of the keyframe
     timer_plane.t = timer_plane.t_min;
 
     timer_plane.scale = 0.7f;
@@ -861,24 +943,13 @@ void scene_model::set_data_plane_animation(std::map<std::string, GLuint>& shader
 
 void scene_model::set_creature_rotation(float t_creature) {
     
-    const long idx = index_at_value(t_creature, keyframes_creature);
-
-    // Assume a closed curve trajectory
-    const float t1 = keyframes_creature[idx].t;
-    const float t0 = keyframes_creature[idx - 1].t;
-    const float t2 = keyframes_creature[idx + 1].t;
-    const float t3 = keyframes_creature[idx + 2].t;
-    const vec3& p1 = keyframes_creature[idx].p;
-    const vec3& p0 = keyframes_creature[idx - 1].p;
-    const vec3& p2 = keyframes_creature[idx + 1].p;
-    const vec3& p3 = keyframes_creature[idx + 2].p;
-
-    const vec3 p = cardinal_spline_interpolation(t_creature, t0, t1, t2, t3, p0, p1, p2, p3, 1.0);
-    const vec3 p_der = cardinal_spline_interpolation_der(t_creature, t0, t1, t2, t3, p0, p1, p2, p3, 1.0);
+    // Position and tangent of the trajectory (the segment is found from the one of the previous frame)
+    vec3 p, p_der;
+    trajectory_creature.evaluate(t_creature, p, p_der);
     
     // Store current trajectory of point p
-    creature["bigbody"].transform.translation = p;
-    creature["bigbody"].transform.rotation = rotation_between_vector_mat3({ 0,-1,0 }, p_der)*rotation_from_axis_angle_mat3({ 1,0,0 }, 1);  //make it to z vertical orientation
+    creature.node(creature_node.bigbody).transform.translation = p;
+    creature.node(creature_node.bigbody).transform.rotation = rotation_between_vector_mat3({ 0,-1,0 }, p_der)*rotation_from_axis_angle_mat3({ 1,0,0 }, 1);  //make it to z vertical orientation
     
     // Rotation of the shoulder around the y axis
     mat3 const R_shoulder = rotation_from_axis_angle_mat3({ 0,1,0 }, std::sin(2 * 3.14f * (t_creature - 0.4f)));
@@ -893,18 +964,18 @@ void scene_model::set_creature_rotation(float t_creature) {
     mat3 const Symmetry_leg = { -1,0,0, 0,1,0, 0,0,-1 };
 
     // Set the rotation to the elements in the hierarchy
-    creature["shoulder_left"].transform.rotation = R_shoulder;
-    creature["arm_bottom_left"].transform.rotation = R_arm;
+    creature.node(creature_node.shoulder_left).transform.rotation = R_shoulder;
+    creature.node(creature_node.arm_bottom_left).transform.rotation = R_arm;
 
-    creature["shoulder_right"].transform.rotation = Symmetry * R_shoulder; // apply the symmetry
-    creature["arm_bottom_right"].transform.rotation = R_arm; //note that the symmetry is already applied by the parent element
+    creature.node(creature_node.shoulder_right).transform.rotation = Symmetry * R_shoulder; // apply the symmetry
+    creature.node(creature_node.arm_bottom_right).transform.rotation = R_arm; //note that the symmetry is already applied by the parent element
 
-    creature["leg_left"].transform.rotation = R_leg;
-    creature["leg2_left"].transform.rotation = R_leg2;
-    creature["leg3_left"].transform.rotation = R_leg3;
-    creature["leg_right"].transform.rotation = Symmetry_leg * R_leg;
-    creature["leg2_right"].transform.rotation = R_leg2;
-    creature["leg3_right"].transform.rotation = R_leg3;
+    creature.node(creature_node.leg_left).transform.rotation = R_leg;
+    creature.node(creature_node.leg2_left).transform.rotation = R_leg2;
+    creature.node(creature_node.leg3_left).transform.rotation = R_leg3;
+    creature.node(creature_node.leg_right).transform.rotation = Symmetry_leg * R_leg;
+    creature.node(creature_node.leg2_right).transform.rotation = R_leg2;
+    creature.node(creature_node.leg3_right).transform.rotation = R_leg3;
 
     creature.update_local_to_global_coordinates();
 }
@@ -912,37 +983,25 @@ void scene_model::set_creature_rotation(float t_creature) {
 
 const vec3 scene_model::set_plane_rotation(float t_creature) {
    
-    const long idx = index_at_value(t_creature, keyframes_plane);
-
-    // Assume a closed curve trajectory
-    const float t1 = keyframes_plane[idx].t;
-    const float t0 = keyframes_plane[idx - 1].t;
-    const float t2 = keyframes_plane[idx + 1].t;
-    const float t3 = keyframes_plane[idx + 2].t;
-    const vec3& p1 = keyframes_plane[idx].p;
-    const vec3& p0 = keyframes_plane[idx - 1].p;
-    const vec3& p2 = keyframes_plane[idx + 1].p;
-    const vec3& p3 = keyframes_plane[idx + 2].p;
-
-    const vec3 p = cardinal_spline_interpolation(t_creature, t0, t1, t2, t3, p0, p1, p2, p3, 1.0);
-    const vec3 p_der = cardinal_spline_interpolation_der(t_creature, t0, t1, t2, t3, p0, p1, p2, p3, 1.0);
+    // Position and tangent of the trajectory (the segment is found from the one of the previous frame)
+    vec3 p, p_der;
+    trajectory_plane.evaluate(t_creature, p, p_der);
     
     // Store current trajectory of point p
-    plane["bigbody"].transform.translation = p;
-    plane["bigbody"].transform.rotation = rotation_between_vector_mat3({ 0,0,1 }, p_der);
+    plane.node(plane_bigbody).transform.translation = p;
+    plane.node(plane_bigbody).transform.rotation = rotation_between_vector_mat3({ 0,0,1 }, p_der);
     
     plane.update_local_to_global_coordinates();
 
     // Emission of new particle if needed
     const bool is_new_particle = timer_missle.event;
     if( is_new_particle ) {
-        particle_structure new_particle;
         const vec3 p0 = p;
 
         // Initial speed is random. (x,z) components are uniformly distributed along a circle.
         const vec3 v0 = p_der;
         
-        particles.push_back({p0,v0});
+        particles.emit(p0,v0);
     }
 
     return p_der;
@@ -953,39 +1012,27 @@ void scene_model::set_missle_animation(const vec3& p_der) {
 
     const float dt = timer_missle.update();
 
-    // Evolve position of particles
-    const vec3 g = { 0.0f,0.0f,-9.81f };
-    for (particle_structure& particle : particles) {
-        const float m = 0.01f; // Particle mass
-
-        vec3& p1 = particle.p;
-        vec3& v1 = particle.v;
-
-        const vec3 F = m * g;
-
-        // Numerical integration
-        v1 = v1 + dt * F / m;
-        p1 = p1 + dt * v1;
-    }
+    // Evolve position of particles (gravity only)
+    particles.integrate(dt);
 
     // Remove particles that are too low
-    for (auto it = particles.begin(); it != particles.end(); )
-        if (it->p.z < -1)
-            it = particles.erase(it);
-        else it++;
-
-    // Display particles
-    for (particle_structure& particle : particles){
-        missle.uniform.transform.translation = particle.p;
-    }
+    particles.remove_dead();
 
-    missle.uniform.transform.rotation = rotation_between_vector_mat3({ 0,0,-1 }, p_der);
+    // Display particles: one instance per missle
+    const mat3 R_missle = rotation_between_vector_mat3({ 0,0,-1 }, p_der);
+    fill_instances(particles, instances, R_missle);
+    missle.update_instances(instances);
 }
 
 
 void scene_model::set_gui() {
 
     ImGui::Checkbox("Wireframe", &gui_scene.wireframe);
+    ImGui::Checkbox("GPU ocean", &gui_scene.gpu_waves);
+    const gl_state_cache::counters gl_calls = gl_state().previous_frame_counters();
+    ImGui::Text("GL state calls: %lu issued, %lu skipped", gl_calls.issued, gl_calls.skipped);
+    ImGui::Text("Draw calls: %lu (%lu triangles)", gl_calls.draw_calls, gl_calls.triangles);
+    ImGui::Text("Frustum culling: %lu culled / %lu submitted", queue.counters.culled, queue.counters.submitted);
     ImGui::Separator();
     ImGui::Text("Perlin parameters");
 
@@ -1001,7 +1048,6 @@ void scene_model::set_gui() {
     int octave_min = 1;
     int octave_max = 10;
     if (ImGui::SliderScalar("Octave", ImGuiDataType_S32, &gui_scene.octave, &octave_min, &octave_max)) {
-        update_terrain();
         update_box();
         update_fish();
     }
@@ -1009,42 +1055,19 @@ void scene_model::set_gui() {
     float persistency_min = 0.1f;
     float persistency_max = 0.9f;
     if (ImGui::SliderScalar("Persistency", ImGuiDataType_Float, &gui_scene.persistency, &persistency_min, &persistency_max)) {
-        update_terrain();
         update_box();
         update_fish();
     }
 }
 
 
-static size_t index_at_value(float t, vcl::buffer<vec3t> const& v) {
-    const size_t N = v.size();
-    assert(v.size() >= 2);
-    assert(t >= v[0].t);
-    assert(t < v[N - 1].t);
-    size_t k = 0;
-    while (v[k + 1].t < t)
-        ++k;
-    return k;
-}
-
-
-static vec3 cardinal_spline_interpolation(float t, float t0, float t1, float t2, float t3, const vec3& p0, const vec3& p1, const vec3& p2, const vec3& p3, float K) {
-    const vec3 d1 = 2 * K / (t2 - t0) * (p2 - p0);
-    const vec3 d2 = 2 * K / (t3 - t1) * (p3 - p1);
-    const float s = (t - t1) / (t2 - t1);
-    const float s2 = s * s;
-    const float s3 = s2 * s;
-    const vec3 p = (2 * s3 - 3 * s2 + 1) * p1 + (s3 - 2 * s2 + s) * d1 + (-2 * s3 + 3 * s2) * p2 + (s3 - s2) * d2;
-    return p;
-}
-
-
-static vec3 cardinal_spline_interpolation_der(float t, float t0, float t1, float t2, float t3, const vec3& p0, const vec3& p1, const vec3& p2, const vec3& p3, float K) {
-    const vec3 d1 = 2 * K / (t2 - t0) * (p2 - p0);
-    const vec3 d2 = 2 * K / (t3 - t1) * (p3 - p1);
-    const float s = (t - t1) / (t2 - t1);
-    const float s2 = s * s;
-    const vec3 p_der = (1 / (t2 - t1))*( (6 * s2 - 6 * s) * p1 + (3 * s2 - 4 * s + 1) * d1 + (-6 * s2 + 6 * s) * p2 + (3 * s2 - 2 * s) * d2 );
-    return p_der;
+static keyframe_curve create_trajectory(const vcl::buffer<vec3t>& keyframes) {
+    buffer<vec3> position;
+    buffer<float> time;
+    for (const vec3t& keyframe : keyframes) {
+        position.push_back(keyframe.p);
+        time.push_back(keyframe.t);
+    }
+    return keyframe_curve(position, time);
 }
 #endif
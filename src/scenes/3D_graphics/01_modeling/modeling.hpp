@@ -12,6 +12,7 @@ struct vec3t {
 // Stores some parameters that can be set from the GUI
 struct gui_scene_structure {
     bool wireframe = false;
+    bool gpu_waves = true; // Unbounded sea (clipmap) displaced in the vertex shader (the CPU mesh is only used for the wireframe)
     bool display_keyframe = true;
     bool display_polygon = true;
     float height = 0.6f;
@@ -20,11 +21,18 @@ struct gui_scene_structure {
     float persistency = 0.4f;
 };
 
-struct particle_structure {
-    vcl::vec3 p; // Position
-    vcl::vec3 v; // Speed
+// Indices of the animated nodes of the creature (resolved once from their names)
+struct creature_nodes {
+    int bigbody;
+    int shoulder_left, arm_bottom_left;
+    int shoulder_right, arm_bottom_right;
+    int leg_left, leg2_left, leg3_left;
+    int leg_right, leg2_right, leg3_right;
 };
 
+// Layers of the texture array shared by the opaque textured objects
+enum material_layer { layer_island, layer_boat, layer_box, layer_flag, layer_metal };
+
 struct scene_model : scene_base {
 
     /** A part must define two functions that are called from the main function:
@@ -44,35 +52,43 @@ struct scene_model : scene_base {
     void set_gui();
 
     // Different mesh object 
+    vcl::mesh terrain_cpu;       // CPU copy of the sea surface, updated in place at every frame
     vcl::mesh_drawable terrain;
-    vcl::mesh_drawable island;
-    std::vector<vcl::vec3> box_position;
-    vcl::mesh_drawable box;
-    std::vector<vcl::vec3> fish_position;
-    vcl::mesh_drawable fish;
+    vcl::clipmap_drawable ocean;         // Nested flat grids around the camera displaced on the GPU
+    vcl::buffer2D<float> terrain_noise;  // Perlin noise of the sea grid (reused at every frame)
+    vcl::buffer<vcl::vec2> wave_samples; // Perlin coordinates of the floating objects
+    vcl::buffer<float> wave_noise;
+    std::shared_ptr<vcl::mesh_asset> island; // Built in the background
+    vcl::buffer<vcl::vec3> box_position;
+    vcl::instanced_mesh_drawable box;
+    vcl::buffer<vcl::vec3> fish_position;
+    vcl::instanced_mesh_drawable fish;
+    vcl::instance_depth_sort fish_sort; // Back-to-front order of the fish billboards
     vcl::mesh_drawable boat;
     vcl::mesh_drawable sky;
-    vcl::mesh_drawable flag;
-    vcl::mesh_drawable missle;
+    vcl::instanced_mesh_drawable flag;
+    vcl::instanced_mesh_drawable missle;
+    vcl::buffer<vcl::mesh_instance> instances; // Temporary storage used to fill the instances at every frame
+    vcl::render_queue queue; // Draw calls of the frame
 
-    std::list<particle_structure> particles; // Storage of all currently active particles for missle
+    vcl::particle_system particles; // Storage of all currently active particles for missle
 
+    const size_t N_terrain = 100; // the sea surface is sampled on N_terrain x N_terrain vertices
+    const float sky_size = 50.0f;           // the skybox walls are at +/- sky_size/2
+    const unsigned int N_ocean_grid = 128;  // GPU sea: levels of 128x128 cells up to the skybox walls (3 levels, ~50k vertices)
+    const float ocean_spacing = 0.1f;       // step of the finest level (the coarsest covers 51x51)
     const int N_box = 30;
     const int N_fish = 30;
 
-    // Texture ID
-    GLuint texture_id;
-    GLuint fish_id;
-    GLuint box_id;
-    GLuint boat_id;
-    GLuint skybox_id;
-    GLuint island_id;
-    GLuint flag_id;
-    GLuint metal_id;
+    // Textures decoded in the background (drawn with the white texture until they are uploaded)
+    std::shared_ptr<const vcl::texture_array_asset> materials; // One layer per material_layer: these objects share the texture binding
+    std::shared_ptr<const vcl::texture_asset> sea_texture;     // Also sampled by the clipmap shader (mirrored repeat)
+    std::shared_ptr<const vcl::texture_asset> fish_texture;    // Clamped, drawn in the transparent pass
+    std::shared_ptr<const vcl::texture_asset> skybox_texture;  // Clamped, too large to be resampled with the other layers
 
     // Update position function
     void update_terrain();
-    void update_island();
+    void update_island(vcl::asset_loader& assets);
     void update_box();
     void update_fish();
 
@@ -85,10 +101,16 @@ struct scene_model : scene_base {
     // Data (p_i,t_i)
     vcl::buffer<vec3t> keyframes_creature; // Given (position,time)
     vcl::buffer<vec3t> keyframes_plane;
+    vcl::keyframe_curve trajectory_creature; // Interpolation of the keyframes
+    vcl::keyframe_curve trajectory_plane;
     
     // Hierarchy object
     vcl::hierarchy_mesh_drawable creature;
     vcl::hierarchy_mesh_drawable plane;
+    vcl::hierarchy_mesh_palette_drawable creature_palette; // Baked hierarchies: one draw call per actor
+    vcl::hierarchy_mesh_palette_drawable plane_palette;
+    creature_nodes creature_node;
+    int plane_bigbody;
 
     gui_scene_structure gui_scene;
 
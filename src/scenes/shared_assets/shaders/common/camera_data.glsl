@@ -0,0 +1,7 @@
+// camera data (uniform buffer shared by all the shaders, see update_camera_uniform_buffer)
+layout(std140, row_major) uniform camera_data
+{
+    mat4 perspective;
+    mat4 view;
+    vec3 camera_position;
+};
@@ -9,10 +9,7 @@ uniform vec3 translation = vec3(0.0, 0.0, 0.0);                      // user def
 uniform mat3 rotation = mat3(1.0,0.0,0.0, 0.0,1.0,0.0, 0.0,0.0,1.0); // user defined rotation
 uniform float scaling = 1.0;                                         // user defined scaling
 
-// view transform
-uniform mat4 view;
-// perspective matrix
-uniform mat4 perspective;
+#include "../common/camera_data.glsl"
 
 
 
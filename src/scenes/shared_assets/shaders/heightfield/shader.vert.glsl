@@ -0,0 +1,174 @@
+#version 330 core
+
+layout (location = 0) in vec4 position;
+layout (location = 1) in vec4 normal;
+layout (location = 2) in vec4 color;
+layout (location = 3) in vec2 texture_uv;
+
+out struct fragment_data
+{
+    vec4 position;
+    vec4 normal;
+    vec4 color;
+    vec2 texture_uv;
+} fragment;
+
+
+// model transformation
+uniform vec3 translation = vec3(0.0, 0.0, 0.0);                      // user defined translation
+uniform mat3 rotation = mat3(1.0,0.0,0.0, 0.0,1.0,0.0, 0.0,0.0,1.0); // user defined rotation
+uniform float scaling = 1.0;                                         // user defined scaling
+uniform vec3 scaling_axis = vec3(1.0,1.0,1.0);                       // user defined scaling
+
+
+#include "../common/camera_data.glsl"
+
+
+// Heightfield: z += height * perlin( noise_scaling * (uv_scale*(x,y) + uv_offset) )
+uniform usampler1D perm_sampler;       // permutation table of the simplex noise (256 values)
+uniform float height = 1.0;
+uniform float noise_scaling = 1.0;
+uniform int octave = 5;
+uniform float persistency = 0.3;
+uniform float frequency_gain = 2.0;
+uniform vec2 uv_scale = vec2(1.0, 1.0);
+uniform vec2 uv_offset = vec2(0.0, 0.0);
+uniform float normal_epsilon = 0.05;   // step of the finite differences (in the (x,y) plane)
+
+// Border of a clipmap level: odd vertices on the square max(|x|,|y|)=seam_half_size take the average height
+// of their neighbors (distance seam_spacing) to match the edges of the coarser level (0: disabled)
+uniform float seam_spacing = 0.0;
+uniform float seam_half_size = 0.0;
+uniform vec2 texture_uv_offset = vec2(0.0, 0.0);
+
+
+int perm(int k)
+{
+    return int(texelFetch(perm_sampler, k & 255, 0).r);
+}
+
+float grad2(int hash, float x, float y)
+{
+    int h = hash & 7;
+    float u = h<4 ? x : y;
+    float v = h<4 ? y : x;
+    return ((h&1)!=0 ? -u : u) + ((h&2)!=0 ? -2.0*v : 2.0*v);
+}
+
+// 2D simplex noise, same construction as snoise2 on the CPU
+float snoise2(float x, float y)
+{
+    const float F2 = 0.366025403; // 0.5*(sqrt(3.0)-1.0)
+    const float G2 = 0.211324865; // (3.0-sqrt(3.0))/6.0
+
+    float s = (x+y)*F2;
+    int i = int(floor(x+s));
+    int j = int(floor(y+s));
+
+    float t = float(i+j)*G2;
+    float x0 = x-(float(i)-t);
+    float y0 = y-(float(j)-t);
+
+    int i1 = x0>y0 ? 1 : 0;
+    int j1 = 1-i1;
+
+    float x1 = x0 - float(i1) + G2;
+    float y1 = y0 - float(j1) + G2;
+    float x2 = x0 - 1.0 + 2.0*G2;
+    float y2 = y0 - 1.0 + 2.0*G2;
+
+    int ii = i & 255;
+    int jj = j & 255;
+
+    float n = 0.0;
+    float t0 = 0.5 - x0*x0 - y0*y0;
+    if(t0 >= 0.0) {
+        t0 *= t0;
+        n += t0 * t0 * grad2(perm(ii+perm(jj)), x0, y0);
+    }
+    float t1 = 0.5 - x1*x1 - y1*y1;
+    if(t1 >= 0.0) {
+        t1 *= t1;
+        n += t1 * t1 * grad2(perm(ii+i1+perm(jj+j1)), x1, y1);
+    }
+    float t2 = 0.5 - x2*x2 - y2*y2;
+    if(t2 >= 0.0) {
+        t2 *= t2;
+        n += t2 * t2 * grad2(perm(ii+1+perm(jj+1)), x2, y2);
+    }
+    return 40.0 * n;
+}
+
+// Height offset at the point (x,y) of the grid
+float heightfield(vec2 p)
+{
+    vec2 q = noise_scaling * (uv_scale*p + uv_offset);
+
+    float value = 0.0;
+    float a = 1.0; // current magnitude
+    float f = 1.0; // current frequency
+    for(int k=0; k<octave; k++)
+    {
+        value += a*(0.5+0.5*snoise2(q.x*f, q.y*f));
+        f *= frequency_gain;
+        a *= persistency;
+    }
+    return height * value;
+}
+
+
+// Seam correction of the clipmap borders: offset to the neighbors whose average height is taken by the vertex p
+// (0 if the vertex keeps its own height)
+vec2 seam_offset(vec2 p)
+{
+    if(seam_spacing > 0.0)
+    {
+        vec2 k = p/seam_spacing;
+        float tolerance = 0.25*seam_spacing;
+        bool border_x = abs(abs(p.x)-seam_half_size) < tolerance;
+        bool border_y = abs(abs(p.y)-seam_half_size) < tolerance;
+        if(border_x && mod(round(k.y), 2.0) != 0.0)
+            return vec2(0.0, seam_spacing);
+        if(border_y && mod(round(k.x), 2.0) != 0.0)
+            return vec2(seam_spacing, 0.0);
+    }
+    return vec2(0.0, 0.0);
+}
+
+// Height at p with the seam correction given by seam_offset
+float heightfield_vertex(vec2 p, vec2 seam)
+{
+    if(seam == vec2(0.0, 0.0))
+        return heightfield(p);
+    return 0.5*(heightfield(p-seam) + heightfield(p+seam));
+}
+
+void main()
+{
+    // Displaced position and normal from the finite differences of the same (seam corrected) height:
+    // the vertices of a border are lit as the edge of the coarser level they are snapped to
+    vec2 seam = seam_offset(position.xy);
+    float h = heightfield_vertex(position.xy, seam);
+    float hx = heightfield_vertex(position.xy + vec2(normal_epsilon, 0.0), seam);
+    float hy = heightfield_vertex(position.xy + vec2(0.0, normal_epsilon), seam);
+
+    vec4 p = vec4(position.xy, position.z + h, 1.0);
+    vec4 n = vec4(normalize(vec3(h-hx, h-hy, normal_epsilon)), 0.0);
+
+    // scaling matrix
+    mat4 S = mat4(scaling*scaling_axis.x,0.0,0.0,0.0, 0.0,scaling*scaling_axis.y,0.0,0.0, 0.0,0.0,scaling*scaling_axis.z,0.0, 0.0,0.0,0.0,1.0);
+    // 4x4 rotation matrix
+    mat4 R = mat4(rotation);
+    // 4D translation
+    vec4 T = vec4(translation,0.0);
+
+
+    fragment.color = color;
+    fragment.texture_uv = texture_uv + texture_uv_offset;
+
+    fragment.normal = R*n;
+    vec4 position_transformed = R*S*p + T;
+
+    fragment.position = position_transformed;
+    gl_Position = perspective * view * position_transformed;
+}
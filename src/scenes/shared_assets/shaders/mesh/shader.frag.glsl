@@ -12,7 +12,8 @@ uniform sampler2D texture_sampler;
 
 out vec4 FragColor;
 
-uniform vec3 camera_position;
+#include "../common/camera_data.glsl"
+
 uniform vec3 color     = vec3(1.0, 1.0, 1.0);
 uniform float color_alpha = 1.0;
 uniform float ambiant  = 0.2;
@@ -20,10 +21,10 @@ uniform float diffuse  = 0.8;
 uniform float specular = 0.5;
 uniform int specular_exponent = 128;
 
-vec3 light = vec3(camera_position.x, camera_position.y, camera_position.z);
 
 void main()
 {
+    vec3 light = vec3(camera_position.x, camera_position.y, camera_position.z);
     vec3 n = normalize(fragment.normal.xyz);
     vec3 u = normalize(light-fragment.position.xyz);
     vec3 r = reflect(u,n);
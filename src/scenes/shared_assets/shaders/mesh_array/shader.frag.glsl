@@ -0,0 +1,44 @@
+#version 330 core
+
+in struct fragment_data
+{
+    vec4 position;
+    vec4 normal;
+    vec4 color;
+    vec2 texture_uv;
+} fragment;
+flat in float fragment_layer; // layer of the texture array
+
+uniform sampler2DArray texture_sampler;
+
+out vec4 FragColor;
+
+#include "../common/camera_data.glsl"
+
+uniform vec3 color     = vec3(1.0, 1.0, 1.0);
+uniform float color_alpha = 1.0;
+uniform float ambiant  = 0.2;
+uniform float diffuse  = 0.8;
+uniform float specular = 0.5;
+uniform int specular_exponent = 128;
+
+
+void main()
+{
+    vec3 light = vec3(camera_position.x, camera_position.y, camera_position.z);
+    vec3 n = normalize(fragment.normal.xyz);
+    vec3 u = normalize(light-fragment.position.xyz);
+    vec3 r = reflect(u,n);
+    vec3 t = normalize(fragment.position.xyz-camera_position);
+
+
+    float diffuse_value  = diffuse * clamp( dot(u,n), 0.0, 1.0);
+    float specular_value = specular * pow( clamp( dot(r,t), 0.0, 1.0), specular_exponent);
+
+
+    vec3 white = vec3(1.0);
+    vec4 color_texture = texture(texture_sampler, vec3(fragment.texture_uv, fragment_layer));
+    vec3 c = (ambiant+diffuse_value)*color.rgb*fragment.color.rgb*color_texture.rgb + specular_value*white;
+
+    FragColor = vec4(c, color_texture.a*fragment.color.a*color_alpha);
+}
@@ -0,0 +1,62 @@
+#version 330 core
+
+layout (location = 0) in vec4 position;
+layout (location = 1) in vec4 normal;
+layout (location = 2) in vec4 color;
+layout (location = 3) in vec2 texture_uv;
+
+// per-instance attributes
+layout (location = 4) in vec3 instance_translation;
+layout (location = 5) in vec3 instance_rotation_0; // rows of the rotation matrix
+layout (location = 6) in vec3 instance_rotation_1;
+layout (location = 7) in vec3 instance_rotation_2;
+layout (location = 8) in float instance_scaling;
+layout (location = 9) in vec4 instance_color;
+
+out struct fragment_data
+{
+    vec4 position;
+    vec4 normal;
+    vec4 color;
+    vec2 texture_uv;
+} fragment;
+flat out float fragment_layer; // layer of the texture array
+
+
+// model transformation (applied after the instance transformation)
+uniform vec3 translation = vec3(0.0, 0.0, 0.0);                      // user defined translation
+uniform mat3 rotation = mat3(1.0,0.0,0.0, 0.0,1.0,0.0, 0.0,0.0,1.0); // user defined rotation
+uniform float scaling = 1.0;                                         // user defined scaling
+uniform vec3 scaling_axis = vec3(1.0,1.0,1.0);                       // user defined scaling
+uniform float texture_layer = 0.0;                                   // layer of the texture array
+
+
+#include "../common/camera_data.glsl"
+
+
+
+void main()
+{
+    // instance transformation
+    mat3 Ri = transpose(mat3(instance_rotation_0, instance_rotation_1, instance_rotation_2));
+    vec4 p = vec4(Ri*(instance_scaling*position.xyz) + instance_translation, 1.0);
+    vec4 n = vec4(Ri*normal.xyz, 0.0);
+
+    // scaling matrix
+    mat4 S = mat4(scaling*scaling_axis.x,0.0,0.0,0.0, 0.0,scaling*scaling_axis.y,0.0,0.0, 0.0,0.0,scaling*scaling_axis.z,0.0, 0.0,0.0,0.0,1.0);
+    // 4x4 rotation matrix
+    mat4 R = mat4(rotation);
+    // 4D translation
+    vec4 T = vec4(translation,0.0);
+
+
+    fragment.color = color*instance_color;
+    fragment.texture_uv = texture_uv;
+    fragment_layer = texture_layer;
+
+    fragment.normal = R*n;
+    vec4 position_transformed = R*S*p + T;
+
+    fragment.position = position_transformed;
+    gl_Position = perspective * view * position_transformed;
+}
@@ -23,10 +23,7 @@ uniform float scaling = 1.0;                                         // user def
 uniform vec3 scaling_axis = vec3(1.0,1.0,1.0);                       // user defined scaling
 
 
-// view transform
-uniform mat4 view;
-// perspective matrix
-uniform mat4 perspective;
+#include "../common/camera_data.glsl"
 
 
 
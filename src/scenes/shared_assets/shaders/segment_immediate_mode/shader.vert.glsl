@@ -4,10 +4,7 @@
 
 layout (location = 0) in vec4 u; //expect value in ([0,1],0,0)
 
-// view transform
-uniform mat4 view;
-// perspective matrix
-uniform mat4 perspective;
+#include "../common/camera_data.glsl"
 
 // Extremities of the segment
 uniform vec3 p1 = vec3(0.0, 0.0, 0.0);
@@ -12,10 +12,7 @@ in struct vertex_data
 
 
 
-// view transform
-uniform mat4 view;
-// perspective matrix
-uniform mat4 perspective;
+#include "../common/camera_data.glsl"
 
 
 void main(void)
@@ -5,7 +5,11 @@
 #include "types/types.hpp"
 #include "string/string.hpp"
 #include "file/file.hpp"
+#include "file_mapping/file_mapping.hpp"
 #include "rand/rand.hpp"
 #include "error/error.hpp"
+#include "parallel/parallel.hpp"
+#include "sort/sort.hpp"
+#include "trace/trace.hpp"
 
 
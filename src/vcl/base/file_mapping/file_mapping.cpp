@@ -0,0 +1,200 @@
+#include "file_mapping.hpp"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vcl
+{
+
+file_mapping::file_mapping()
+    :start(nullptr),length(0),
+#ifdef _WIN32
+      file_handle(nullptr),mapping_handle(nullptr),
+#endif
+      opened(false)
+{}
+
+file_mapping::file_mapping(const std::string& filename)
+    :file_mapping()
+{
+    open(filename);
+}
+
+file_mapping::~file_mapping()
+{
+    close();
+}
+
+file_mapping::file_mapping(file_mapping&& other)
+    :file_mapping()
+{
+    *this = std::move(other);
+}
+
+file_mapping& file_mapping::operator=(file_mapping&& other)
+{
+    if(this!=&other)
+    {
+        close();
+        start = other.start;
+        length = other.length;
+#ifdef _WIN32
+        file_handle = other.file_handle;
+        mapping_handle = other.mapping_handle;
+        other.file_handle = nullptr;
+        other.mapping_handle = nullptr;
+#endif
+        opened = other.opened;
+        other.start = nullptr;
+        other.length = 0;
+        other.opened = false;
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool file_mapping::open(const std::string& filename)
+{
+    close();
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file==INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        return false;
+    }
+    file_handle = file;
+    length = size_t(size.QuadPart);
+    opened = true;
+
+    // An empty file cannot be mapped
+    if(length==0)
+        return true;
+
+    mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mapping_handle!=nullptr)
+        start = static_cast<const char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if(start==nullptr) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void file_mapping::close()
+{
+    if(start!=nullptr)
+        UnmapViewOfFile(start);
+    if(mapping_handle!=nullptr)
+        CloseHandle(mapping_handle);
+    if(file_handle!=nullptr)
+        CloseHandle(file_handle);
+    start = nullptr;
+    length = 0;
+    file_handle = nullptr;
+    mapping_handle = nullptr;
+    opened = false;
+}
+
+#else
+
+bool file_mapping::open(const std::string& filename)
+{
+    close();
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd<0)
+        return false;
+
+    struct stat information;
+    if(fstat(fd, &information)!=0) {
+        ::close(fd);
+        return false;
+    }
+    length = size_t(information.st_size);
+
+    // An empty file cannot be mapped
+    if(length>0)
+    {
+        void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(address==MAP_FAILED) {
+            ::close(fd);
+            length = 0;
+            return false;
+        }
+        start = static_cast<const char*>(address);
+    }
+
+    // The mapping stays valid once the descriptor is closed
+    ::close(fd);
+    opened = true;
+    return true;
+}
+
+void file_mapping::close()
+{
+    if(start!=nullptr)
+        munmap(const_cast<char*>(start), length);
+    start = nullptr;
+    length = 0;
+    opened = false;
+}
+
+#endif
+
+bool file_mapping::is_open() const
+{
+    return opened;
+}
+
+const char* file_mapping::data() const
+{
+    return start;
+}
+
+size_t file_mapping::size() const
+{
+    return length;
+}
+
+
+bool operator==(const file_stamp& a, const file_stamp& b)
+{
+    return a.size==b.size && a.modification_time==b.modification_time;
+}
+
+bool operator!=(const file_stamp& a, const file_stamp& b)
+{
+    return !(a==b);
+}
+
+bool read_file_stamp(const std::string& filename, file_stamp& stamp)
+{
+#ifdef _WIN32
+    struct _stat64 information;
+    if(_stat64(filename.c_str(), &information)!=0)
+        return false;
+#else
+    struct stat information;
+    if(stat(filename.c_str(), &information)!=0)
+        return false;
+#endif
+    stamp.size = uint64_t(information.st_size);
+    stamp.modification_time = int64_t(information.st_mtime);
+    return true;
+}
+
+}
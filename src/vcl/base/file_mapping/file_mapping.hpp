@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace vcl
+{
+
+/** Read-only mapping of a whole file in memory (mmap, or a file mapping object on Windows).
+ *  The pages are loaded by the system when they are accessed: opening a large file costs almost nothing.
+ *  The mapping is released by close() or by the destructor (the object can be moved, not copied). */
+class file_mapping
+{
+public:
+    file_mapping();
+    /** Map the file (see is_open() for the success) */
+    explicit file_mapping(const std::string& filename);
+    ~file_mapping();
+
+    file_mapping(file_mapping&& other);
+    file_mapping& operator=(file_mapping&& other);
+    file_mapping(const file_mapping&) = delete;
+    file_mapping& operator=(const file_mapping&) = delete;
+
+    /** Map the file (a previous mapping is released). Return false if the file cannot be opened or mapped. */
+    bool open(const std::string& filename);
+    void close();
+    bool is_open() const;
+
+    /** First byte of the file (nullptr if not open, or if the file is empty) */
+    const char* data() const;
+    /** Size of the file in bytes */
+    size_t size() const;
+
+private:
+    const char* start;
+    size_t length;
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#endif
+    bool opened;
+};
+
+/** Size and last modification time of a file, used to detect a modified source file */
+struct file_stamp
+{
+    uint64_t size;
+    int64_t modification_time;  // Seconds since epoch
+};
+bool operator==(const file_stamp& a, const file_stamp& b);
+bool operator!=(const file_stamp& a, const file_stamp& b);
+
+/** Stamp of a file. Return false if the file cannot be accessed. */
+bool read_file_stamp(const std::string& filename, file_stamp& stamp);
+
+}
@@ -0,0 +1,165 @@
+#include "parallel.hpp"
+
+#include "vcl/base/trace/trace.hpp"
+
+#include <atomic>
+#include <memory>
+#include <cstdlib>
+#include <algorithm>
+
+namespace vcl
+{
+
+task_pool::task_pool(size_t thread_count)
+    :workers(),tasks(),mutex(),condition(),stop(false)
+{
+    for(size_t k=0; k<thread_count; ++k)
+        workers.push_back(std::thread(&task_pool::worker_loop, this));
+}
+
+task_pool::~task_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    condition.notify_all();
+    for(std::thread& t : workers)
+        t.join();
+}
+
+size_t task_pool::size() const
+{
+    return workers.size();
+}
+
+void task_pool::worker_loop()
+{
+    trace_set_thread_name("vcl worker");
+    while(true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]{ return stop || !tasks.empty(); });
+            if(stop && tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        VCL_TRACE_ZONE("task");
+        task();
+    }
+}
+
+void task_pool::submit(std::function<void()> task)
+{
+    if(workers.empty()) {
+        task();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    condition.notify_one();
+}
+
+
+// State shared by the threads taking part in one parallel_for
+// Kept alive by the helper tasks that may start after the loop is over
+struct parallel_for_job
+{
+    size_t begin;
+    size_t end;
+    size_t grain;
+    size_t chunk_count;
+    std::function<void(size_t,size_t)> f;
+
+    std::atomic<size_t> next_chunk;
+    std::atomic<size_t> done_chunk;
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    // Process chunks until none is left
+    void run()
+    {
+        size_t k_chunk;
+        while( (k_chunk=next_chunk.fetch_add(1)) < chunk_count )
+        {
+            const size_t k_begin = begin + k_chunk*grain;
+            const size_t k_end = std::min(k_begin+grain, end);
+            f(k_begin, k_end);
+
+            if( done_chunk.fetch_add(1)+1 == chunk_count ) {
+                std::lock_guard<std::mutex> lock(mutex);
+                condition.notify_all();
+            }
+        }
+    }
+};
+
+void task_pool::parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t,size_t)>& f)
+{
+    if(end<=begin)
+        return;
+    if(grain==0)
+        grain = 1;
+
+    const size_t chunk_count = (end-begin+grain-1)/grain;
+    if(chunk_count==1 || workers.empty()) {
+        for(size_t k_begin=begin; k_begin<end; k_begin+=grain)
+            f(k_begin, std::min(k_begin+grain,end));
+        return;
+    }
+
+    std::shared_ptr<parallel_for_job> job = std::make_shared<parallel_for_job>();
+    job->begin = begin;
+    job->end = end;
+    job->grain = grain;
+    job->chunk_count = chunk_count;
+    job->f = f;
+    job->next_chunk = 0;
+    job->done_chunk = 0;
+
+    // Wake up at most one helper per remaining chunk
+    const size_t helper_count = std::min(workers.size(), chunk_count-1);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for(size_t k=0; k<helper_count; ++k)
+            tasks.push_back([job]{ job->run(); });
+    }
+    if(helper_count==1)
+        condition.notify_one();
+    else
+        condition.notify_all();
+
+    // The calling thread works too, then waits for the chunks taken by the helpers
+    job->run();
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->condition.wait(lock, [&job]{ return job->done_chunk.load()==job->chunk_count; });
+}
+
+
+static size_t default_thread_count()
+{
+    size_t n = std::thread::hardware_concurrency();
+    const char* env = std::getenv("VCL_NUM_THREADS");
+    if(env!=nullptr && std::atoi(env)>0)
+        n = std::atoi(env);
+    return n>1? n-1 : 0;
+}
+
+task_pool& default_task_pool()
+{
+    static task_pool pool(default_thread_count());
+    return pool;
+}
+
+void parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t,size_t)>& f)
+{
+    default_task_pool().parallel_for(begin, end, grain, f);
+}
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+namespace vcl
+{
+
+/** Fixed pool of worker threads.
+ * Workers are created once in the constructor and wait for tasks until the pool is destroyed.
+ * - submit(task): run an independent task on one of the workers
+ * - parallel_for(...): split an index range in chunks processed by the workers and the calling thread
+ * The calling thread always takes part in parallel_for, it can therefore be called from a task without deadlock.
+*/
+class task_pool
+{
+public:
+    /** Create a pool with thread_count workers (0: every task runs on the calling thread) */
+    explicit task_pool(size_t thread_count);
+    ~task_pool();
+
+    task_pool(const task_pool&) = delete;
+    task_pool& operator=(const task_pool&) = delete;
+
+    /** Number of worker threads */
+    size_t size() const;
+
+    /** Push a task in the queue. It is executed on one of the workers (or immediately if the pool has no worker) */
+    void submit(std::function<void()> task);
+
+    /** Call f(k_begin,k_end) on consecutive sub-ranges of [begin,end[ containing at most grain indices.
+     * The call returns once every sub-range has been processed.
+     * The sub-ranges only depend on (begin,end,grain), not on the number of threads or on the scheduling. */
+    void parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t,size_t)>& f);
+
+private:
+    void worker_loop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stop;
+};
+
+/** Pool shared by the whole program (created at first use).
+ * Its number of workers is the number of hardware threads minus one (the calling thread also works in parallel_for),
+ * it can be overridden with the environment variable VCL_NUM_THREADS (total number of threads, 1 to disable multithreading). */
+task_pool& default_task_pool();
+
+/** parallel_for on the default pool */
+void parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t,size_t)>& f);
+
+}
@@ -0,0 +1,85 @@
+#include "sort.hpp"
+
+#include <array>
+#include <cstring>
+
+namespace vcl
+{
+
+uint32_t float_sort_key(float value)
+{
+    uint32_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(float));
+    // Negative values: reverse their order, positive values: place them above the negative ones
+    return (bits & 0x80000000u)? ~bits : (bits | 0x80000000u);
+}
+
+void radix_sort(const std::vector<uint32_t>& keys, std::vector<unsigned int>& order)
+{
+    const size_t N = keys.size();
+    order.resize(N);
+    for(size_t k=0; k<N; ++k)
+        order[k] = static_cast<unsigned int>(k);
+    if(N<2)
+        return;
+
+    // Histograms of the 4 bytes computed in a single pass over the keys
+    std::array<std::array<size_t,256>,4> histogram = {};
+    for(size_t k=0; k<N; ++k)
+    {
+        const uint32_t key = keys[k];
+        for(size_t pass=0; pass<4; ++pass)
+            histogram[pass][(key >> (8*pass)) & 0xFF]++;
+    }
+
+    std::vector<unsigned int> temp(N);
+    for(size_t pass=0; pass<4; ++pass)
+    {
+        std::array<size_t,256>& count = histogram[pass];
+
+        // All the keys share the same byte: the pass doesn't change the order
+        const uint32_t first_byte = (keys[order[0]] >> (8*pass)) & 0xFF;
+        if(count[first_byte]==N)
+            continue;
+
+        // Exclusive prefix sum
+        size_t offset = 0;
+        for(size_t& c : count) {
+            const size_t c_value = c;
+            c = offset;
+            offset += c_value;
+        }
+
+        const unsigned int shift = static_cast<unsigned int>(8*pass);
+        for(size_t k=0; k<N; ++k) {
+            const unsigned int index = order[k];
+            temp[count[(keys[index] >> shift) & 0xFF]++] = index;
+        }
+        order.swap(temp);
+    }
+}
+
+bool insertion_sort(const std::vector<uint32_t>& keys, std::vector<unsigned int>& order, size_t max_moves)
+{
+    const size_t N = order.size();
+    size_t moves = 0;
+    for(size_t k=1; k<N; ++k)
+    {
+        const unsigned int index = order[k];
+        const uint32_t key = keys[index];
+        size_t j = k;
+        while(j>0 && keys[order[j-1]]>key) {
+            if(moves==max_moves) {
+                order[j] = index;
+                return false;
+            }
+            order[j] = order[j-1];
+            --j;
+            ++moves;
+        }
+        order[j] = index;
+    }
+    return true;
+}
+
+}
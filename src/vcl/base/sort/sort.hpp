@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vcl
+{
+
+/** Map a float to an unsigned integer with the same ordering (negative values included).
+ *  Sorting the keys as integers sorts the floats. */
+uint32_t float_sort_key(float value);
+
+/** Stable LSD radix sort of 32 bits keys (4 passes of 8 bits, passes with a single bucket are skipped).
+ *  order is filled with the indices such that keys[order[0]] <= keys[order[1]] <= ...
+ *  Equal keys keep their relative index order. */
+void radix_sort(const std::vector<uint32_t>& keys, std::vector<unsigned int>& order);
+
+/** Stable insertion sort of an existing order (indices in keys).
+ *  Linear time when order is already almost sorted: used to refine the order of the previous frame.
+ *  Stops and returns false when more than max_moves elements have to be shifted (order remains a permutation but is not sorted). */
+bool insertion_sort(const std::vector<uint32_t>& keys, std::vector<unsigned int>& order, size_t max_moves=SIZE_MAX);
+
+}
@@ -0,0 +1,230 @@
+#include "trace.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace vcl
+{
+
+std::atomic<bool> trace_active(false);
+
+// Number of events kept per thread
+static const size_t trace_capacity = 16384;
+
+namespace
+{
+
+static_assert(trace_detail_size%8==0, "The detail is stored in 64 bits words");
+static const size_t trace_detail_words = trace_detail_size/8;
+
+// Slot of the ring buffer, read by trace_write_json while its thread may overwrite it (sequence lock):
+// the fields are relaxed atomics, the copy is valid if sequence is the same before and after reading them
+struct trace_event
+{
+    std::atomic<size_t> sequence;   // k+1 once the event k is stored, 0 while the slot is written
+    std::atomic<const char*> name;
+    std::atomic<int64_t> begin;
+    std::atomic<int64_t> end;
+    std::atomic<uint64_t> detail[trace_detail_words];
+};
+
+// Copy of an event made by trace_write_json
+struct trace_event_copy
+{
+    const char* name;
+    int64_t begin;
+    int64_t end;
+    char detail[trace_detail_size];
+};
+
+// Events of one thread: only written by this thread, read under the registry lock by trace_write_json
+struct trace_thread
+{
+    std::unique_ptr<trace_event[]> events; // Ring buffer (allocated at the first record)
+    std::atomic<size_t> written;      // Number of events recorded since the start
+    std::string name;
+    size_t id;
+};
+
+// Data of all the threads, kept after the end of the threads
+struct trace_registry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<trace_thread>> threads;
+    std::string exit_filename;
+};
+
+}
+
+static trace_registry& registry()
+{
+    static trace_registry r;
+    return r;
+}
+
+static trace_thread& current_thread()
+{
+    thread_local trace_thread* thread = nullptr;
+    if(thread==nullptr)
+    {
+        trace_registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.threads.push_back(std::unique_ptr<trace_thread>(new trace_thread()));
+        thread = r.threads.back().get();
+        thread->written = 0;
+        thread->id = r.threads.size();
+        thread->name = "thread "+std::to_string(thread->id);
+    }
+    return *thread;
+}
+
+// Copy the event k from its slot. Return false if the slot doesn't hold it anymore (overwritten before or during the copy).
+static bool read_event(const trace_event& e, size_t k, trace_event_copy& copy)
+{
+    if(e.sequence.load(std::memory_order_acquire)!=k+1)
+        return false;
+    copy.name = e.name.load(std::memory_order_relaxed);
+    copy.begin = e.begin.load(std::memory_order_relaxed);
+    copy.end = e.end.load(std::memory_order_relaxed);
+    uint64_t words[trace_detail_words];
+    for(size_t w=0; w<trace_detail_words; ++w)
+        words[w] = e.detail[w].load(std::memory_order_relaxed);
+    // The fields are read before checking the sequence again
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(e.sequence.load(std::memory_order_relaxed)!=k+1)
+        return false;
+
+    std::memcpy(copy.detail, words, trace_detail_size);
+    copy.detail[trace_detail_size-1] = '\0';
+    return true;
+}
+
+// Characters to escape in a JSON string (file names on Windows contain backslashes)
+static void write_json_string(std::ostream& stream, const char* s)
+{
+    stream<<'"';
+    for(; *s!='\0'; ++s)
+    {
+        const char c = *s;
+        if(c=='"' || c=='\\')
+            stream<<'\\'<<c;
+        else if(static_cast<unsigned char>(c)<0x20) {
+            char code[8];
+            std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned int>(c));
+            stream<<code;
+        }
+        else
+            stream<<c;
+    }
+    stream<<'"';
+}
+
+static void write_at_exit()
+{
+    trace_write_json(registry().exit_filename);
+}
+
+
+void trace_enable(bool enabled)
+{
+    trace_active.store(enabled, std::memory_order_relaxed);
+}
+
+void trace_set_thread_name(const std::string& name)
+{
+    trace_thread& thread = current_thread();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    thread.name = name;
+}
+
+int64_t trace_time()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+}
+
+void trace_record(const char* name, const char* detail, int64_t begin, int64_t end)
+{
+    trace_thread& thread = current_thread();
+    if(!thread.events)
+        thread.events.reset(new trace_event[trace_capacity]()); // Zero initialized: no event stored
+
+    char text[trace_detail_size] = {};
+    if(detail!=nullptr)
+        std::strncpy(text, detail, trace_detail_size-1);
+    uint64_t words[trace_detail_words];
+    std::memcpy(words, text, trace_detail_size);
+
+    const size_t k = thread.written.load(std::memory_order_relaxed);
+    trace_event& e = thread.events[k%trace_capacity];
+    // Invalidate the slot before modifying it (the fence keeps the following stores after this one)
+    e.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.name.store(name, std::memory_order_relaxed);
+    e.begin.store(begin, std::memory_order_relaxed);
+    e.end.store(end, std::memory_order_relaxed);
+    for(size_t w=0; w<trace_detail_words; ++w)
+        e.detail[w].store(words[w], std::memory_order_relaxed);
+    e.sequence.store(k+1, std::memory_order_release);
+
+    // Published for trace_write_json once complete
+    thread.written.store(k+1, std::memory_order_release);
+}
+
+bool trace_write_json(const std::string& filename)
+{
+    std::ofstream stream(filename);
+    if(!stream.is_open())
+        return false;
+
+    trace_registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    // Times in microseconds
+    char time[64];
+    bool first = true;
+    stream<<"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    for(const std::unique_ptr<trace_thread>& thread : r.threads)
+    {
+        stream<<(first? "" : ",\n")<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"<<thread->id<<",\"args\":{\"name\":";
+        write_json_string(stream, thread->name.c_str());
+        stream<<"}}";
+        first = false;
+
+        const size_t N = thread->written.load(std::memory_order_acquire);
+        trace_event_copy e;
+        for(size_t k=(N>trace_capacity? N-trace_capacity : 0); k<N; ++k)
+        {
+            if(!read_event(thread->events[k%trace_capacity], k, e))
+                continue;
+            stream<<",\n{\"name\":";
+            write_json_string(stream, e.name);
+            std::snprintf(time, sizeof(time), "\"ts\":%.3f,\"dur\":%.3f", double(e.begin)*1e-3, double(e.end-e.begin)*1e-3);
+            stream<<",\"cat\":\"vcl\",\"ph\":\"X\","<<time<<",\"pid\":1,\"tid\":"<<thread->id;
+            if(e.detail[0]!='\0') {
+                stream<<",\"args\":{\"detail\":";
+                write_json_string(stream, e.detail);
+                stream<<"}";
+            }
+            stream<<"}";
+        }
+    }
+    stream<<"\n]}\n";
+    return stream.good();
+}
+
+void trace_write_json_at_exit(const std::string& filename)
+{
+    trace_registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    if(r.exit_filename.empty())
+        std::atexit(write_at_exit);
+    r.exit_filename = filename;
+}
+
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Scoped zones exported as a Chrome Trace Event file (chrome://tracing, ui.perfetto.dev)
+//
+// - VCL_TRACE_ZONE( name )                : zone covering the rest of the current scope (name is a string literal)
+// - VCL_TRACE_ZONE_DETAIL( name, detail ) : same, with a dynamic string shown in the arguments of the event (ex. a file name)
+//
+// Zones are recorded only once trace_enable(true) is called: a disabled zone costs one relaxed atomic load.
+// Compiling with VCL_NO_TRACE removes the zones entirely.
+//
+
+namespace vcl
+{
+
+/** Start/stop recording the zones (disabled by default) */
+void trace_enable(bool enabled);
+inline bool trace_enabled();
+
+/** Name of the calling thread in the trace (default: "thread k", k in order of first record) */
+void trace_set_thread_name(const std::string& name);
+
+/** Write all the recorded zones of all the threads in a Chrome Trace Event JSON file. Return false if the file cannot be written.
+ *  The events are kept: successive writes contain the whole (ring buffered) history.
+ *  It can be called while other threads record zones: the zones still open, and the events overwritten in the ring buffer
+ *  during the copy, are skipped (each slot is validated by its sequence number after being read). */
+bool trace_write_json(const std::string& filename);
+/** Write the trace in filename when the program exits (the last call defines the file) */
+void trace_write_json_at_exit(const std::string& filename);
+
+/** Nanoseconds since the first use of the trace clock */
+int64_t trace_time();
+
+/** Maximal length of the detail of a zone (longer details are truncated) */
+static const size_t trace_detail_size = 48;
+
+/** Record the zone [begin,end] on the calling thread (detail can be nullptr).
+ *  The last events are kept in a ring buffer per thread (older ones are overwritten). */
+void trace_record(const char* name, const char* detail, int64_t begin, int64_t end);
+
+/** Zone bound to the lifetime of the object (use the macros) */
+struct trace_zone
+{
+    trace_zone(const char* name);
+    trace_zone(const char* name, const std::string& detail);
+    ~trace_zone();
+
+    trace_zone(const trace_zone&) = delete;
+    trace_zone& operator=(const trace_zone&) = delete;
+
+private:
+    const char* name;
+    int64_t begin;
+    char detail[trace_detail_size]; // Copied only if the zone is recorded (empty: no detail)
+};
+
+}
+
+
+#ifndef VCL_NO_TRACE
+#define VCL_TRACE_CONCAT_IMPL(A,B) A##B
+#define VCL_TRACE_CONCAT(A,B) VCL_TRACE_CONCAT_IMPL(A,B)
+#define VCL_TRACE_ZONE(NAME) vcl::trace_zone VCL_TRACE_CONCAT(vcl_trace_zone_,__LINE__)(NAME)
+#define VCL_TRACE_ZONE_DETAIL(NAME, DETAIL) vcl::trace_zone VCL_TRACE_CONCAT(vcl_trace_zone_,__LINE__)(NAME, DETAIL)
+#else
+#define VCL_TRACE_ZONE(NAME)
+#define VCL_TRACE_ZONE_DETAIL(NAME, DETAIL)
+#endif
+
+
+// Inline implementation (checked by every zone)
+
+namespace vcl
+{
+
+extern std::atomic<bool> trace_active;
+
+inline bool trace_enabled()
+{
+    return trace_active.load(std::memory_order_relaxed);
+}
+
+inline trace_zone::trace_zone(const char* name_arg)
+    :name(name_arg),begin(-1)
+{
+    if(trace_enabled()) {
+        detail[0] = '\0';
+        begin = trace_time();
+    }
+}
+
+inline trace_zone::trace_zone(const char* name_arg, const std::string& detail_arg)
+    :name(name_arg),begin(-1)
+{
+    if(trace_enabled()) {
+        const size_t N = std::min(detail_arg.size(), trace_detail_size-1);
+        std::memcpy(detail, detail_arg.data(), N);
+        detail[N] = '\0';
+        begin = trace_time();
+    }
+}
+
+inline trace_zone::~trace_zone()
+{
+    if(begin>=0)
+        trace_record(name, detail, begin, trace_time());
+}
+
+}
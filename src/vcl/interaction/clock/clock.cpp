@@ -0,0 +1,57 @@
+#include "clock.hpp"
+
+#include "vcl/wrapper/glfw/glfw.hpp"
+
+namespace vcl
+{
+
+// Clock set by the user (nullptr: wall clock).
+// Timers may be created by global constructors: the wall clock is created on first use.
+static clock_source* active_clock = nullptr;
+
+static const clock_source& default_clock()
+{
+    static const clock_wall clock;
+    return clock;
+}
+
+
+clock_source::~clock_source()
+{}
+
+double clock_wall::time() const
+{
+    return glfwGetTime();
+}
+
+clock_fixed_step::clock_fixed_step(double time_step_arg, double t_arg)
+    :time_step(time_step_arg), t(t_arg)
+{}
+
+double clock_fixed_step::time() const
+{
+    return t;
+}
+
+void clock_fixed_step::advance()
+{
+    t += time_step;
+}
+
+
+void set_clock(clock_source* clock)
+{
+    active_clock = clock;
+}
+
+const clock_source& current_clock()
+{
+    return (active_clock!=nullptr)? *active_clock : default_clock();
+}
+
+double clock_time()
+{
+    return current_clock().time();
+}
+
+}
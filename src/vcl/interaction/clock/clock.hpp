@@ -0,0 +1,44 @@
+#pragma once
+
+namespace vcl
+{
+
+/** Source of the time (in seconds) read by the timers (timer_basic and derived classes, time_slider, time_period) */
+class clock_source
+{
+public:
+    virtual ~clock_source();
+    virtual double time() const = 0;
+};
+
+/** Wall clock time given by GLFW (default clock) */
+class clock_wall : public clock_source
+{
+public:
+    double time() const;
+};
+
+/** Simulated time advancing by a fixed time step at each call to advance(): the animation doesn't depend on the speed of the display.
+ *  Typically used for offscreen rendering and benchmarks where the result must be deterministic. */
+class clock_fixed_step : public clock_source
+{
+public:
+    clock_fixed_step(double time_step=1.0/60.0, double t=0.0);
+
+    double time() const;
+    /** Move the time forward by time_step (expected once per frame) */
+    void advance();
+
+    double time_step;
+    double t;
+};
+
+/** Set the clock used by the timers. The clock is referenced (not copied), nullptr restores the wall clock.
+ *  Timers store the time of their last update: set the clock before creating or starting them. */
+void set_clock(clock_source* clock);
+/** Clock currently used by the timers */
+const clock_source& current_clock();
+/** Current time of the clock used by the timers */
+double clock_time();
+
+}
@@ -5,4 +5,5 @@
 #include "time_slider/time_slider.hpp"
 #include "screen_motion/screen_motion.hpp"
 #include "time_period/time_period.hpp"
+#include "clock/clock.hpp"
 #include "picking/picking.hpp"
@@ -1,17 +1,17 @@
 #include "time_period.hpp"
 
-#include "vcl/wrapper/glfw/glfw.hpp"
+#include "vcl/interaction/clock/clock.hpp"
 
 namespace vcl
 {
 
 time_period::time_period()
-    :time_step(1.0f), t0(static_cast<float>(glfwGetTime()))
+    :time_step(1.0f), t0(static_cast<float>(clock_time()))
 {}
 
 bool time_period::update()
 {
-    const float t1 = static_cast<float>(glfwGetTime());
+    const float t1 = static_cast<float>(clock_time());
     if( t1-t0>time_step )
     {
         t0=t1;
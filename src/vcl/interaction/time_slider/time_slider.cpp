@@ -1,6 +1,6 @@
 #include "time_slider.hpp"
 
-#include "vcl/wrapper/glfw/glfw.hpp"
+#include "vcl/interaction/clock/clock.hpp"
 
 #include <cassert>
 
@@ -18,7 +18,7 @@ float timer_interval_reversing::update()
     if(!running)
         return 0.0f;
 
-    const float time_current = static_cast<float>(glfwGetTime());
+    const float time_current = static_cast<float>(clock_time());
     const float dt = scale*(time_current-time_previous);
     assert(dt<t_max-t_min);
 
@@ -84,7 +84,7 @@ float timer_event::update()
 
 
 timer_basic::timer_basic()
-    :t(0),scale(1.0f),running(true),time_previous(static_cast<float>(glfwGetTime()))
+    :t(0),scale(1.0f),running(true),time_previous(static_cast<float>(clock_time()))
 {}
 
 float timer_basic::update()
@@ -92,7 +92,7 @@ float timer_basic::update()
     if(!running)
         return 0.0f;
 
-    const float time_current = static_cast<float>(glfwGetTime());
+    const float time_current = static_cast<float>(clock_time());
     const float dt = scale*(time_current-time_previous);
 
     time_previous = time_current;
@@ -104,7 +104,7 @@ float timer_basic::update()
 void timer_basic::start()
 {
     running = true;
-    time_previous = static_cast<float>(glfwGetTime());
+    time_previous = static_cast<float>(clock_time());
 }
 void timer_basic::stop()
 {
@@ -116,12 +116,12 @@ void timer_basic::stop()
 
 
 time_slider::time_slider()
-    :t_min(0.0f),t_max(1.0f),t(0.0f), reversing(false), time_scale(1.0f), running(true), reversed_direction(false), t_absolute_stored( static_cast<float>(glfwGetTime()) )
+    :t_min(0.0f),t_max(1.0f),t(0.0f), reversing(false), time_scale(1.0f), running(true), reversed_direction(false), t_absolute_stored( static_cast<float>(clock_time()) )
 {
 }
 
 time_slider::time_slider(float t_min_arg, float t_max_arg, bool running_arg, bool reversing_arg, float time_scale_arg)
-    :t_min(t_min_arg),t_max(t_max_arg),t(t_min_arg), reversing(reversing_arg), time_scale(time_scale_arg), running(running_arg), reversed_direction(false), t_absolute_stored( static_cast<float>(glfwGetTime()) )
+    :t_min(t_min_arg),t_max(t_max_arg),t(t_min_arg), reversing(reversing_arg), time_scale(time_scale_arg), running(running_arg), reversed_direction(false), t_absolute_stored( static_cast<float>(clock_time()) )
 {
 }
 
@@ -131,7 +131,7 @@ void time_slider::update()
 {
     if( running==true )
     {
-        const float time_absolute = static_cast<float>(glfwGetTime());
+        const float time_absolute = static_cast<float>(clock_time());
         const float dt = time_absolute - t_absolute_stored;
         t_absolute_stored = time_absolute;
 
@@ -171,7 +171,7 @@ void time_slider::stop()
 void time_slider::run()
 {
     running = true;
-    t_absolute_stored = static_cast<float>(glfwGetTime());
+    t_absolute_stored = static_cast<float>(clock_time());
 }
 
 
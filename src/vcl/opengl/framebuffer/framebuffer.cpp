@@ -0,0 +1,96 @@
+#include "framebuffer.hpp"
+
+#include "vcl/opengl/debug/opengl_debug.hpp"
+#include "vcl/opengl/state_cache/state_cache.hpp"
+
+#include <iostream>
+#include <cstring>
+
+namespace vcl
+{
+
+framebuffer::framebuffer()
+    :fbo(0),texture_color(0),renderbuffer_depth(0),width(0),height(0)
+{}
+
+framebuffer::framebuffer(int width_arg, int height_arg)
+    :fbo(0),texture_color(0),renderbuffer_depth(0),width(width_arg),height(height_arg)
+{
+    glGenTextures(1, &texture_color);
+    gl_state().bind_texture(GL_TEXTURE_2D, texture_color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    gl_state().bind_texture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &renderbuffer_depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer_depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffer_depth);
+
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if( status!=GL_FRAMEBUFFER_COMPLETE ) {
+        std::cerr<<"Error: framebuffer ("<<width<<"x"<<height<<") is not complete (status "<<status<<")"<<std::endl;
+        exit(1);
+    }
+    opengl_debug();
+}
+
+void framebuffer::clear()
+{
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &renderbuffer_depth);
+    if(texture_color!=0)
+        gl_state().bind_texture(GL_TEXTURE_2D, 0);
+    glDeleteTextures(1, &texture_color);
+
+    fbo = 0;
+    texture_color = 0;
+    renderbuffer_depth = 0;
+    width = 0;
+    height = 0;
+}
+
+void bind(const framebuffer& target)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+    glViewport(0, 0, target.width, target.height);
+}
+
+void unbind_framebuffer(int viewport_width, int viewport_height)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, viewport_width, viewport_height);
+}
+
+image_raw read_pixels(const framebuffer& target)
+{
+    const size_t row = 4*size_t(target.width);
+    std::vector<unsigned char> data(row*size_t(target.height));
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target.fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, target.width, target.height, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    opengl_debug();
+
+    // OpenGL stores the bottom row first
+    std::vector<unsigned char> line(row);
+    for(int y=0; y<target.height/2; ++y) {
+        unsigned char* a = &data[size_t(y)*row];
+        unsigned char* b = &data[size_t(target.height-1-y)*row];
+        std::memcpy(&line[0], a, row);
+        std::memcpy(a, b, row);
+        std::memcpy(b, &line[0], row);
+    }
+
+    return image_raw(unsigned(target.width), unsigned(target.height), image_color_type::rgba, data);
+}
+
+}
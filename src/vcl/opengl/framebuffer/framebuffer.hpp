@@ -0,0 +1,34 @@
+#pragma once
+
+#include "vcl/wrapper/glad/glad.hpp"
+#include "vcl/opengl/texture/image/image.hpp"
+
+namespace vcl
+{
+
+/** Offscreen render target: RGBA8 color texture and 24 bits depth renderbuffer */
+struct framebuffer
+{
+    framebuffer();
+    /** Create the render target (exit the program if the framebuffer is not complete) */
+    framebuffer(int width, int height);
+
+    /** Delete the GPU objects and reset the ids to 0 */
+    void clear();
+
+    GLuint fbo;
+    GLuint texture_color;
+    GLuint renderbuffer_depth;
+    int width;
+    int height;
+};
+
+/** Draw into the framebuffer (and set the viewport to its size) */
+void bind(const framebuffer& target);
+/** Draw into the default framebuffer (the window) */
+void unbind_framebuffer(int viewport_width, int viewport_height);
+
+/** Copy the color of the framebuffer in an image (first row at the top of the image) */
+image_raw read_pixels(const framebuffer& target);
+
+}
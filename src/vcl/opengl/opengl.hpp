@@ -4,4 +4,7 @@
 #include "shader/shader.hpp"
 #include "uniform/uniform.hpp"
 #include "texture/texture.hpp"
+#include "state_cache/state_cache.hpp"
+#include "framebuffer/framebuffer.hpp"
 
+#include "profiler/profiler.hpp"
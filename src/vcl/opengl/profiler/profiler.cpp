@@ -0,0 +1,209 @@
+#include "profiler.hpp"
+
+#include "vcl/base/base.hpp"
+#include "vcl/opengl/debug/opengl_debug.hpp"
+#include "vcl/opengl/state_cache/state_cache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace vcl
+{
+
+profiler_statistics::profiler_statistics()
+    :min(0.0f),average(0.0f),p99(0.0f),samples(0)
+{}
+
+void profiler::history::push(float value)
+{
+    values[next] = value;
+    next = (next+1)%values.size();
+    count = std::min(count+1, values.size());
+}
+
+profiler_statistics profiler::history::statistics() const
+{
+    profiler_statistics s;
+    if(count==0)
+        return s;
+
+    std::vector<float> sorted(values.begin(), values.begin()+long(count));
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for(float v : sorted)
+        sum += v;
+
+    // Nearest rank percentile
+    const size_t rank = size_t(std::ceil(0.99*double(count)));
+    s.min = sorted[0];
+    s.average = float(sum/double(count));
+    s.p99 = sorted[std::max(rank,size_t(1))-1];
+    s.samples = count;
+    return s;
+}
+
+
+profiler::profiler(size_t history_size_arg)
+    :enabled(true),zones(),stack(),history_size(history_size_arg),slot(0),active(false)
+{
+    assert_vcl(history_size>0, "Profiler history must contain at least one frame");
+}
+
+void profiler::new_frame()
+{
+    assert_vcl(stack.empty(), "Profiler scope not closed at the end of the frame ("+str(stack.size())+" open)");
+
+    const size_t N = zones.size();
+    for(size_t k=0; k<N; ++k)
+    {
+        zone& z = zones[k];
+        if(z.active_frame) {
+            z.cpu.push(float(z.cpu_frame));
+            z.draw_calls = z.frame_draw_calls;
+            z.triangles = z.frame_triangles;
+        }
+        z.cpu_frame = 0.0;
+        z.frame_draw_calls = 0;
+        z.frame_triangles = 0;
+        z.active_frame = false;
+        z.begin_issued = false;
+
+        // Results of the previous frames that are ready (never blocks)
+        for(size_t s=0; s<latency; ++s)
+            if(z.pending[s])
+                read_back(z, s);
+    }
+
+    slot = (slot+1)%latency;
+    active = enabled;
+}
+
+void profiler::begin(const char* name)
+{
+    if(!active)
+        return;
+
+    const size_t index = find_zone(name);
+    zone& z = zones[index];
+    stack.push_back(index);
+
+    z.active_frame = true;
+    const gl_state_cache::counters c = gl_state().current_counters();
+    z.start_draw_calls = c.draw_calls;
+    z.start_triangles = c.triangles;
+
+    if(!z.begin_issued) {
+        // Result of the same slot latency frames ago still not available: dropped
+        z.pending[slot] = false;
+        glQueryCounter(z.query[slot][0], GL_TIMESTAMP); opengl_debug();
+        z.begin_issued = true;
+    }
+    z.cpu_start = std::chrono::steady_clock::now();
+}
+
+void profiler::end()
+{
+    if(!active)
+        return;
+    assert_vcl(!stack.empty(), "Profiler end() without begin()");
+
+    zone& z = zones[stack.back()];
+    stack.pop_back();
+
+    z.cpu_frame += std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-z.cpu_start).count();
+    glQueryCounter(z.query[slot][1], GL_TIMESTAMP); opengl_debug();
+    z.pending[slot] = true;
+
+    const gl_state_cache::counters c = gl_state().current_counters();
+    z.frame_draw_calls += c.draw_calls - z.start_draw_calls;
+    z.frame_triangles += c.triangles - z.start_triangles;
+}
+
+std::vector<profiler_zone_result> profiler::results() const
+{
+    std::vector<profiler_zone_result> r(zones.size());
+    for(size_t k=0; k<zones.size(); ++k)
+    {
+        const zone& z = zones[k];
+        r[k].name = z.name;
+        r[k].depth = z.depth;
+        r[k].cpu = z.cpu.statistics();
+        r[k].gpu = z.gpu.statistics();
+        r[k].draw_calls = z.draw_calls;
+        r[k].triangles = z.triangles;
+    }
+    return r;
+}
+
+void profiler::clear()
+{
+    for(zone& z : zones)
+        for(std::array<GLuint,2>& q : z.query)
+            glDeleteQueries(2, q.data());
+    zones.clear();
+    stack.clear();
+}
+
+size_t profiler::find_zone(const char* name)
+{
+    const size_t N = zones.size();
+    for(size_t k=0; k<N; ++k)
+        if(zones[k].name==name || std::strcmp(zones[k].name,name)==0)
+            return k;
+
+    zone z;
+    z.name = name;
+    z.depth = int(stack.size());
+    for(std::array<GLuint,2>& q : z.query)
+        glGenQueries(2, q.data());
+    z.pending.fill(false);
+    z.begin_issued = false;
+    z.cpu_frame = 0.0;
+    z.active_frame = false;
+    z.start_draw_calls = 0; z.start_triangles = 0;
+    z.frame_draw_calls = 0; z.frame_triangles = 0;
+    z.draw_calls = 0;       z.triangles = 0;
+    z.cpu = {std::vector<float>(history_size), 0, 0};
+    z.gpu = {std::vector<float>(history_size), 0, 0};
+    opengl_debug();
+
+    zones.push_back(z);
+    return N;
+}
+
+void profiler::read_back(zone& z, size_t s)
+{
+    // The end timestamp is written after the begin one
+    GLint available = 0;
+    glGetQueryObjectiv(z.query[s][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if(available==0)
+        return;
+
+    GLuint64 t0 = 0, t1 = 0;
+    glGetQueryObjectui64v(z.query[s][0], GL_QUERY_RESULT, &t0);
+    glGetQueryObjectui64v(z.query[s][1], GL_QUERY_RESULT, &t1);
+    z.gpu.push(float(double(t1-t0)*1e-6));
+    z.pending[s] = false;
+}
+
+
+profiler& frame_profiler()
+{
+    static profiler p;
+    return p;
+}
+
+profiler_scope::profiler_scope(const char* name, profiler& p)
+    :target(p)
+{
+    target.begin(name);
+}
+
+profiler_scope::~profiler_scope()
+{
+    target.end();
+}
+
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "vcl/wrapper/glad/glad.hpp"
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace vcl
+{
+
+/** Rolling statistics of a duration (in milliseconds) over the history of a profiler */
+struct profiler_statistics
+{
+    profiler_statistics();
+
+    float min;
+    float average;
+    float p99;
+    size_t samples;  // Number of frames taken into account (0: no measure yet)
+};
+
+/** Measures of one named scope, as displayed by the profiler GUI */
+struct profiler_zone_result
+{
+    std::string name;
+    int depth;                 // Nesting level of the scope (0 for a top level scope)
+    profiler_statistics cpu;
+    profiler_statistics gpu;
+    unsigned long draw_calls;  // Draw calls and triangles of the last complete frame
+    unsigned long triangles;
+};
+
+/** CPU and GPU timings of named scopes (passes of a frame).
+ *  Each scope records its CPU time (steady clock), and its GPU time with a pair of GL_TIMESTAMP queries (which, unlike GL_TIME_ELAPSED, can be nested).
+ *  The queries of a frame are read back latency frames later, only if their result is available: the CPU never waits for the GPU
+ *  (a result still not available when its queries are reused is dropped).
+ *  The draw calls and triangles counted by gl_state() between the beginning and the end of a scope are attributed to it.
+ *  A scope is expected once per frame: if it is repeated, the times and counters are summed, the GPU time spans from the first begin to the last end.
+ *  Usage at every frame: new_frame(), then begin(name)/end() pairs (or a profiler_scope) around the passes. */
+class profiler
+{
+public:
+    profiler(size_t history_size=240);
+
+    /** Collect the available GPU results, store the CPU measures of the previous frame and start a new frame */
+    void new_frame();
+    /** Open/close a scope (the name is expected to be a string literal: scopes are compared by name) */
+    void begin(const char* name);
+    void end();
+
+    /** Statistics of all the scopes in order of first appearance */
+    std::vector<profiler_zone_result> results() const;
+
+    /** Delete the OpenGL queries (to be called before the context is destroyed) */
+    void clear();
+
+    /** Measures are disabled/enabled at the next new_frame() */
+    bool enabled;
+
+    /** Number of frames between the queries and the read back of their results */
+    static const size_t latency = 4;
+
+private:
+    // Fixed size history of the last measures
+    struct history
+    {
+        std::vector<float> values;
+        size_t next;
+        size_t count;
+
+        void push(float value);
+        profiler_statistics statistics() const;
+    };
+
+    struct zone
+    {
+        const char* name;
+        int depth;
+
+        std::array<std::array<GLuint,2>,latency> query; // Begin/end timestamps for each frame of the ring
+        std::array<bool,latency> pending;                // Queries issued and not read yet
+        bool begin_issued;                               // Begin timestamp already issued in the current frame
+
+        std::chrono::steady_clock::time_point cpu_start;
+        double cpu_frame;                               // CPU time accumulated in the current frame (ms)
+        bool active_frame;                              // Scope opened in the current frame
+        unsigned long start_draw_calls, start_triangles;
+        unsigned long frame_draw_calls, frame_triangles;
+
+        unsigned long draw_calls, triangles;           // Last complete frame
+        history cpu, gpu;
+    };
+
+    size_t find_zone(const char* name);
+    void read_back(zone& z, size_t slot);
+
+    std::vector<zone> zones;
+    std::vector<size_t> stack;   // Open scopes
+    size_t history_size;
+    size_t slot;                 // Slot of the query ring used by the current frame
+    bool active;
+};
+
+/** Profiler of the frames of the application */
+profiler& frame_profiler();
+
+/** begin/end of a profiler scope bound to the lifetime of the object */
+struct profiler_scope
+{
+    profiler_scope(const char* name, profiler& p=frame_profiler());
+    ~profiler_scope();
+
+    profiler_scope(const profiler_scope&) = delete;
+    profiler_scope& operator=(const profiler_scope&) = delete;
+
+private:
+    profiler& target;
+};
+
+}
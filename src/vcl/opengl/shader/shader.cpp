@@ -1,9 +1,11 @@
 #include "shader.hpp"
 
 #include "vcl/base/base.hpp"
+#include "../uniform/uniform.hpp"
 
 #include <vector>
 #include <iostream>
+#include <sstream>
 #include <cassert>
 
 namespace vcl
@@ -64,6 +66,32 @@ static void check_link(GLuint vertex_shader, GLuint fragment_shader, GLuint prog
 
 }
 
+std::string read_shader_file(const std::string& path)
+{
+    const std::string directory = path.substr(0, path.find_last_of("/\\")+1);
+    std::istringstream lines(read_file_text(path));
+    std::string source;
+    std::string line;
+    size_t line_number = 0;
+    while(std::getline(lines, line))
+    {
+        ++line_number;
+        const size_t first = line.find_first_not_of(" \t");
+        if(first==std::string::npos || line.compare(first, 8, "#include")!=0) {
+            source += line+"\n";
+            continue;
+        }
+
+        const size_t name_begin = line.find('"', first);
+        const size_t name_end = name_begin==std::string::npos? std::string::npos : line.find('"', name_begin+1);
+        assert_vcl(name_end!=std::string::npos, "Incorrect #include in "+path+" (line "+std::to_string(line_number)+")");
+        source += read_shader_file(directory+line.substr(name_begin+1, name_end-name_begin-1));
+        // Keep the line numbers of the compilation messages relative to the including file
+        source += "#line "+std::to_string(line_number+1)+"\n";
+    }
+    return source;
+}
+
 GLuint compile_shader(const std::string& shader_str, const GLenum shader_type)
 {
     const GLuint shader = glCreateShader(shader_type); assert( glIsShader(shader) );
@@ -81,8 +109,9 @@ GLuint compile_shader(const std::string& shader_str, const GLenum shader_type)
 
 GLuint create_shader_program(const std::string& vertex_shader_path, const std::string& fragment_shader_path)
 {
-    const std::string vertex_shader_str   = read_file_text(vertex_shader_path);
-    const std::string fragment_shader_str = read_file_text(fragment_shader_path);
+    VCL_TRACE_ZONE_DETAIL("create_shader_program", vertex_shader_path);
+    const std::string vertex_shader_str   = read_shader_file(vertex_shader_path);
+    const std::string fragment_shader_str = read_shader_file(fragment_shader_path);
 
     const GLuint vertex_shader   = compile_shader(vertex_shader_str, GL_VERTEX_SHADER);
     const GLuint fragment_shader = compile_shader(fragment_shader_str, GL_FRAGMENT_SHADER);
@@ -103,6 +132,10 @@ GLuint create_shader_program(const std::string& vertex_shader_path, const std::s
 
     check_link(vertex_shader, fragment_shader, program);
 
+    // Resolve the uniform locations once, and attach the shared camera block
+    uniform_location_cache(program);
+    camera_uniform_block_bind(program);
+
     // Shader can be detached.
     glDetachShader( program, vertex_shader);
     glDetachShader( program, fragment_shader);
@@ -113,9 +146,10 @@ GLuint create_shader_program(const std::string& vertex_shader_path, const std::s
 
 GLuint create_shader_program(const std::string& vertex_shader_path, const std::string& geometry_shader_path, const std::string& fragment_shader_path)
 {
-    const std::string vertex_shader_str   = read_file_text(vertex_shader_path);
-    const std::string geometry_shader_str = read_file_text(geometry_shader_path);
-    const std::string fragment_shader_str = read_file_text(fragment_shader_path);
+    VCL_TRACE_ZONE_DETAIL("create_shader_program", vertex_shader_path);
+    const std::string vertex_shader_str   = read_shader_file(vertex_shader_path);
+    const std::string geometry_shader_str = read_shader_file(geometry_shader_path);
+    const std::string fragment_shader_str = read_shader_file(fragment_shader_path);
 
     const GLuint vertex_shader   = compile_shader(vertex_shader_str, GL_VERTEX_SHADER);
     const GLuint geometry_shader = compile_shader(geometry_shader_str, GL_GEOMETRY_SHADER);
@@ -139,6 +173,10 @@ GLuint create_shader_program(const std::string& vertex_shader_path, const std::s
 
     check_link(vertex_shader, fragment_shader, program);
 
+    // Resolve the uniform locations once, and attach the shared camera block
+    uniform_location_cache(program);
+    camera_uniform_block_bind(program);
+
     // Shader can be detached.
     glDetachShader( program, vertex_shader);
     glDetachShader( program, geometry_shader);
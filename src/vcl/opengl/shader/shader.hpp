@@ -7,13 +7,19 @@
 namespace vcl
 {
 
+/** Read the source of a shader.
+ *  The lines #include "file" are replaced by the content of the file, whose path is relative to the including file
+ *  (ex. the camera_data block shared by all the shaders). */
+std::string read_shader_file(const std::string& path);
+
 /** Compile an individual shader provided as a string.
  * Check that the compilation succeed. */
 GLuint compile_shader(const std::string& shader_str, const GLenum shader_type);
 
 
 /** Compile vertex and fragment shaders provided from their file paths, link them, and return a shader program.
- * Check that link operation succeed. */
+ * Check that link operation succeed.
+ * The locations of the active uniforms are cached, and the camera_data uniform block (if any) is bound to the camera uniform buffer. */
 GLuint create_shader_program(const std::string& vertex_shader_path, const std::string& fragment_shader_path);
 
 GLuint create_shader_program(const std::string& vertex_shader_path, const std::string& geometry_shader_path, const std::string& fragment_shader_path);
@@ -0,0 +1,174 @@
+#include "state_cache.hpp"
+
+namespace vcl
+{
+
+static int texture_target_index(GLenum target)
+{
+    switch(target)
+    {
+    case GL_TEXTURE_1D: return 0;
+    case GL_TEXTURE_2D: return 1;
+    case GL_TEXTURE_2D_ARRAY: return 2;
+    case GL_TEXTURE_BUFFER: return 3;
+    default: return -1;
+    }
+}
+
+static int capability_index(GLenum capability)
+{
+    switch(capability)
+    {
+    case GL_BLEND: return 0;
+    case GL_DEPTH_TEST: return 1;
+    case GL_CULL_FACE: return 2;
+    case GL_POLYGON_OFFSET_FILL: return 3;
+    default: return -1;
+    }
+}
+
+
+gl_state_cache::gl_state_cache()
+    :current_program(0),known_program(false),current_vao(0),known_vao(false),current_active_unit(0),known_active_unit(false),
+      current_texture(),known_texture(),current_capability(),known_capability(),
+      current_blend(),known_blend(false),current_depth_mask(true),known_depth_mask(false),current_offset(),known_offset(false),
+      current({0,0,0,0}),previous({0,0,0,0})
+{
+    invalidate();
+}
+
+template <typename T> bool gl_state_cache::update(T& shadow, bool& known, const T& value)
+{
+    if(known && shadow==value) {
+        current.skipped++;
+        return false;
+    }
+    shadow = value;
+    known = true;
+    current.issued++;
+    return true;
+}
+
+void gl_state_cache::use_program(GLuint program)
+{
+    if(update(current_program, known_program, program))
+        glUseProgram(program);
+}
+
+void gl_state_cache::bind_vertex_array(GLuint vao)
+{
+    if(update(current_vao, known_vao, vao))
+        glBindVertexArray(vao);
+}
+
+void gl_state_cache::bind_texture(GLenum target, GLuint texture, unsigned int unit)
+{
+    const int k = texture_target_index(target);
+    if(k<0 || unit>=max_texture_unit) {
+        current.issued++;
+        glActiveTexture(GL_TEXTURE0+unit);
+        glBindTexture(target, texture);
+        known_active_unit = false;
+        return;
+    }
+
+    if(known_texture[k][unit] && current_texture[k][unit]==texture) {
+        current.skipped++;
+        return;
+    }
+    if(update(current_active_unit, known_active_unit, unit))
+        glActiveTexture(GL_TEXTURE0+unit);
+    if(update(current_texture[k][unit], known_texture[k][unit], texture))
+        glBindTexture(target, texture);
+}
+
+void gl_state_cache::set_capability(GLenum capability, bool enabled)
+{
+    const int k = capability_index(capability);
+    bool issue = true;
+    if(k>=0)
+        issue = update(current_capability[k], known_capability[k], enabled);
+    else
+        current.issued++;
+
+    if(issue) {
+        if(enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+}
+
+void gl_state_cache::blend_function(GLenum source_factor, GLenum destination_factor)
+{
+    const std::array<GLenum,2> value = {{source_factor, destination_factor}};
+    if(update(current_blend, known_blend, value))
+        glBlendFunc(source_factor, destination_factor);
+}
+
+void gl_state_cache::depth_mask(bool write)
+{
+    if(update(current_depth_mask, known_depth_mask, write))
+        glDepthMask(write? GL_TRUE : GL_FALSE);
+}
+
+void gl_state_cache::polygon_offset(float factor, float units)
+{
+    const std::array<float,2> value = {{factor, units}};
+    if(update(current_offset, known_offset, value))
+        glPolygonOffset(factor, units);
+}
+
+GLuint gl_state_cache::program() const
+{
+    return known_program? current_program : 0;
+}
+
+GLuint gl_state_cache::vertex_array() const
+{
+    return known_vao? current_vao : 0;
+}
+
+void gl_state_cache::invalidate()
+{
+    known_program = false;
+    known_vao = false;
+    known_active_unit = false;
+    for(auto& known_unit : known_texture)
+        known_unit.fill(false);
+    known_capability.fill(false);
+    known_blend = false;
+    known_depth_mask = false;
+    known_offset = false;
+}
+
+gl_state_cache::counters gl_state_cache::current_counters() const
+{
+    return current;
+}
+
+gl_state_cache::counters gl_state_cache::previous_frame_counters() const
+{
+    return previous;
+}
+
+void gl_state_cache::new_frame()
+{
+    previous = current;
+    current = {0,0,0,0};
+}
+
+void gl_state_cache::count_draw(unsigned long triangles)
+{
+    current.draw_calls++;
+    current.triangles += triangles;
+}
+
+
+gl_state_cache& gl_state()
+{
+    static gl_state_cache state;
+    return state;
+}
+
+}
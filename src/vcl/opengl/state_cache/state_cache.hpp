@@ -0,0 +1,82 @@
+#pragma once
+
+#include "vcl/wrapper/glad/glad.hpp"
+
+#include <array>
+
+namespace vcl
+{
+
+/** Shadow copy of the OpenGL state set by VCL (program, VAO, textures per unit, blend/depth state, polygon offset).
+ *  Each setter compares the requested value with the shadowed one and skips the OpenGL call when nothing changes.
+ *  The state is unknown at start (the first call is always issued).
+ *  If raw OpenGL calls modify the same state outside of the cache, invalidate() must be called afterwards. */
+class gl_state_cache
+{
+public:
+    gl_state_cache();
+
+    void use_program(GLuint program);
+    void bind_vertex_array(GLuint vao);
+    /** Bind a texture to a texture unit (the active unit is left to this unit) */
+    void bind_texture(GLenum target, GLuint texture, unsigned int unit=0);
+    /** glEnable/glDisable. Only GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE and GL_POLYGON_OFFSET_FILL are shadowed, other capabilities are always issued */
+    void set_capability(GLenum capability, bool enabled);
+    void blend_function(GLenum source_factor, GLenum destination_factor);
+    void depth_mask(bool write);
+    void polygon_offset(float factor, float units);
+
+    /** Current program and VAO as last set through the cache (0 if unknown) */
+    GLuint program() const;
+    GLuint vertex_array() const;
+
+    /** Forget the whole shadowed state: next calls are issued */
+    void invalidate();
+
+    /** Number of calls sent to OpenGL or skipped, and draw calls with their number of triangles */
+    struct counters
+    {
+        unsigned long issued;
+        unsigned long skipped;
+        unsigned long draw_calls;
+        unsigned long triangles;
+    };
+    /** Record a draw call (called by the VCL draw functions, lines count as 0 triangle) */
+    void count_draw(unsigned long triangles);
+    /** Counters since the last call to new_frame() */
+    counters current_counters() const;
+    /** Counters of the previous frame */
+    counters previous_frame_counters() const;
+    /** Store the current counters as the ones of the previous frame and reset them (expected once per frame) */
+    void new_frame();
+
+    static const unsigned int max_texture_unit = 16;
+
+private:
+    // Return true (and store the value) if the call must be issued
+    template <typename T> bool update(T& shadow, bool& known, const T& value);
+
+    GLuint current_program;           bool known_program;
+    GLuint current_vao;               bool known_vao;
+    unsigned int current_active_unit; bool known_active_unit;
+
+    // Textures bound for each shadowed target (1D, 2D, 2D array, buffer) and unit
+    std::array<std::array<GLuint,max_texture_unit>,4> current_texture;
+    std::array<std::array<bool,max_texture_unit>,4> known_texture;
+
+    // GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_POLYGON_OFFSET_FILL
+    std::array<bool,4> current_capability;
+    std::array<bool,4> known_capability;
+
+    std::array<GLenum,2> current_blend;  bool known_blend;
+    bool current_depth_mask;             bool known_depth_mask;
+    std::array<float,2> current_offset;  bool known_offset;
+
+    counters current;
+    counters previous;
+};
+
+/** State cache of the OpenGL context used by VCL */
+gl_state_cache& gl_state();
+
+}
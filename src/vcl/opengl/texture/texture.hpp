@@ -1,3 +1,5 @@
 
 #include "image/image.hpp"
 #include "texture_gpu/texture_gpu.hpp"
+#include "texture_container/texture_container.hpp"
+#include "texture_array/texture_array.hpp"
@@ -0,0 +1,252 @@
+#include "texture_array.hpp"
+
+#include "../../state_cache/state_cache.hpp"
+#include "vcl/wrapper/lodepng/lodepng.hpp"
+#include "vcl/base/error/error.hpp"
+#include "vcl/base/parallel/parallel.hpp"
+#include "vcl/base/trace/trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+// S3TC formats (EXT_texture_compression_s3tc, not part of the generated loader)
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace vcl
+{
+
+texture_array_mipmaps::texture_array_mipmaps()
+    :format(texture_format::rgba8),width(0),height(0),layer_count(0),levels()
+{}
+
+static unsigned int level_dimension(unsigned int dimension, unsigned int k)
+{
+    return std::max(1u, dimension>>k);
+}
+
+image_raw image_resample(const image_raw& im, unsigned int width, unsigned int height)
+{
+    assert_vcl(im.width>0 && im.height>0 && width>0 && height>0, "Empty image");
+    const size_t channels = im.color_type==image_color_type::rgba? 4 : 3;
+    image_raw resampled(width, height, image_color_type::rgba, std::vector<unsigned char>(4*size_t(width)*size_t(height)));
+
+    // Texel centers of the result mapped onto the texel centers of the source
+    const float sx = im.width/float(width);
+    const float sy = im.height/float(height);
+    parallel_for(0, height, 32, [&](size_t y_begin, size_t y_end){
+        for(size_t y=y_begin; y<y_end; ++y)
+        {
+            const float fy = std::min(std::max((y+0.5f)*sy-0.5f, 0.0f), float(im.height-1));
+            const size_t y0 = size_t(fy);
+            const size_t y1 = std::min(y0+1, size_t(im.height-1));
+            const float ty = fy-y0;
+            for(size_t x=0; x<width; ++x)
+            {
+                const float fx = std::min(std::max((x+0.5f)*sx-0.5f, 0.0f), float(im.width-1));
+                const size_t x0 = size_t(fx);
+                const size_t x1 = std::min(x0+1, size_t(im.width-1));
+                const float tx = fx-x0;
+
+                const unsigned char* p00 = &im.data[channels*(x0+im.width*y0)];
+                const unsigned char* p10 = &im.data[channels*(x1+im.width*y0)];
+                const unsigned char* p01 = &im.data[channels*(x0+im.width*y1)];
+                const unsigned char* p11 = &im.data[channels*(x1+im.width*y1)];
+                unsigned char* out = &resampled.data[4*(x+width*y)];
+                for(size_t c=0; c<channels; ++c) {
+                    const float v = (1-ty)*((1-tx)*p00[c]+tx*p10[c]) + ty*((1-tx)*p01[c]+tx*p11[c]);
+                    out[c] = static_cast<unsigned char>(std::lround(v));
+                }
+                if(channels==3)
+                    out[3] = 255;
+            }
+        }
+    });
+    return resampled;
+}
+
+// Array made of layers built with texture_build_mipmaps: each level of a layer is appended after the same level of the previous layers
+static texture_array_mipmaps concatenate_layers(const std::vector<texture_mipmaps>& layers, unsigned int width, unsigned int height, texture_format format)
+{
+    texture_array_mipmaps mipmaps;
+    mipmaps.format = format;
+    mipmaps.width = width;
+    mipmaps.height = height;
+    mipmaps.layer_count = static_cast<unsigned int>(layers.size());
+    for(const texture_mipmaps& layer : layers)
+    {
+        if(mipmaps.levels.empty())
+            mipmaps.levels.resize(layer.levels.size());
+        for(size_t k=0; k<layer.levels.size(); ++k)
+            mipmaps.levels[k].insert(mipmaps.levels[k].end(), layer.levels[k].begin(), layer.levels[k].end());
+    }
+    return mipmaps;
+}
+
+// Mip chain of an image resampled to width x height
+static texture_mipmaps build_layer(const image_raw& im, unsigned int width, unsigned int height, texture_format format)
+{
+    const bool same_size = im.width==width && im.height==height;
+    return texture_build_mipmaps(same_size? im : image_resample(im, width, height), format);
+}
+
+texture_array_mipmaps texture_array_build_mipmaps(const std::vector<image_raw>& images, unsigned int width, unsigned int height, texture_format format)
+{
+    VCL_TRACE_ZONE("texture_array_build_mipmaps");
+    assert_vcl(images.size()>0, "Texture array without layer");
+
+    std::vector<texture_mipmaps> layers;
+    for(const image_raw& im : images)
+        layers.push_back(build_layer(im, width, height, format));
+    return concatenate_layers(layers, width, height, format);
+}
+
+texture_format texture_compressed_format(const std::vector<image_raw>& images)
+{
+    for(const image_raw& im : images)
+        if(texture_compressed_format(im)==texture_format::bc3)
+            return texture_format::bc3;
+    return texture_format::bc1;
+}
+
+// Upload the levels [0,N[ of layer_count layers (data and size of the level k of a layer given by level(k,layer))
+static GLuint create_texture_array_levels(texture_format format, unsigned int width, unsigned int height, unsigned int layer_count, unsigned int N,
+                                          const std::function<std::pair<const unsigned char*,size_t>(unsigned int,unsigned int)>& level,
+                                          GLint wrap_s, GLint wrap_t)
+{
+    GLuint id = 0;
+    glGenTextures(1,&id);
+    gl_state().bind_texture(GL_TEXTURE_2D_ARRAY,id);
+
+    // Allocate every stored level for all the layers, then send the layers one by one
+    const GLenum internal_format = format==texture_format::bc1? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    for(unsigned int k=0; k<N; ++k)
+    {
+        const GLsizei w = GLsizei(level_dimension(width, k));
+        const GLsizei h = GLsizei(level_dimension(height, k));
+        const GLsizei d = GLsizei(layer_count);
+        if(format==texture_format::rgba8)
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, GLint(k), GL_RGBA8, w, h, d, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        else
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, GLint(k), internal_format, w, h, d, 0, GLsizei(level(k,0).second*layer_count), nullptr);
+
+        for(unsigned int layer=0; layer<layer_count; ++layer)
+        {
+            const std::pair<const unsigned char*,size_t> data = level(k,layer);
+            if(format==texture_format::rgba8)
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, GLint(k), 0, 0, GLint(layer), w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, data.first);
+            else
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, GLint(k), 0, 0, GLint(layer), w, h, 1, internal_format, GLsizei(data.second), data.first);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, GLint(N)-1);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap_s);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap_t);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+    gl_state().bind_texture(GL_TEXTURE_2D_ARRAY,0);
+
+    return id;
+}
+
+GLuint create_texture_array_gpu(const texture_array_mipmaps& mipmaps, GLint wrap_s, GLint wrap_t)
+{
+    assert_vcl(mipmaps.levels.size()>0 && mipmaps.layer_count>0, "Texture array without level");
+    return create_texture_array_levels(mipmaps.format, mipmaps.width, mipmaps.height, mipmaps.layer_count, unsigned(mipmaps.levels.size()),
+                                       [&](unsigned int k, unsigned int layer){
+                                           const size_t size = mipmaps.levels[k].size()/mipmaps.layer_count;
+                                           return std::make_pair(mipmaps.levels[k].data()+layer*size, size); },
+                                       wrap_s, wrap_t);
+}
+
+GLuint create_texture_array_gpu(const std::vector<texture_file>& layers, GLint wrap_s, GLint wrap_t)
+{
+    assert_vcl(layers.size()>0, "Texture array without layer");
+    const texture_file& first = layers[0];
+    for(const texture_file& layer : layers)
+        assert_vcl(layer.is_open() && layer.format()==first.format() && layer.width()==first.width() && layer.height()==first.height()
+                   && layer.level_count()==first.level_count(), "Layers of different sizes or formats");
+    return create_texture_array_levels(first.format(), first.width(), first.height(), unsigned(layers.size()), first.level_count(),
+                                       [&](unsigned int k, unsigned int layer){ return std::make_pair(layers[layer].level(k), layers[layer].level_size(k)); },
+                                       wrap_s, wrap_t);
+}
+
+
+std::string texture_array_cache_filename(const std::string& filename, unsigned int width, unsigned int height)
+{
+    return filename+"."+std::to_string(width)+"x"+std::to_string(height)+".vcltex";
+}
+
+// Map the container of a layer if it has been baked from the current version of the image, at this size, with the requested kind of format
+static bool open_layer_cache(const std::string& filename, const file_stamp& stamp, unsigned int width, unsigned int height, bool compress, texture_file& cache)
+{
+    if(!cache.open(texture_array_cache_filename(filename, width, height)))
+        return false;
+    if(cache.header->source!=stamp || cache.width()!=width || cache.height()!=height || (cache.format()!=texture_format::rgba8)!=compress) {
+        cache.close();
+        return false;
+    }
+    return true;
+}
+
+bool texture_array_load_files_png(const std::vector<std::string>& filenames, unsigned int width, unsigned int height, bool compress,
+                                  std::vector<texture_file>& layers, texture_array_mipmaps& mipmaps)
+{
+    VCL_TRACE_ZONE("texture_array_load_files_png");
+    assert_vcl(filenames.size()>0, "Texture array without layer");
+    const size_t N = filenames.size();
+    layers.clear();
+    layers.resize(N);
+
+    std::vector<file_stamp> stamps(N);
+    bool stamped = true;
+    for(size_t k=0; stamped && k<N; ++k)
+        stamped = read_file_stamp(filenames[k], stamps[k]);
+
+    // The containers are used if they are all up to date and share one format
+    bool cached = stamped;
+    for(size_t k=0; cached && k<N; ++k)
+        cached = open_layer_cache(filenames[k], stamps[k], width, height, compress, layers[k])
+                && layers[k].format()==layers[0].format() && layers[k].level_count()==layers[0].level_count();
+    if(cached)
+        return true;
+    layers.clear();
+
+    // Otherwise every layer is baked again: the format depends on all the images
+    std::vector<image_raw> images(N);
+    parallel_for(0, N, 1, [&](size_t k_begin, size_t k_end){
+        for(size_t k=k_begin; k<k_end; ++k)
+            images[k] = image_load_png(filenames[k]);
+    });
+    const texture_format format = compress? texture_compressed_format(images) : texture_format::rgba8;
+    std::vector<texture_mipmaps> built(N);
+    bool saved = stamped;
+    for(size_t k=0; k<N; ++k) {
+        built[k] = build_layer(images[k], width, height, format);
+        saved = saved && texture_save_file(texture_array_cache_filename(filenames[k], width, height), built[k], stamps[k]);
+    }
+
+    if(saved) {
+        layers.resize(N);
+        bool opened = true;
+        for(size_t k=0; opened && k<N; ++k)
+            opened = open_layer_cache(filenames[k], stamps[k], width, height, compress, layers[k]);
+        if(opened)
+            return true;
+        layers.clear();
+    }
+
+    // The containers cannot be written: the layers built in memory are returned instead
+    mipmaps = concatenate_layers(built, width, height, format);
+    return false;
+}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "vcl/wrapper/glad/glad.hpp"
+#include "../image/image.hpp"
+#include "../texture_container/texture_container.hpp"
+
+#include <string>
+#include <vector>
+
+namespace vcl
+{
+
+/** Layers of a 2D texture array with their mip chains. All the layers have the same size and format.
+ *  levels[k] stores the level k of every layer one after the other (the layout expected by glTexImage3D). */
+struct texture_array_mipmaps
+{
+    texture_array_mipmaps();
+
+    texture_format format;
+    unsigned int width;
+    unsigned int height;
+    unsigned int layer_count;
+    std::vector<std::vector<unsigned char>> levels;
+};
+
+/** Bilinear resampling of an image to width x height (RGBA result).
+ *  Suited to scale factors between 1/2 and 2; larger reductions skip texels. */
+image_raw image_resample(const image_raw& im, unsigned int width, unsigned int height);
+
+/** Resample each image to width x height and build its mip chain in the given format: images[k] becomes the layer k */
+texture_array_mipmaps texture_array_build_mipmaps(const std::vector<image_raw>& images, unsigned int width, unsigned int height, texture_format format);
+
+/** Block compressed format adapted to a set of images: bc1 if they are all opaque, bc3 otherwise */
+texture_format texture_compressed_format(const std::vector<image_raw>& images);
+
+/** Create a GL_TEXTURE_2D_ARRAY from all its stored levels. The sampling parameters are shared by all the layers.
+ *  Compressed formats require texture_compression_supported(). */
+GLuint create_texture_array_gpu(const texture_array_mipmaps& mipmaps, GLint wrap_s=GL_REPEAT, GLint wrap_t=GL_REPEAT);
+/** Create a GL_TEXTURE_2D_ARRAY from containers of the same size, format and number of levels: layers[k] becomes the layer k */
+GLuint create_texture_array_gpu(const std::vector<texture_file>& layers, GLint wrap_s=GL_REPEAT, GLint wrap_t=GL_REPEAT);
+
+
+/** Name of the container baked from an image file resampled to width x height */
+std::string texture_array_cache_filename(const std::string& filename, unsigned int width, unsigned int height);
+
+/** Map the containers baked from PNG files resampled to width x height (filename.WxH.vcltex), one per layer.
+ *  Every container is written first if one of them is missing, older than its PNG file, or if they don't share a format of the requested kind
+ *  (compress: texture_compressed_format of all the images, otherwise rgba8).
+ *  Return false if the containers cannot be written (ex. read-only directory): layers is then empty and mipmaps holds the layers built in memory. */
+bool texture_array_load_files_png(const std::vector<std::string>& filenames, unsigned int width, unsigned int height, bool compress,
+                                  std::vector<texture_file>& layers, texture_array_mipmaps& mipmaps);
+
+}
@@ -0,0 +1,550 @@
+#include "texture_container.hpp"
+
+#include "../../state_cache/state_cache.hpp"
+#include "vcl/wrapper/lodepng/lodepng.hpp"
+#include "vcl/base/error/error.hpp"
+#include "vcl/base/parallel/parallel.hpp"
+#include "vcl/base/trace/trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+// S3TC formats (EXT_texture_compression_s3tc, not part of the generated loader)
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace vcl
+{
+
+static const char texture_file_magic[8] = {'V','C','L','T','E','X','\0','\0'};
+static const uint32_t texture_file_version = 1;
+static const size_t texture_file_alignment = 16;
+
+static_assert(sizeof(texture_file_header)%texture_file_alignment==0, "The first level must be aligned after the header");
+
+texture_mipmaps::texture_mipmaps()
+    :format(texture_format::rgba8),width(0),height(0),levels()
+{}
+
+
+// Size of the level k of a texture
+static unsigned int level_dimension(unsigned int dimension, unsigned int k)
+{
+    return std::max(dimension>>k, 1u);
+}
+
+// Number of levels down to 1x1
+static unsigned int full_level_count(unsigned int width, unsigned int height)
+{
+    unsigned int N = 1;
+    while((std::max(width,height)>>N)>0)
+        ++N;
+    return N;
+}
+
+// Bytes of a level of size width x height
+static size_t level_byte_size(texture_format format, unsigned int width, unsigned int height)
+{
+    const size_t blocks = size_t((width+3)/4) * size_t((height+3)/4);
+    switch(format) {
+    case texture_format::bc1: return 8*blocks;
+    case texture_format::bc3: return 16*blocks;
+    default: return 4*size_t(width)*size_t(height);
+    }
+}
+
+
+// Next level of the mip chain: average of 2x2 texels (the last row/column is repeated for odd sizes)
+static std::vector<unsigned char> downsample(const std::vector<unsigned char>& rgba, unsigned int width, unsigned int height)
+{
+    const unsigned int w = level_dimension(width, 1);
+    const unsigned int h = level_dimension(height, 1);
+    std::vector<unsigned char> next(4*size_t(w)*size_t(h));
+    for(unsigned int y=0; y<h; ++y)
+    {
+        const size_t y0 = std::min(2*y, height-1);
+        const size_t y1 = std::min(2*y+1, height-1);
+        for(unsigned int x=0; x<w; ++x)
+        {
+            const size_t x0 = std::min(2*x, width-1);
+            const size_t x1 = std::min(2*x+1, width-1);
+            for(size_t c=0; c<4; ++c) {
+                const unsigned int sum = rgba[4*(x0+width*y0)+c] + rgba[4*(x1+width*y0)+c] + rgba[4*(x0+width*y1)+c] + rgba[4*(x1+width*y1)+c];
+                next[4*(x+size_t(w)*y)+c] = static_cast<unsigned char>((sum+2)/4);
+            }
+        }
+    }
+    return next;
+}
+
+
+// Block compression
+//  Colors: the endpoints are the texels at both ends of the principal axis of the block colors (in RGB565),
+//  each texel takes the nearest of the 4 interpolated colors.
+//  Alpha (bc3): the endpoints are the minimal and maximal alpha, each texel takes the nearest of the 8 interpolated values.
+
+static uint16_t rgb565(const unsigned char* c)
+{
+    return static_cast<uint16_t>(((c[0]*31+127)/255)<<11 | ((c[1]*63+127)/255)<<5 | ((c[2]*31+127)/255));
+}
+
+static void rgb888(uint16_t c, int* rgb)
+{
+    const int r = (c>>11)&31, g = (c>>5)&63, b = c&31;
+    rgb[0] = (r<<3)|(r>>2);
+    rgb[1] = (g<<2)|(g>>4);
+    rgb[2] = (b<<3)|(b>>2);
+}
+
+static void write_u16(unsigned char* out, uint16_t v)
+{
+    out[0] = static_cast<unsigned char>(v&0xFF);
+    out[1] = static_cast<unsigned char>(v>>8);
+}
+
+// Color part of bc1/bc3 (8 bytes, always in the 4 colors mode)
+static void encode_color_block(const unsigned char texels[16][4], unsigned char* out)
+{
+    float mean[3] = {0,0,0};
+    for(size_t k=0; k<16; ++k)
+        for(size_t i=0; i<3; ++i)
+            mean[i] += texels[k][i]/16.0f;
+
+    float covariance[3][3] = {};
+    for(size_t k=0; k<16; ++k)
+        for(size_t i=0; i<3; ++i)
+            for(size_t j=0; j<3; ++j)
+                covariance[i][j] += (texels[k][i]-mean[i])*(texels[k][j]-mean[j]);
+
+    // Principal axis by power iteration
+    float axis[3] = {1,1,1};
+    for(size_t iteration=0; iteration<8; ++iteration) {
+        float next[3] = {0,0,0};
+        for(size_t i=0; i<3; ++i)
+            for(size_t j=0; j<3; ++j)
+                next[i] += covariance[i][j]*axis[j];
+        const float norm = std::max(std::abs(next[0]), std::max(std::abs(next[1]), std::abs(next[2])));
+        if(norm<1e-6f)
+            break;
+        for(size_t i=0; i<3; ++i)
+            axis[i] = next[i]/norm;
+    }
+
+    size_t k_min = 0, k_max = 0;
+    float t_min = 0, t_max = 0;
+    for(size_t k=0; k<16; ++k) {
+        const float t = texels[k][0]*axis[0] + texels[k][1]*axis[1] + texels[k][2]*axis[2];
+        if(k==0 || t<t_min) { t_min = t; k_min = k; }
+        if(k==0 || t>t_max) { t_max = t; k_max = k; }
+    }
+
+    uint16_t c0 = rgb565(texels[k_max]);
+    uint16_t c1 = rgb565(texels[k_min]);
+    if(c0<c1)
+        std::swap(c0, c1);
+    write_u16(out, c0);
+    write_u16(out+2, c1);
+
+    uint32_t indices = 0;
+    if(c0!=c1)
+    {
+        int palette[4][3];
+        rgb888(c0, palette[0]);
+        rgb888(c1, palette[1]);
+        for(size_t i=0; i<3; ++i) {
+            palette[2][i] = (2*palette[0][i]+palette[1][i])/3;
+            palette[3][i] = (palette[0][i]+2*palette[1][i])/3;
+        }
+        for(size_t k=0; k<16; ++k) {
+            uint32_t best = 0;
+            int best_distance = -1;
+            for(uint32_t p=0; p<4; ++p) {
+                int distance = 0;
+                for(size_t i=0; i<3; ++i)
+                    distance += (texels[k][i]-palette[p][i])*(texels[k][i]-palette[p][i]);
+                if(best_distance<0 || distance<best_distance) {
+                    best_distance = distance;
+                    best = p;
+                }
+            }
+            indices |= best << (2*k);
+        }
+    }
+    for(size_t b=0; b<4; ++b)
+        out[4+b] = static_cast<unsigned char>((indices>>(8*b))&0xFF);
+}
+
+// Alpha part of bc3 (8 bytes, 8 values mode)
+static void encode_alpha_block(const unsigned char texels[16][4], unsigned char* out)
+{
+    int a0 = 0, a1 = 255;
+    for(size_t k=0; k<16; ++k) {
+        a0 = std::max(a0, int(texels[k][3]));
+        a1 = std::min(a1, int(texels[k][3]));
+    }
+    out[0] = static_cast<unsigned char>(a0);
+    out[1] = static_cast<unsigned char>(a1);
+
+    uint64_t indices = 0;
+    if(a0!=a1)
+    {
+        int palette[8] = {a0, a1};
+        for(int p=2; p<8; ++p)
+            palette[p] = ((8-p)*a0 + (p-1)*a1)/7;
+        for(size_t k=0; k<16; ++k) {
+            uint64_t best = 0;
+            for(uint64_t p=1; p<8; ++p)
+                if(std::abs(texels[k][3]-palette[p]) < std::abs(texels[k][3]-palette[best]))
+                    best = p;
+            indices |= best << (3*k);
+        }
+    }
+    for(size_t b=0; b<6; ++b)
+        out[2+b] = static_cast<unsigned char>((indices>>(8*b))&0xFF);
+}
+
+static std::vector<unsigned char> encode_blocks(const std::vector<unsigned char>& rgba, unsigned int width, unsigned int height, texture_format format)
+{
+    const unsigned int block_x = (width+3)/4;
+    const unsigned int block_y = (height+3)/4;
+    const size_t block_size = format==texture_format::bc1? 8 : 16;
+    std::vector<unsigned char> blocks(block_size*block_x*block_y);
+
+    parallel_for(0, block_y, 16, [&](size_t by_begin, size_t by_end){
+        unsigned char texels[16][4];
+        for(size_t by=by_begin; by<by_end; ++by) {
+            for(size_t bx=0; bx<block_x; ++bx)
+            {
+                // Texels of the block (the border texels are repeated in the blocks crossing the image border)
+                for(size_t k=0; k<16; ++k) {
+                    const size_t x = std::min(4*bx+k%4, size_t(width-1));
+                    const size_t y = std::min(4*by+k/4, size_t(height-1));
+                    std::memcpy(texels[k], &rgba[4*(x+width*y)], 4);
+                }
+
+                unsigned char* out = &blocks[block_size*(bx+block_x*by)];
+                if(format==texture_format::bc3) {
+                    encode_alpha_block(texels, out);
+                    out += 8;
+                }
+                encode_color_block(texels, out);
+            }
+        }
+    });
+    return blocks;
+}
+
+static std::vector<unsigned char> to_rgba(const image_raw& im)
+{
+    if(im.color_type==image_color_type::rgba)
+        return im.data;
+    const size_t N = size_t(im.width)*size_t(im.height);
+    std::vector<unsigned char> rgba(4*N);
+    for(size_t k=0; k<N; ++k) {
+        std::memcpy(&rgba[4*k], &im.data[3*k], 3);
+        rgba[4*k+3] = 255;
+    }
+    return rgba;
+}
+
+texture_mipmaps texture_build_mipmaps(const image_raw& im, texture_format format)
+{
+    VCL_TRACE_ZONE("texture_build_mipmaps");
+    assert_vcl(im.width>0 && im.height>0, "Empty image");
+    assert_vcl(full_level_count(im.width, im.height)<=texture_file_max_levels, "Image too large ("+std::to_string(im.width)+"x"+std::to_string(im.height)+")");
+
+    texture_mipmaps mipmaps;
+    mipmaps.format = format;
+    mipmaps.width = im.width;
+    mipmaps.height = im.height;
+
+    const unsigned int N = full_level_count(im.width, im.height);
+    std::vector<unsigned char> rgba = to_rgba(im);
+    for(unsigned int k=0; k<N; ++k)
+    {
+        const unsigned int w = level_dimension(im.width, k);
+        const unsigned int h = level_dimension(im.height, k);
+        if(format==texture_format::rgba8)
+            mipmaps.levels.push_back(rgba);
+        else
+            mipmaps.levels.push_back(encode_blocks(rgba, w, h, format));
+        if(k+1<N)
+            rgba = downsample(rgba, w, h);
+    }
+    return mipmaps;
+}
+
+texture_format texture_compressed_format(const image_raw& im)
+{
+    if(im.color_type==image_color_type::rgba)
+        for(size_t k=3; k<im.data.size(); k+=4)
+            if(im.data[k]!=255)
+                return texture_format::bc3;
+    return texture_format::bc1;
+}
+
+bool texture_compression_supported()
+{
+    GLint N = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &N);
+    for(GLint k=0; k<N; ++k) {
+        const GLubyte* name = glGetStringi(GL_EXTENSIONS, GLuint(k));
+        if(name!=nullptr && std::strcmp(reinterpret_cast<const char*>(name), "GL_EXT_texture_compression_s3tc")==0)
+            return true;
+    }
+    return false;
+}
+
+
+static uint64_t aligned(uint64_t offset)
+{
+    return (offset + texture_file_alignment - 1) & ~uint64_t(texture_file_alignment - 1);
+}
+
+bool texture_save_file(const std::string& filename, const texture_mipmaps& mipmaps, const file_stamp& source)
+{
+    const size_t N = mipmaps.levels.size();
+    assert_vcl(N>0 && N<=texture_file_max_levels, "Incorrect number of levels ("+std::to_string(N)+")");
+    for(size_t k=0; k<N; ++k)
+        assert_vcl_no_msg(mipmaps.levels[k].size()==level_byte_size(mipmaps.format, level_dimension(mipmaps.width, unsigned(k)), level_dimension(mipmaps.height, unsigned(k))));
+
+    texture_file_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, texture_file_magic, sizeof(texture_file_magic));
+    header.version = texture_file_version;
+    header.format = static_cast<uint32_t>(mipmaps.format);
+    header.width = mipmaps.width;
+    header.height = mipmaps.height;
+    header.level_count = uint32_t(N);
+    header.source = source;
+
+    uint64_t offset = sizeof(texture_file_header);
+    for(size_t k=0; k<N; ++k) {
+        header.offset[k] = offset;
+        header.size[k] = mipmaps.levels[k].size();
+        offset = aligned(offset + header.size[k]);
+    }
+    header.payload_size = offset - sizeof(texture_file_header);
+
+    // Temporary name specific to the thread: the same image can be baked by several loading tasks
+    static const char padding[texture_file_alignment] = {};
+    const std::string temporary = filename+".tmp"+std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream stream(temporary, std::ios::binary);
+        if(!stream.is_open())
+            return false;
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for(size_t k=0; k<N; ++k) {
+            const std::vector<unsigned char>& level = mipmaps.levels[k];
+            stream.write(reinterpret_cast<const char*>(level.data()), std::streamsize(level.size()));
+            stream.write(padding, std::streamsize(aligned(level.size())-level.size()));
+        }
+        if(!stream.good()) {
+            stream.close();
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+
+    // rename doesn't replace an existing file on Windows
+    std::remove(filename.c_str());
+    if(std::rename(temporary.c_str(), filename.c_str())!=0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+texture_file::texture_file()
+    :header(nullptr),file()
+{}
+
+texture_file::texture_file(texture_file&& other)
+    :header(other.header),file(std::move(other.file))
+{
+    other.header = nullptr;
+}
+
+texture_file& texture_file::operator=(texture_file&& other)
+{
+    if(this!=&other) {
+        file = std::move(other.file);
+        header = other.header;
+        other.header = nullptr;
+    }
+    return *this;
+}
+
+bool texture_file::open(const std::string& filename)
+{
+    close();
+    if(!file.open(filename) || file.size()<sizeof(texture_file_header)) {
+        close();
+        return false;
+    }
+
+    const texture_file_header* h = reinterpret_cast<const texture_file_header*>(file.data());
+    bool valid = std::memcmp(h->magic, texture_file_magic, sizeof(texture_file_magic))==0 && h->version==texture_file_version
+            && h->format<=static_cast<uint32_t>(texture_format::bc3) && h->width>0 && h->height>0
+            && h->level_count>0 && h->level_count<=full_level_count(h->width, h->height) && h->level_count<=texture_file_max_levels
+            && h->payload_size==file.size()-sizeof(texture_file_header);
+
+    // Each level must have the expected size and lie in the file
+    for(uint32_t k=0; valid && k<h->level_count; ++k) {
+        const uint64_t expected = level_byte_size(texture_format(h->format), level_dimension(h->width, k), level_dimension(h->height, k));
+        valid = h->size[k]==expected && h->offset[k]>=sizeof(texture_file_header) && h->offset[k]%texture_file_alignment==0
+                && h->offset[k]<=file.size() && h->size[k]<=file.size()-h->offset[k];
+    }
+    if(!valid) {
+        close();
+        return false;
+    }
+
+    header = h;
+    return true;
+}
+
+void texture_file::close()
+{
+    file.close();
+    header = nullptr;
+}
+
+bool texture_file::is_open() const
+{
+    return header!=nullptr;
+}
+
+texture_format texture_file::format() const
+{
+    return header!=nullptr? texture_format(header->format) : texture_format::rgba8;
+}
+
+unsigned int texture_file::level_count() const
+{
+    return header!=nullptr? header->level_count : 0;
+}
+
+unsigned int texture_file::width(unsigned int level) const
+{
+    return header!=nullptr? level_dimension(header->width, level) : 0;
+}
+
+unsigned int texture_file::height(unsigned int level) const
+{
+    return header!=nullptr? level_dimension(header->height, level) : 0;
+}
+
+const unsigned char* texture_file::level(unsigned int k) const
+{
+    assert_vcl_no_msg(k<level_count());
+    return reinterpret_cast<const unsigned char*>(file.data()) + header->offset[k];
+}
+
+size_t texture_file::level_size(unsigned int k) const
+{
+    assert_vcl_no_msg(k<level_count());
+    return size_t(header->size[k]);
+}
+
+
+// Upload the levels [0,N[ (data and size of the level k given by level(k))
+static GLuint create_texture_levels(texture_format format, unsigned int width, unsigned int height, unsigned int N,
+                                    const std::function<std::pair<const unsigned char*,size_t>(unsigned int)>& level,
+                                    GLint wrap_s, GLint wrap_t)
+{
+    GLuint id = 0;
+    glGenTextures(1,&id);
+    gl_state().bind_texture(GL_TEXTURE_2D,id);
+
+    // Send every stored level
+    for(unsigned int k=0; k<N; ++k)
+    {
+        const std::pair<const unsigned char*,size_t> data = level(k);
+        const GLsizei w = GLsizei(level_dimension(width, k));
+        const GLsizei h = GLsizei(level_dimension(height, k));
+        if(format==texture_format::rgba8)
+            glTexImage2D(GL_TEXTURE_2D, GLint(k), GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data.first);
+        else {
+            const GLenum internal_format = format==texture_format::bc1? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            glCompressedTexImage2D(GL_TEXTURE_2D, GLint(k), internal_format, w, h, 0, GLsizei(data.second), data.first);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(N)-1);
+
+    // Set default texture behavior
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap_s);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap_t);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+    gl_state().bind_texture(GL_TEXTURE_2D,0);
+
+    return id;
+}
+
+GLuint create_texture_gpu(const texture_mipmaps& mipmaps, GLint wrap_s, GLint wrap_t)
+{
+    assert_vcl(mipmaps.levels.size()>0, "Texture without level");
+    return create_texture_levels(mipmaps.format, mipmaps.width, mipmaps.height, unsigned(mipmaps.levels.size()),
+                                 [&](unsigned int k){ return std::make_pair(mipmaps.levels[k].data(), mipmaps.levels[k].size()); },
+                                 wrap_s, wrap_t);
+}
+
+GLuint create_texture_gpu(const texture_file& file, GLint wrap_s, GLint wrap_t)
+{
+    assert_vcl(file.is_open(), "Texture file not open");
+    return create_texture_levels(file.format(), file.width(), file.height(), file.level_count(),
+                                 [&](unsigned int k){ return std::make_pair(file.level(k), file.level_size(k)); },
+                                 wrap_s, wrap_t);
+}
+
+
+std::string texture_cache_filename(const std::string& filename)
+{
+    return filename+".vcltex";
+}
+
+// Map the container if it has been baked from the current version of the image, with the requested kind of format
+static bool open_texture_cache(const std::string& filename, const file_stamp& stamp, bool compress, texture_file& cache)
+{
+    if(!cache.open(texture_cache_filename(filename)))
+        return false;
+    if(cache.header->source!=stamp || (cache.format()!=texture_format::rgba8)!=compress) {
+        cache.close();
+        return false;
+    }
+    return true;
+}
+
+bool texture_load_file_png(const std::string& filename, bool compress, texture_file& cache)
+{
+    VCL_TRACE_ZONE_DETAIL("texture_load_file_png", filename);
+
+    file_stamp stamp;
+    if(!read_file_stamp(filename, stamp))
+        return false;
+    if(open_texture_cache(filename, stamp, compress, cache))
+        return true;
+
+    const image_raw im = image_load_png(filename);
+    const texture_format format = compress? texture_compressed_format(im) : texture_format::rgba8;
+    if(!texture_save_file(texture_cache_filename(filename), texture_build_mipmaps(im, format), stamp))
+        return false;
+    return open_texture_cache(filename, stamp, compress, cache);
+}
+
+}
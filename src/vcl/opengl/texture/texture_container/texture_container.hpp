@@ -0,0 +1,108 @@
+#pragma once
+
+#include "vcl/wrapper/glad/glad.hpp"
+#include "vcl/base/file_mapping/file_mapping.hpp"
+#include "../image/image.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vcl
+{
+
+/** Storage of the texels of a texture
+ *  - rgba8: 4 bytes per texel
+ *  - bc1: blocks of 4x4 texels in 8 bytes, opaque RGB (DXT1, 8 times smaller than rgba8)
+ *  - bc3: blocks of 4x4 texels in 16 bytes, RGB and interpolated alpha (DXT5, 4 times smaller than rgba8) */
+enum class texture_format : uint32_t {rgba8, bc1, bc3};
+
+/** Texture with its whole mip chain in memory.
+ *  levels[0] is the full resolution image, the size of the level k is max(1, width>>k) x max(1, height>>k) down to 1x1. */
+struct texture_mipmaps
+{
+    texture_mipmaps();
+
+    texture_format format;
+    unsigned int width;
+    unsigned int height;
+    std::vector<std::vector<unsigned char>> levels;
+};
+
+/** Compute the mip chain of an image (average of 2x2 texels, as glGenerateMipmap) and encode each level in the given format.
+ *  RGB images are expanded to RGBA. The alpha channel is dropped by bc1. */
+texture_mipmaps texture_build_mipmaps(const image_raw& im, texture_format format);
+
+/** Block compressed format adapted to the image: bc1 if it is fully opaque, bc3 otherwise */
+texture_format texture_compressed_format(const image_raw& im);
+
+/** Whether the current OpenGL context can sample bc1/bc3 textures (EXT_texture_compression_s3tc) */
+bool texture_compression_supported();
+
+
+/** Maximal number of levels of a texture container (16: images up to 65536 texels wide) */
+static const size_t texture_file_max_levels = 16;
+
+/** Header at the beginning of a texture container file.
+ *  The levels follow the header, each one starting on a 16 bytes boundary: they are uploaded in place once the file is mapped. */
+struct texture_file_header
+{
+    char magic[8];                  // "VCLTEX" followed by '\0' '\0'
+    uint32_t version;
+    uint32_t format;                // texture_format
+    uint32_t width;
+    uint32_t height;
+    uint32_t level_count;
+    uint32_t reserved;
+    file_stamp source;              // Stamp of the source image (zero if none)
+    uint64_t offset[texture_file_max_levels]; // Byte offset of each level from the beginning of the file
+    uint64_t size[texture_file_max_levels];   // Size in bytes of each level
+    uint64_t payload_size;          // Bytes after the header
+    uint64_t reserved_end;
+};
+
+/** Write a texture container. The file is written under a temporary name then renamed. Return false if it cannot be written. */
+bool texture_save_file(const std::string& filename, const texture_mipmaps& mipmaps, const file_stamp& source = file_stamp{0,0});
+
+/** Texture container mapped in memory.
+ *  The level pointers refer directly to the mapped file, they are valid until close(). */
+struct texture_file
+{
+    texture_file();
+    texture_file(texture_file&& other);
+    texture_file& operator=(texture_file&& other);
+
+    /** Map the file. Return false (and leave the object closed) if the file is missing, truncated or from another version. */
+    bool open(const std::string& filename);
+    void close();
+    bool is_open() const;
+
+    texture_format format() const;
+    unsigned int level_count() const;
+    unsigned int width(unsigned int level=0) const;
+    unsigned int height(unsigned int level=0) const;
+    const unsigned char* level(unsigned int k) const;
+    size_t level_size(unsigned int k) const;
+
+    const texture_file_header* header;
+
+private:
+    file_mapping file;
+};
+
+/** Create a texture from all its stored levels (glGenerateMipmap is not called).
+ *  Compressed formats require texture_compression_supported(). */
+GLuint create_texture_gpu(const texture_mipmaps& mipmaps, GLint wrap_s=GL_CLAMP_TO_EDGE, GLint wrap_t=GL_CLAMP_TO_EDGE);
+GLuint create_texture_gpu(const texture_file& file, GLint wrap_s=GL_CLAMP_TO_EDGE, GLint wrap_t=GL_CLAMP_TO_EDGE);
+
+
+/** Name of the container baked from an image file */
+std::string texture_cache_filename(const std::string& filename);
+
+/** Map the container baked from a PNG file (filename.vcltex).
+ *  The PNG file is decoded and the container written first if it is missing, older than the PNG file, or not in the requested kind of format
+ *  (compress: texture_compressed_format of the image, otherwise rgba8).
+ *  Return false if the container cannot be written: the PNG file can then be loaded with image_load_png. */
+bool texture_load_file_png(const std::string& filename, bool compress, texture_file& cache);
+
+}
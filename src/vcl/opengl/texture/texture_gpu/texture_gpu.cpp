@@ -1,5 +1,7 @@
 #include "texture_gpu.hpp"
 
+#include "../../state_cache/state_cache.hpp"
+
 namespace vcl
 {
 
@@ -12,7 +14,7 @@ GLuint create_texture_gpu(std::vector<unsigned char> const& data, GLsizei width,
 {
     GLuint id = 0;
     glGenTextures(1,&id);
-    glBindTexture(GL_TEXTURE_2D,id);
+    gl_state().bind_texture(GL_TEXTURE_2D,id);
 
     // Send texture on GPU
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
@@ -25,7 +27,7 @@ GLuint create_texture_gpu(std::vector<unsigned char> const& data, GLsizei width,
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 
-    glBindTexture(GL_TEXTURE_2D,0);
+    gl_state().bind_texture(GL_TEXTURE_2D,0);
 
     return id;
 }
@@ -55,7 +57,7 @@ GLuint create_texture_gpu(buffer2D<vec3> const& im, GLint wrap_s, GLint wrap_t)
 {
     GLuint id = 0;
     glGenTextures(1,&id);
-    glBindTexture(GL_TEXTURE_2D,id);
+    gl_state().bind_texture(GL_TEXTURE_2D,id);
 
     // Send texture on GPU
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, GLsizei(im.dimension[0]), GLsizei(im.dimension[1]), 0, GL_RGB, GL_FLOAT, &im.data[0][0]);
@@ -68,7 +70,7 @@ GLuint create_texture_gpu(buffer2D<vec3> const& im, GLint wrap_s, GLint wrap_t)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 
-    glBindTexture(GL_TEXTURE_2D,0);
+    gl_state().bind_texture(GL_TEXTURE_2D,0);
 
     return id;
 }
@@ -76,10 +78,10 @@ void update_texture_gpu(GLuint texture_id, buffer2D<vec3> const& im)
 {
     assert_vcl(glIsTexture(texture_id), "Incorrect texture id");
 
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+    gl_state().bind_texture(GL_TEXTURE_2D, texture_id);
     glTexSubImage2D(GL_TEXTURE_2D, 0, 0,0, GLsizei(im.dimension[0]), GLsizei(im.dimension[1]), GL_RGB, GL_FLOAT, &im.data[0][0]);
     glGenerateMipmap(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D,0);
+    gl_state().bind_texture(GL_TEXTURE_2D,0);
 }
 
 
@@ -1,59 +1,235 @@
 #include "uniform.hpp"
 
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
 namespace vcl
 {
 
+// Interned names: index -> name, and name -> index
+static std::vector<std::string>& uniform_names()
+{
+    static std::vector<std::string> names;
+    return names;
+}
+static std::unordered_map<std::string, unsigned int>& uniform_indices()
+{
+    static std::unordered_map<std::string, unsigned int> indices;
+    return indices;
+}
+
+// Cached locations for each program, indexed by uniform_id (-2: not queried yet)
+static GLint const location_unknown = -2;
+static std::unordered_map<GLuint, std::vector<GLint>>& uniform_locations()
+{
+    static std::unordered_map<GLuint, std::vector<GLint>> locations;
+    return locations;
+}
+
+uniform_id uniform_id_of(const std::string& name)
+{
+    std::unordered_map<std::string, unsigned int>& indices = uniform_indices();
+    auto it = indices.find(name);
+    if(it!=indices.end())
+        return {it->second};
+
+    const unsigned int index = static_cast<unsigned int>(uniform_names().size());
+    uniform_names().push_back(name);
+    indices[name] = index;
+    return {index};
+}
+
+GLint uniform_location(GLuint shader, uniform_id id)
+{
+    // Consecutive calls are usually made with the same program
+    static GLuint last_shader = 0;
+    static std::vector<GLint>* last_locations = nullptr;
+    if(last_locations==nullptr || shader!=last_shader) {
+        last_locations = &uniform_locations()[shader];
+        last_shader = shader;
+    }
+
+    std::vector<GLint>& locations = *last_locations;
+    if(id.index>=locations.size())
+        locations.resize(uniform_names().size(), location_unknown);
+
+    GLint& location = locations[id.index];
+    if(location==location_unknown)
+        location = glGetUniformLocation(shader, uniform_names()[id.index].c_str());
+    return location;
+}
+
+void uniform_location_cache(GLuint shader)
+{
+    std::vector<GLint>& locations = uniform_locations()[shader];
+    locations.clear();
+
+    GLint count = 0;
+    GLint max_length = 0;
+    glGetProgramiv(shader, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(shader, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+    std::vector<GLchar> buffer(size_t(max_length)+1);
+    for(GLint k=0; k<count; ++k)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(shader, GLuint(k), GLsizei(buffer.size()), &length, &size, &type, &buffer[0]);
+        std::string name(&buffer[0], size_t(length));
+
+        // Arrays are reported as name[0]
+        const size_t bracket = name.find('[');
+        if(bracket!=std::string::npos)
+            name = name.substr(0,bracket);
+
+        const uniform_id id = uniform_id_of(name);
+        if(id.index>=locations.size())
+            locations.resize(uniform_names().size(), location_unknown);
+        locations[id.index] = glGetUniformLocation(shader, name.c_str()); // -1 for members of uniform blocks
+    }
+
+    // All the other names currently known are not active in this program
+    locations.resize(uniform_names().size(), location_unknown);
+    for(GLint& location : locations)
+        if(location==location_unknown)
+            location = -1;
+}
+
+
+void uniform(GLuint shader, uniform_id id, const int value)
+{
+    const GLint location = uniform_location(shader, id);
+    if(location!=-1)
+        glUniform1i(location, value);
+}
+
+void uniform(GLuint shader, uniform_id id, float value)
+{
+    const GLint location = uniform_location(shader, id);
+    if(location!=-1)
+        glUniform1f(location, value);
+}
+
+void uniform(GLuint shader, uniform_id id, const vec2& value)
+{
+    const GLint location = uniform_location(shader, id);
+    if(location!=-1)
+        glUniform2f(location, value.x,value.y);
+}
+
+void uniform(GLuint shader, uniform_id id, const vec3& value)
+{
+    const GLint location = uniform_location(shader, id);
+    if(location!=-1)
+        glUniform3f(location, value.x,value.y, value.z);
+}
+
+void uniform(GLuint shader, uniform_id id, const vec4& value)
+{
+    const GLint location = uniform_location(shader, id);
+    if(location!=-1)
+        glUniform4f(location, value.x,value.y, value.z, value.w);
+}
+
+void uniform(GLuint shader, uniform_id id, const mat4& m)
+{
+    const GLint location = uniform_location(shader, id);
+    if(location!=-1)
+        glUniformMatrix4fv(location, 1, GL_TRUE, &m[0]);
+}
+
+void uniform(GLuint shader, uniform_id id, const mat3& m)
+{
+    const GLint location = uniform_location(shader, id);
+    if(location!=-1)
+        glUniformMatrix3fv(location, 1, GL_TRUE, &m[0]);
+}
+
+
 void uniform(GLuint shader, const std::string& name, const int value)
 {
-    const GLint location = glGetUniformLocation(shader, name.c_str());
-    glUniform1i(location, value);
+    uniform(shader, uniform_id_of(name), value);
 }
 
 void uniform(GLuint shader, const std::string& name, float value)
 {
-    const GLint location = glGetUniformLocation(shader, name.c_str());
-    glUniform1f(location, value);
+    uniform(shader, uniform_id_of(name), value);
 }
 
+void uniform(GLuint shader, const std::string& name, const vec2& value)
+{
+    uniform(shader, uniform_id_of(name), value);
+}
 
 void uniform(GLuint shader, const std::string& name, const vec3& value)
 {
-    const GLint location = glGetUniformLocation(shader, name.c_str());
-    glUniform3f(location, value.x,value.y, value.z);
+    uniform(shader, uniform_id_of(name), value);
 }
 
 void uniform(GLuint shader, const std::string& name, const vec4& value)
 {
-    const GLint location = glGetUniformLocation(shader, name.c_str());
-    glUniform4f(location, value.x,value.y, value.z, value.w);
+    uniform(shader, uniform_id_of(name), value);
 }
 
 void uniform(GLuint shader, const std::string& name, float x, float y, float z)
 {
-    const GLint location = glGetUniformLocation(shader, name.c_str());
-    glUniform3f(location, x, y, z);
+    uniform(shader, uniform_id_of(name), vec3(x,y,z));
 }
 
 void uniform(GLuint shader, const std::string& name, float x, float y, float z, float w)
 {
-    const GLint location = glGetUniformLocation(shader, name.c_str());
-    glUniform4f(location, x, y, z, w);
+    uniform(shader, uniform_id_of(name), vec4(x,y,z,w));
 }
 
 void uniform(GLuint shader, const std::string& name, const mat4& m)
 {
-    const GLint location = glGetUniformLocation(shader, name.c_str());
-    const float* ptr = &m[0];
-    glUniformMatrix4fv(location, 1, GL_TRUE, ptr);
+    uniform(shader, uniform_id_of(name), m);
 }
 
 void uniform(GLuint shader, const std::string& name, const mat3& m)
 {
-    const GLint location = glGetUniformLocation(shader, name.c_str());
-    const float* ptr = &m[0];
-    glUniformMatrix3fv(location, 1, GL_TRUE, ptr);
+    uniform(shader, uniform_id_of(name), m);
+}
+
+
+void camera_uniform_block_bind(GLuint shader)
+{
+    const GLuint block = glGetUniformBlockIndex(shader, "camera_data");
+    if(block!=GL_INVALID_INDEX)
+        glUniformBlockBinding(shader, block, camera_uniform_block_binding);
 }
 
+static size_t camera_uniform_buffer_uploads = 0;
 
+void update_camera_uniform_buffer(const mat4& perspective, const mat4& view, const vec3& camera_position)
+{
+    static GLuint ubo = 0;
+    if(ubo==0) {
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, GLsizeiptr(36*sizeof(float)), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, camera_uniform_block_binding, ubo);
+    }
+
+    // std140 layout with row_major matrices: the row-major storage of mat4 can be copied directly
+    float data[36] = {0};
+    std::copy(&perspective[0], &perspective[0]+16, data);
+    std::copy(&view[0], &view[0]+16, data+16);
+    data[32] = camera_position.x;
+    data[33] = camera_position.y;
+    data[34] = camera_position.z;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, GLsizeiptr(sizeof(data)), data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    ++camera_uniform_buffer_uploads;
+}
+
+size_t camera_uniform_buffer_version()
+{
+    return camera_uniform_buffer_uploads;
+}
 
 }
@@ -9,8 +9,37 @@
 namespace vcl
 {
 
+/** Interned uniform name.
+ *  The same name is always associated to the same id: it can be computed once (ex. static variable) and used to
+ *  retrieve the cached location of the uniform in any shader program without string comparison. */
+struct uniform_id
+{
+    unsigned int index;
+};
+
+/** Return the id associated to a uniform name */
+uniform_id uniform_id_of(const std::string& name);
+
+/** Location of a uniform in a shader program (-1 if the program has no active uniform of this name).
+ *  Locations are queried once per program: at link time in create_shader_program, or at the first call otherwise. */
+GLint uniform_location(GLuint shader, uniform_id id);
+
+/** Store the locations of all the active uniforms of a shader program (discards previous values cached for this program id) */
+void uniform_location_cache(GLuint shader);
+
+
+// Send a uniform value to the shader program (the call is skipped if the uniform is not active)
+void uniform(GLuint shader, uniform_id id, const int value);
+void uniform(GLuint shader, uniform_id id, const float value);
+void uniform(GLuint shader, uniform_id id, const vec2& value);
+void uniform(GLuint shader, uniform_id id, const vec3& value);
+void uniform(GLuint shader, uniform_id id, const vec4& value);
+void uniform(GLuint shader, uniform_id id, const mat4& m);
+void uniform(GLuint shader, uniform_id id, const mat3& m);
+
 void uniform(GLuint shader, const std::string& name, const int value);
 void uniform(GLuint shader, const std::string& name, const float value);
+void uniform(GLuint shader, const std::string& name, const vec2& value);
 void uniform(GLuint shader, const std::string& name, const vec3& value);
 void uniform(GLuint shader, const std::string& name, const vec4& value);
 void uniform(GLuint shader, const std::string& name, float x, float y, float z);
@@ -18,4 +47,19 @@ void uniform(GLuint shader, const std::string& name, float x, float y, float z,
 void uniform(GLuint shader, const std::string& name, const mat4& m);
 void uniform(GLuint shader, const std::string& name, const mat3& m);
 
+
+/** Camera data shared by all the shader programs declaring the uniform block
+ *    layout(std140, row_major) uniform camera_data { mat4 perspective; mat4 view; vec3 camera_position; };
+ *  (included by the shaders from shared_assets/shaders/common/camera_data.glsl).
+ *  The block is bound to camera_uniform_block_binding at link time in create_shader_program. */
+const GLuint camera_uniform_block_binding = 0;
+
+/** Bind the camera_data block of the program (if any) to camera_uniform_block_binding */
+void camera_uniform_block_bind(GLuint shader);
+
+/** Upload the camera data in the uniform buffer read by the camera_data blocks */
+void update_camera_uniform_buffer(const mat4& perspective, const mat4& view, const vec3& camera_position);
+/** Number of uploads done by update_camera_uniform_buffer (0 before the first one): tells a caller whether the buffer still holds its data */
+size_t camera_uniform_buffer_version();
+
 }
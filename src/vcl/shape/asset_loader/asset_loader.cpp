@@ -0,0 +1,249 @@
+#include "asset_loader.hpp"
+
+#include "vcl/wrapper/lodepng/lodepng.hpp"
+#include "vcl/opengl/texture/texture_gpu/texture_gpu.hpp"
+#include "vcl/base/trace/trace.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace vcl
+{
+
+texture_asset::texture_asset()
+    :id(0),filename()
+{}
+
+bool texture_asset::ready() const
+{
+    return id!=0;
+}
+
+texture_array_asset::texture_array_asset()
+    :id(0),filenames()
+{}
+
+bool texture_array_asset::ready() const
+{
+    return id!=0;
+}
+
+mesh_asset::mesh_asset()
+    :drawable(),uploaded(false)
+{}
+
+bool mesh_asset::ready() const
+{
+    return uploaded;
+}
+
+
+// Decoded image or built mesh waiting for its upload
+struct asset_loader::item
+{
+    std::shared_ptr<texture_asset> texture;
+    texture_file container; // Mapped container of the texture, or
+    image_raw image;        // decoded PNG file if the container cannot be written
+    GLint wrap_s;
+    GLint wrap_t;
+
+    std::shared_ptr<texture_array_asset> texture_array;
+    std::vector<texture_file> array_containers; // Mapped containers of the layers, or
+    texture_array_mipmaps array_mipmaps;        // layers built from the PNG files if the containers cannot be written
+
+    std::shared_ptr<mesh_asset> mesh_target;
+    mesh mesh_cpu;
+
+    /** Approximate size of the data sent to the GPU */
+    size_t size() const
+    {
+        if(texture)
+            return container.is_open()? size_t(container.header->payload_size) : image.data.size();
+        if(texture_array) {
+            size_t s = 0;
+            for(const texture_file& layer : array_containers)
+                s += size_t(layer.header->payload_size);
+            for(const std::vector<unsigned char>& level : array_mipmaps.levels)
+                s += level.size();
+            return s;
+        }
+        return mesh_cpu.position.size()*sizeof(vec3) + mesh_cpu.normal.size()*sizeof(vec3) + mesh_cpu.color.size()*sizeof(vec4)
+                + mesh_cpu.texture_uv.size()*sizeof(vec2) + mesh_cpu.connectivity.size()*sizeof(uint3);
+    }
+};
+
+struct asset_loader::shared_state
+{
+    shared_state() :mutex(),finished(),done(),cancelled(false) {}
+
+    void push(item&& it)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.push_back(std::move(it));
+        }
+        finished.notify_all();
+    }
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::deque<item> done;
+    std::atomic<bool> cancelled;   // Set by the destructor of the loader: the remaining tasks are skipped
+};
+
+
+asset_loader::asset_loader()
+    :pool(nullptr),compression_checked(false),compression(false),state(std::make_shared<shared_state>()),requested(0),uploaded(0)
+{}
+
+asset_loader::asset_loader(task_pool& pool_arg)
+    :pool(&pool_arg),compression_checked(false),compression(false),state(std::make_shared<shared_state>()),requested(0),uploaded(0)
+{}
+
+asset_loader::~asset_loader()
+{
+    state->cancelled = true;
+}
+
+task_pool& asset_loader::workers()
+{
+    if(pool==nullptr)
+        pool = &default_task_pool();
+    return *pool;
+}
+
+bool asset_loader::compression_supported()
+{
+    if(!compression_checked) {
+        compression = texture_compression_supported();
+        compression_checked = true;
+    }
+    return compression;
+}
+
+std::shared_ptr<const texture_asset> asset_loader::load_texture(const std::string& filename, GLint wrap_s, GLint wrap_t)
+{
+    std::shared_ptr<texture_asset> texture = std::make_shared<texture_asset>();
+    texture->filename = filename;
+    ++requested;
+
+    const std::shared_ptr<shared_state> s = state;
+    const bool compress = compression_supported();
+    workers().submit([s, texture, filename, compress, wrap_s, wrap_t]{
+        if(s->cancelled)
+            return;
+        item it;
+        it.texture = texture;
+        if(!texture_load_file_png(filename, compress, it.container))
+            it.image = image_load_png(filename);
+        it.wrap_s = wrap_s;
+        it.wrap_t = wrap_t;
+        s->push(std::move(it));
+    });
+    return texture;
+}
+
+std::shared_ptr<const texture_array_asset> asset_loader::load_texture_array(const std::vector<std::string>& filenames, unsigned int width, unsigned int height, GLint wrap_s, GLint wrap_t)
+{
+    std::shared_ptr<texture_array_asset> texture_array = std::make_shared<texture_array_asset>();
+    texture_array->filenames = filenames;
+    ++requested;
+
+    const std::shared_ptr<shared_state> s = state;
+    const bool compress = compression_supported();
+    workers().submit([s, texture_array, width, height, compress, wrap_s, wrap_t]{
+        if(s->cancelled)
+            return;
+        VCL_TRACE_ZONE("asset_loader::build_texture_array");
+        const std::vector<std::string>& filenames = texture_array->filenames;
+        item it;
+        it.texture_array = texture_array;
+        // Mapped containers, or the layers built in memory if the containers cannot be written
+        texture_array_load_files_png(filenames, width, height, compress, it.array_containers, it.array_mipmaps);
+        it.wrap_s = wrap_s;
+        it.wrap_t = wrap_t;
+        s->push(std::move(it));
+    });
+    return texture_array;
+}
+
+std::shared_ptr<mesh_asset> asset_loader::load_mesh(std::function<mesh()> build)
+{
+    std::shared_ptr<mesh_asset> target = std::make_shared<mesh_asset>();
+    ++requested;
+
+    const std::shared_ptr<shared_state> s = state;
+    workers().submit([s, target, build]{
+        if(s->cancelled)
+            return;
+        VCL_TRACE_ZONE("asset_loader::build_mesh");
+        item it;
+        it.mesh_target = target;
+        it.mesh_cpu = build();
+        s->push(std::move(it));
+    });
+    return target;
+}
+
+size_t asset_loader::upload(size_t byte_budget)
+{
+    size_t count = 0;
+    size_t sent = 0;
+    while(count==0 || sent<byte_budget)
+    {
+        item it;
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if(state->done.empty())
+                break;
+            it = std::move(state->done.front());
+            state->done.pop_front();
+        }
+
+        if(it.texture) {
+            VCL_TRACE_ZONE_DETAIL("asset_loader::upload", it.texture->filename);
+            if(it.container.is_open())
+                it.texture->id = create_texture_gpu(it.container, it.wrap_s, it.wrap_t);
+            else
+                it.texture->id = create_texture_gpu(it.image, it.wrap_s, it.wrap_t);
+        }
+        else if(it.texture_array) {
+            VCL_TRACE_ZONE("asset_loader::upload");
+            if(!it.array_containers.empty())
+                it.texture_array->id = create_texture_array_gpu(it.array_containers, it.wrap_s, it.wrap_t);
+            else
+                it.texture_array->id = create_texture_array_gpu(it.array_mipmaps, it.wrap_s, it.wrap_t);
+        }
+        else {
+            VCL_TRACE_ZONE("asset_loader::upload");
+            it.mesh_target->drawable.data = mesh_drawable_gpu_data(it.mesh_cpu);
+            it.mesh_target->uploaded = true;
+        }
+
+        sent += it.size();
+        ++count;
+        ++uploaded;
+    }
+    return count;
+}
+
+void asset_loader::finish()
+{
+    while(pending()>0)
+    {
+        {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            state->finished.wait(lock, [this]{ return !state->done.empty(); });
+        }
+        upload(size_t(-1));
+    }
+}
+
+size_t asset_loader::pending() const
+{
+    return requested-uploaded;
+}
+
+}
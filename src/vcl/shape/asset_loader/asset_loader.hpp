@@ -0,0 +1,100 @@
+#pragma once
+
+#include "vcl/shape/mesh/mesh_drawable/mesh_drawable.hpp"
+#include "vcl/base/parallel/parallel.hpp"
+#include "vcl/opengl/texture/texture_container/texture_container.hpp"
+#include "vcl/opengl/texture/texture_array/texture_array.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vcl
+{
+
+/** Texture loaded in the background.
+ *  id is 0 until the image is uploaded: it can be submitted to a render_queue meanwhile (its default texture is then used). */
+struct texture_asset
+{
+    texture_asset();
+    bool ready() const;
+
+    GLuint id;
+    std::string filename;
+};
+
+/** Texture array loaded in the background: the layer k is the image filenames[k].
+ *  id is 0 until the array is uploaded. */
+struct texture_array_asset
+{
+    texture_array_asset();
+    bool ready() const;
+
+    GLuint id;
+    std::vector<std::string> filenames;
+};
+
+/** Mesh built in the background.
+ *  The gpu data of drawable is set when the mesh is uploaded. The uniform parameters can be set at any time, they are kept by the upload. */
+struct mesh_asset
+{
+    mesh_asset();
+    bool ready() const;
+
+    mesh_drawable drawable;
+    bool uploaded;
+};
+
+/** Load images and build meshes on the threads of a task_pool, then send them to the GPU from the OpenGL thread.
+ *  - load_texture(...) / load_texture_array(...) / load_mesh(...) submit the work and return a handle immediately
+ *  - upload(byte_budget), called once per frame on the OpenGL thread, uploads the finished items in order of completion
+ *    until byte_budget bytes have been sent (at least one item per call): a large set of assets doesn't stall a frame
+ *  - the handles are ready() once uploaded
+ *  Textures and the layers of texture arrays are read from their baked containers (filename.vcltex, filename.WxH.vcltex: all the mip levels, block compressed if the context supports it),
+ *  written at the first load. The PNG file is decoded directly if the container cannot be written.
+ *  finish() waits for every requested asset and uploads it (ex. to render reproducible frames).
+ *  Items still in the workers when the loader is destroyed are dropped (the workers only share the queue of finished items). */
+class asset_loader
+{
+public:
+    /** Loader using the default task pool (created at the first request) */
+    asset_loader();
+    explicit asset_loader(task_pool& pool);
+    ~asset_loader();
+
+    asset_loader(const asset_loader&) = delete;
+    asset_loader& operator=(const asset_loader&) = delete;
+
+    /** Load a PNG file in the background (from its container, baked first if needed) */
+    std::shared_ptr<const texture_asset> load_texture(const std::string& filename, GLint wrap_s=GL_CLAMP_TO_EDGE, GLint wrap_t=GL_CLAMP_TO_EDGE);
+    /** Load PNG files in the background as the layers of a texture array, resampled to width x height
+     *  (from their containers filename.WxH.vcltex, baked first if needed) */
+    std::shared_ptr<const texture_array_asset> load_texture_array(const std::vector<std::string>& filenames, unsigned int width, unsigned int height, GLint wrap_s=GL_REPEAT, GLint wrap_t=GL_REPEAT);
+    /** Call build() in the background. build runs on a worker thread: it must not use OpenGL nor data modified meanwhile by the caller. */
+    std::shared_ptr<mesh_asset> load_mesh(std::function<mesh()> build);
+
+    /** Upload the finished items within the budget (OpenGL thread only). Return the number of uploaded items. */
+    size_t upload(size_t byte_budget = size_t(8)<<20);
+    /** Wait for all the requested items and upload them */
+    void finish();
+
+    /** Number of requested items not uploaded yet */
+    size_t pending() const;
+
+private:
+    struct item;
+    struct shared_state;
+
+    task_pool& workers();
+    bool compression_supported(); // Checked at the first texture request (OpenGL thread)
+
+    task_pool* pool;
+    bool compression_checked;
+    bool compression;      // bc1/bc3 supported by the context
+    std::shared_ptr<shared_state> state; // Shared with the tasks, which can outlive the loader
+    size_t requested;
+    size_t uploaded;
+};
+
+}
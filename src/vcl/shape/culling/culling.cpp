@@ -0,0 +1,160 @@
+#include "culling.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VCL_CULLING_SSE
+#include <emmintrin.h>
+#endif
+
+namespace vcl
+{
+
+bounding_volume::bounding_volume()
+    :center(0,0,0),half_extent(0,0,0),radius(0.0f)
+{}
+
+bounding_volume::bounding_volume(const vec3& center_arg, const vec3& half_extent_arg)
+    :center(center_arg),half_extent(half_extent_arg),radius(norm(half_extent_arg))
+{}
+
+bounding_volume compute_bounding_volume(const buffer<vec3>& position)
+{
+    const size_t N = position.size();
+    if(N==0)
+        return bounding_volume();
+
+    vec3 p_min = position[0];
+    vec3 p_max = position[0];
+    for(size_t k=1; k<N; ++k)
+    {
+        const vec3& p = position[k];
+        p_min = {std::min(p_min.x,p.x), std::min(p_min.y,p.y), std::min(p_min.z,p.z)};
+        p_max = {std::max(p_max.x,p.x), std::max(p_max.y,p.y), std::max(p_max.z,p.z)};
+    }
+    return bounding_volume( (p_min+p_max)/2.0f, (p_max-p_min)/2.0f );
+}
+
+bounding_volume transform(const bounding_volume& volume, const affine_transform& T)
+{
+    const vec3 s = T.scaling*T.scaling_axis;
+    const vec3& c = volume.center;
+    const vec3& h = volume.half_extent;
+    const mat3& R = T.rotation;
+
+    bounding_volume result;
+    result.center = R*vec3{s.x*c.x, s.y*c.y, s.z*c.z} + T.translation;
+
+    // Extent of the rotated box along each axis
+    const vec3 hs = {std::abs(s.x)*h.x, std::abs(s.y)*h.y, std::abs(s.z)*h.z};
+    for(size_t i=0; i<3; ++i)
+        result.half_extent[i] = std::abs(R(i,0))*hs.x + std::abs(R(i,1))*hs.y + std::abs(R(i,2))*hs.z;
+
+    const float s_max = std::max(std::abs(s.x), std::max(std::abs(s.y), std::abs(s.z)));
+    result.radius = std::min(s_max*volume.radius, norm(result.half_extent));
+    return result;
+}
+
+
+frustum frustum_from_matrix(const mat4& M)
+{
+    // Planes as combination of the rows of M (clip = M*p, -w <= x,y,z <= w)
+    frustum f;
+    for(size_t i=0; i<3; ++i)
+    {
+        f.plane[2*i]   = { M(3,0)+M(i,0), M(3,1)+M(i,1), M(3,2)+M(i,2), M(3,3)+M(i,3) };
+        f.plane[2*i+1] = { M(3,0)-M(i,0), M(3,1)-M(i,1), M(3,2)-M(i,2), M(3,3)-M(i,3) };
+    }
+
+    // Normalize the planes to compare the signed distance with a radius
+    for(vec4& p : f.plane)
+    {
+        const float n = std::sqrt(p.x*p.x+p.y*p.y+p.z*p.z);
+        if(n>0)
+            p = p/n;
+    }
+    return f;
+}
+
+frustum camera_frustum(const camera_scene& camera)
+{
+    return frustum_from_matrix(camera.perspective.matrix() * camera.view_matrix());
+}
+
+bool is_visible(const frustum& f, const bounding_volume& volume)
+{
+    const vec3& c = volume.center;
+    const vec3& h = volume.half_extent;
+    for(const vec4& p : f.plane)
+    {
+        const float distance = p.x*c.x + p.y*c.y + p.z*c.z + p.w;
+        if(distance < -volume.radius)
+            return false;
+        // Projected radius of the box on the plane normal
+        const float r = std::abs(p.x)*h.x + std::abs(p.y)*h.y + std::abs(p.z)*h.z;
+        if(distance < -r)
+            return false;
+    }
+    return true;
+}
+
+void frustum_cull(const frustum& f, const vec4* sphere, size_t N, unsigned char* visible)
+{
+    size_t k0 = 0;
+
+#ifdef VCL_CULLING_SSE
+    __m128 px[6], py[6], pz[6], pw[6];
+    for(size_t i=0; i<6; ++i) {
+        px[i] = _mm_set1_ps(f.plane[i].x);
+        py[i] = _mm_set1_ps(f.plane[i].y);
+        pz[i] = _mm_set1_ps(f.plane[i].z);
+        pw[i] = _mm_set1_ps(f.plane[i].w);
+    }
+
+    for(; k0+4<=N; k0+=4)
+    {
+        // Transpose 4 spheres (x,y,z,r) into x,y,z,r registers
+        __m128 x = _mm_loadu_ps(&sphere[k0].x);
+        __m128 y = _mm_loadu_ps(&sphere[k0+1].x);
+        __m128 z = _mm_loadu_ps(&sphere[k0+2].x);
+        __m128 r = _mm_loadu_ps(&sphere[k0+3].x);
+        _MM_TRANSPOSE4_PS(x, y, z, r);
+        const __m128 minus_r = _mm_sub_ps(_mm_setzero_ps(), r);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for(size_t i=0; i<6; ++i)
+        {
+            const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px[i],x), _mm_mul_ps(py[i],y)), _mm_add_ps(_mm_mul_ps(pz[i],z), pw[i]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, minus_r));
+        }
+
+        const int mask = _mm_movemask_ps(inside);
+        for(size_t j=0; j<4; ++j)
+            visible[k0+j] = static_cast<unsigned char>((mask>>j)&1);
+    }
+#endif
+
+    for(size_t k=k0; k<N; ++k)
+    {
+        const vec4& s = sphere[k];
+        unsigned char inside = 1;
+        for(const vec4& p : f.plane)
+            if(p.x*s.x + p.y*s.y + p.z*s.z + p.w < -s.w)
+                inside = 0;
+        visible[k] = inside;
+    }
+}
+
+
+culling_counters::culling_counters()
+    :submitted(0),culled(0)
+{}
+
+void culling_counters::clear()
+{
+    submitted = 0;
+    culled = 0;
+}
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "vcl/math/math.hpp"
+#include "vcl/containers/containers.hpp"
+#include "vcl/interaction/camera/camera.hpp"
+
+#include <array>
+
+namespace vcl
+{
+
+/** Bounding volume of a shape: axis aligned box (center, half extent) and sphere (center, radius).
+ *  The sphere gives a fast conservative test, the box a tighter one. */
+struct bounding_volume
+{
+    bounding_volume();
+    bounding_volume(const vec3& center, const vec3& half_extent);
+
+    vec3 center;
+    vec3 half_extent;
+    float radius;     // radius of the sphere enclosing the box (same center)
+};
+
+/** Bounding volume enclosing all the positions (empty positions give a zero volume at the origin) */
+bounding_volume compute_bounding_volume(const buffer<vec3>& position);
+/** Bounding volume of the transformed shape p -> rotation*(scaling*scaling_axis*p)+translation (same convention as the shaders) */
+bounding_volume transform(const bounding_volume& volume, const affine_transform& T);
+
+
+/** Six planes (left, right, bottom, top, near, far) of a view frustum.
+ *  Each plane is stored as (nx,ny,nz,d): a point p is inside when nx*p.x+ny*p.y+nz*p.z+d >= 0 */
+struct frustum
+{
+    std::array<vec4,6> plane;
+};
+
+/** Extract the frustum planes from a projection*view matrix */
+frustum frustum_from_matrix(const mat4& projection_view);
+/** Frustum of the camera: camera.perspective.matrix() * camera.view_matrix() */
+frustum camera_frustum(const camera_scene& camera);
+
+/** Return false if the volume is entirely outside of the frustum (sphere test, then box test) */
+bool is_visible(const frustum& f, const bounding_volume& volume);
+
+/** Test N spheres (x,y,z,radius) at once against the frustum: visible[k] is set to 1 if the sphere k is at least partly inside, 0 otherwise.
+ *  Spheres are tested by packets of 4 with SSE when available. */
+void frustum_cull(const frustum& f, const vec4* sphere, size_t N, unsigned char* visible);
+
+/** Number of objects given to a culling test and number of the ones rejected */
+struct culling_counters
+{
+    culling_counters();
+    void clear();
+
+    unsigned long submitted;
+    unsigned long culled;
+};
+
+}
@@ -4,3 +4,4 @@
 #include "curve_dynamic_drawable/curve_dynamic_drawable.hpp"
 #include "curve_gpu/curve_gpu.hpp"
 #include "curve_primitive/curve_primitive.hpp"
+#include "keyframe_curve/keyframe_curve.hpp"
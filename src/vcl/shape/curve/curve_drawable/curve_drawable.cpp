@@ -1,10 +1,18 @@
 #include "curve_drawable.hpp"
 
 #include "vcl/opengl/opengl.hpp"
+#include "vcl/shape/mesh/mesh_drawable/mesh_drawable.hpp"
 
 namespace vcl
 {
 
+// Interned names of the uniforms sent at each draw
+static const uniform_id id_rotation = uniform_id_of("rotation");
+static const uniform_id id_translation = uniform_id_of("translation");
+static const uniform_id id_color = uniform_id_of("color");
+static const uniform_id id_scaling = uniform_id_of("scaling");
+
+
 curve_drawable::curve_drawable()
     :uniform(),data(),shader(0)
 {}
@@ -25,28 +33,23 @@ void draw(const curve_drawable& drawable, const camera_scene& camera, GLuint sha
 {
 
     // If shader is 0, use the current one
-    GLint current_shader = 0;
-    glGetIntegerv(GL_CURRENT_PROGRAM, &current_shader); opengl_debug();
     if(shader==0) {
-        shader = GLuint(current_shader);
+        shader = gl_state().program();
     }
-    // Check that the shader is a valid one
-    if( glIsProgram(shader)==GL_FALSE ) {
+    // Check that the shader is a valid one (only needed when switching program)
+    if( shader!=gl_state().program() && glIsProgram(shader)==GL_FALSE ) {
         std::cout<<"No valid shader set to display mesh: skip display"<<std::endl;
         return;
     }
-    // Switch shader program only if necessary
-    if(shader!=GLuint(current_shader))
-        glUseProgram(shader); opengl_debug();
+    gl_state().use_program(shader); opengl_debug();
 
 
-    uniform(shader, "rotation", drawable.uniform.transform.rotation);        opengl_debug();
-    uniform(shader, "translation", drawable.uniform.transform.translation);  opengl_debug();
-    uniform(shader, "color", drawable.uniform.color);                        opengl_debug();
-    uniform(shader, "scaling", drawable.uniform.transform.scaling);          opengl_debug();
+    uniform(shader, id_rotation, drawable.uniform.transform.rotation);       opengl_debug();
+    uniform(shader, id_translation, drawable.uniform.transform.translation); opengl_debug();
+    uniform(shader, id_color, drawable.uniform.color);                       opengl_debug();
+    uniform(shader, id_scaling, drawable.uniform.transform.scaling);         opengl_debug();
 
-    uniform(shader,"perspective",camera.perspective.matrix());      opengl_debug();
-    uniform(shader,"view",camera.view_matrix());                    opengl_debug();
+    uniform(shader, camera);                                                 opengl_debug();
 
     vcl::draw(drawable.data);                                                opengl_debug();
 }
@@ -1,5 +1,7 @@
 #include "curve_dynamic_drawable.hpp"
 
+#include "vcl/opengl/state_cache/state_cache.hpp"
+
 namespace vcl
 {
 
@@ -40,7 +42,7 @@ void curve_dynamic_drawable::draw(GLuint shader_arg, const camera_scene& camera)
         data.number_elements = static_cast<unsigned int>(position_stored.size());
 
         glGenVertexArrays(1,&data.vao);
-        glBindVertexArray(data.vao);
+        gl_state().bind_vertex_array(data.vao);
 
         // position at layout 0
         glBindBuffer(GL_ARRAY_BUFFER, data.vbo_position);
@@ -48,7 +50,7 @@ void curve_dynamic_drawable::draw(GLuint shader_arg, const camera_scene& camera)
         glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, nullptr );
 
         glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        gl_state().bind_vertex_array(0);
 
         first_time = false;
     }
@@ -0,0 +1,171 @@
+#include "keyframe_curve.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VCL_KEYFRAME_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace vcl
+{
+
+static float clamp_time(const keyframe_curve& curve, float t)
+{
+    return std::min(std::max(t, curve.t_min()), curve.t_max());
+}
+
+static void evaluate_segment(const keyframe_segment& segment, float t, vec3& p, vec3& dp)
+{
+    const float s = (t-segment.t0)*segment.inv_dt;
+    p = segment.a + s*(segment.b + s*(segment.c + s*segment.d));
+    dp = segment.inv_dt * (segment.b + s*(2.0f*segment.c + s*3.0f*segment.d));
+}
+
+
+keyframe_curve::keyframe_curve()
+    :segments(),cursor(0)
+{}
+
+keyframe_curve::keyframe_curve(const buffer<vec3>& position, const buffer<float>& time, float K)
+    :segments(),cursor(0)
+{
+    const size_t N = position.size();
+    assert_vcl(N>=4, "Keyframe curve needs at least 4 keyframes");
+    assert_vcl(time.size()==N, "Keyframe curve: incoherent number of positions and times");
+
+    segments.resize(N-3);
+    for(size_t k=1; k+2<N; ++k)
+    {
+        const float t0 = time[k-1], t1 = time[k], t2 = time[k+1], t3 = time[k+2];
+        assert_vcl(t0<t1 && t1<t2 && t2<t3, "Keyframe curve: times must be increasing");
+        const vec3& p0 = position[k-1];
+        const vec3& p1 = position[k];
+        const vec3& p2 = position[k+1];
+        const vec3& p3 = position[k+2];
+
+        const vec3 d1 = 2*K/(t2-t0) * (p2-p0);
+        const vec3 d2 = 2*K/(t3-t1) * (p3-p1);
+
+        // Hermite basis expanded in the monomial basis
+        keyframe_segment& segment = segments[k-1];
+        segment.a = p1;
+        segment.b = d1;
+        segment.c = -3.0f*p1 - 2.0f*d1 + 3.0f*p2 - d2;
+        segment.d = 2.0f*p1 + d1 - 2.0f*p2 + d2;
+        segment.t0 = t1;
+        segment.inv_dt = 1.0f/(t2-t1);
+    }
+}
+
+float keyframe_curve::t_min() const
+{
+    assert_vcl(segments.size()>0, "Empty keyframe curve (default constructed)");
+    return segments[0].t0;
+}
+
+float keyframe_curve::t_max() const
+{
+    assert_vcl(segments.size()>0, "Empty keyframe curve (default constructed)");
+    const keyframe_segment& last = segments[segments.size()-1];
+    return last.t0 + 1.0f/last.inv_dt;
+}
+
+size_t keyframe_curve::find_segment(float t) const
+{
+    // First segment starting after t, the previous one contains t
+    const auto it = std::upper_bound(segments.begin(), segments.end(), t, [](float value, const keyframe_segment& s){ return value < s.t0; });
+    const size_t k = size_t(it-segments.begin());
+    return (k==0)? 0 : k-1;
+}
+
+size_t keyframe_curve::segment(float t)
+{
+    const size_t N = segments.size();
+    assert_vcl(N>0, "Empty keyframe curve (default constructed)");
+    if(cursor>=N)
+        cursor = 0;
+
+    // Same segment or one of its neighbors
+    const bool after_start = t>=segments[cursor].t0;
+    const bool before_end = cursor+1==N || t<segments[cursor+1].t0;
+    if(after_start && before_end)
+        return cursor;
+    if(after_start && (cursor+2==N || t<segments[cursor+2].t0))
+        return ++cursor;
+    if(!after_start && cursor>0 && t>=segments[cursor-1].t0)
+        return --cursor;
+
+    cursor = find_segment(t);
+    return cursor;
+}
+
+void keyframe_curve::evaluate(float t, vec3& p, vec3& dp)
+{
+    t = clamp_time(*this, t);
+    evaluate_segment(segments[segment(t)], t, p, dp);
+}
+
+void keyframe_curve::evaluate(float t, vec3& p, vec3& dp) const
+{
+    t = clamp_time(*this, t);
+    evaluate_segment(segments[find_segment(t)], t, p, dp);
+}
+
+vec3 keyframe_curve::position(float t)
+{
+    vec3 p, dp;
+    evaluate(t, p, dp);
+    return p;
+}
+
+
+void evaluate(buffer<keyframe_curve>& curves, float t, buffer<vec3>& p, buffer<vec3>& dp)
+{
+    const size_t N = curves.size();
+    p.resize(N);
+    dp.resize(N);
+
+    size_t k = 0;
+#ifdef VCL_KEYFRAME_SSE
+    for(; k+4<=N; k+=4)
+    {
+        // Gather the coefficients of the current segment of 4 curves
+        const keyframe_segment* s[4];
+        float tc[4];
+        for(size_t i=0; i<4; ++i) {
+            keyframe_curve& curve = curves[k+i];
+            tc[i] = clamp_time(curve, t);
+            s[i] = &curve.segments[curve.segment(tc[i])];
+        }
+        const __m128 inv_dt = _mm_setr_ps(s[0]->inv_dt, s[1]->inv_dt, s[2]->inv_dt, s[3]->inv_dt);
+        const __m128 u = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(tc), _mm_setr_ps(s[0]->t0, s[1]->t0, s[2]->t0, s[3]->t0)), inv_dt);
+        const __m128 two = _mm_set1_ps(2.0f);
+        const __m128 three = _mm_set1_ps(3.0f);
+
+        for(size_t c=0; c<3; ++c)
+        {
+            const __m128 a = _mm_setr_ps(s[0]->a[c], s[1]->a[c], s[2]->a[c], s[3]->a[c]);
+            const __m128 b = _mm_setr_ps(s[0]->b[c], s[1]->b[c], s[2]->b[c], s[3]->b[c]);
+            const __m128 q = _mm_setr_ps(s[0]->c[c], s[1]->c[c], s[2]->c[c], s[3]->c[c]);
+            const __m128 d = _mm_setr_ps(s[0]->d[c], s[1]->d[c], s[2]->d[c], s[3]->d[c]);
+
+            // Horner evaluation of the position and of the derivative
+            const __m128 value = _mm_add_ps(a, _mm_mul_ps(u, _mm_add_ps(b, _mm_mul_ps(u, _mm_add_ps(q, _mm_mul_ps(u, d))))));
+            const __m128 derivative = _mm_mul_ps(inv_dt, _mm_add_ps(b, _mm_mul_ps(u, _mm_add_ps(_mm_mul_ps(two, q), _mm_mul_ps(u, _mm_mul_ps(three, d))))));
+
+            float v[4], dv[4];
+            _mm_storeu_ps(v, value);
+            _mm_storeu_ps(dv, derivative);
+            for(size_t i=0; i<4; ++i) {
+                p[k+i][c] = v[i];
+                dp[k+i][c] = dv[i];
+            }
+        }
+    }
+#endif
+    for(; k<N; ++k)
+        curves[k].evaluate(t, p[k], dp[k]);
+}
+
+}
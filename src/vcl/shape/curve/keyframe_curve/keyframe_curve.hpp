@@ -0,0 +1,50 @@
+#pragma once
+
+#include "vcl/math/math.hpp"
+#include "vcl/containers/containers.hpp"
+
+namespace vcl
+{
+
+/** Cubic coefficients of one segment of a keyframe curve: p(s) = a + b s + c s^2 + d s^3 with s = (t-t0)*inv_dt in [0,1] */
+struct keyframe_segment
+{
+    vec3 a, b, c, d;
+    float t0;
+    float inv_dt;
+};
+
+/** Cardinal spline interpolating keyframes (p_k, t_k), with the polynomial of each segment computed once.
+ *  The tangent at keyframe k is d_k = 2K/(t_{k+1}-t_{k-1}) (p_{k+1}-p_{k-1}), used as Hermite tangent of the normalized segment parameter.
+ *  The curve is defined between the second and the one before last keyframe (t is clamped to this interval).
+ *  The segment containing t is found from the segment of the previous evaluation (cursor): O(1) for a time increasing (or decreasing) smoothly,
+ *  binary search otherwise. */
+struct keyframe_curve
+{
+    keyframe_curve();
+    /** Precompute the segments from the keyframes (at least 4 keyframes with increasing times) */
+    keyframe_curve(const buffer<vec3>& position, const buffer<float>& time, float K=1.0f);
+
+    /** Interval of definition of the curve (error for a default constructed curve, which has no segment) */
+    float t_min() const;
+    float t_max() const;
+
+    /** Index of the segment containing t, by binary search */
+    size_t find_segment(float t) const;
+    /** Index of the segment containing t, starting from the cursor (the cursor is updated) */
+    size_t segment(float t);
+
+    /** Position and derivative (with respect to t) at time t */
+    void evaluate(float t, vec3& p, vec3& dp);
+    void evaluate(float t, vec3& p, vec3& dp) const;
+    vec3 position(float t);
+
+    buffer<keyframe_segment> segments;
+    size_t cursor; // Segment of the last evaluation
+};
+
+/** Evaluate all the curves at the same time t: p[k] and dp[k] are the position and derivative of curves[k].
+ *  p and dp are resized if needed. The polynomials are evaluated for 4 curves at once (SSE) when available. */
+void evaluate(buffer<keyframe_curve>& curves, float t, buffer<vec3>& p, buffer<vec3>& dp);
+
+}
@@ -0,0 +1,257 @@
+#include "clipmap_drawable.hpp"
+
+#include "vcl/opengl/opengl.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+namespace vcl
+{
+
+// Triangles of the cells of the quadrant q (bit 0: upper half along x, bit 1: upper half along y) of a level,
+// skipping the cells of the hole [hole_i,hole_i+hole_size[ x [hole_j,hole_j+hole_size[
+static void push_grid_triangles(std::vector<GLuint>& index, unsigned int grid_size, int hole_i, int hole_j, int hole_size, unsigned int q)
+{
+    const unsigned int Ns = grid_size+1;
+    const unsigned int half = grid_size/2;
+    const unsigned int ku_begin = (q&1)? half : 0;
+    const unsigned int kv_begin = (q&2)? half : 0;
+    for(unsigned int ku=ku_begin; ku<ku_begin+half; ++ku) {
+        for(unsigned int kv=kv_begin; kv<kv_begin+half; ++kv) {
+            const bool in_hole = int(ku)>=hole_i && int(ku)<hole_i+hole_size && int(kv)>=hole_j && int(kv)<hole_j+hole_size;
+            if(in_hole)
+                continue;
+
+            const GLuint idx = kv + Ns*ku;
+            const GLuint triangle_1[3] = {idx, idx+1+Ns, idx+1};
+            const GLuint triangle_2[3] = {idx, idx+Ns, idx+1+Ns};
+            index.insert(index.end(), triangle_1, triangle_1+3);
+            index.insert(index.end(), triangle_2, triangle_2+3);
+        }
+    }
+}
+
+// Triangles of a whole grid (hole_size=0 for the full grid), quadrant after quadrant. The start of each quadrant is stored in offset.
+static void push_grid_quadrants(std::vector<GLuint>& index, std::vector<size_t>& offset, unsigned int grid_size, int hole_i, int hole_j, int hole_size)
+{
+    for(unsigned int q=0; q<4; ++q) {
+        offset.push_back(index.size());
+        push_grid_triangles(index, grid_size, hole_i, hole_j, hole_size, q);
+    }
+    offset.push_back(index.size());
+}
+
+
+clipmap_drawable::clipmap_drawable()
+    :level(),vbo_color(0),vbo_index(0),index_offset(),grid_size(0),texture_scale(1.0f),uniform(),heightfield(),shader(0),texture_id(0),frustum_culling(true)
+{}
+
+clipmap_drawable::clipmap_drawable(unsigned int number_levels, unsigned int grid_size_arg, float spacing, float texture_scale_arg, GLuint shader_arg, GLuint texture_id_arg)
+    :level(),vbo_color(0),vbo_index(0),index_offset(),grid_size(grid_size_arg),texture_scale(texture_scale_arg),uniform(),heightfield(),shader(shader_arg),texture_id(texture_id_arg),frustum_culling(true)
+{
+    assert_vcl(grid_size>=4 && grid_size%4==0, "Clipmap grid size must be a multiple of 4");
+    assert_vcl(number_levels>0, "Clipmap needs at least one level");
+
+    const unsigned int Ns = grid_size+1;
+    const size_t N_vertex = size_t(Ns)*Ns;
+
+    // Shared data: color and indices (full grid, then the hole of the finer level shifted by -1, 0, +1 cell along x and y)
+    buffer<vec4> color(N_vertex);
+    color.fill(vec4(1,1,1,1));
+    glGenBuffers(1, &vbo_color);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_color);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(N_vertex*sizeof(GLfloat)*4), &color[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    std::vector<GLuint> index;
+    index.reserve((size_t(grid_size)*grid_size + 9*(size_t(grid_size)*grid_size - size_t(grid_size/2)*(grid_size/2)))*6);
+    push_grid_quadrants(index, index_offset, grid_size, 0, 0, 0);
+    const int hole_size = int(grid_size/2);
+    for(int dj=-1; dj<=1; ++dj)
+        for(int di=-1; di<=1; ++di)
+            push_grid_quadrants(index, index_offset, grid_size, int(grid_size/4)+di, int(grid_size/4)+dj, hole_size);
+
+    level.resize(number_levels);
+    for(unsigned int l=0; l<number_levels; ++l)
+    {
+        level_data& data = level[l];
+        data.spacing = spacing*float(1u<<l);
+
+        buffer<vec3> position(N_vertex);
+        buffer<vec2> texture_uv(N_vertex);
+        for(unsigned int ku=0; ku<Ns; ++ku) {
+            for(unsigned int kv=0; kv<Ns; ++kv) {
+                const float x = (float(ku)-float(grid_size/2))*data.spacing;
+                const float y = (float(kv)-float(grid_size/2))*data.spacing;
+                position[kv+Ns*ku] = {x, y, 0.0f};
+                texture_uv[kv+Ns*ku] = {texture_scale*x, texture_scale*y};
+            }
+        }
+
+        glGenVertexArrays(1, &data.vao);
+        gl_state().bind_vertex_array(data.vao);
+
+        glGenBuffers(1, &data.vbo_position);
+        glBindBuffer(GL_ARRAY_BUFFER, data.vbo_position);
+        glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(N_vertex*sizeof(GLfloat)*3), &position[0], GL_STATIC_DRAW);
+        glEnableVertexAttribArray( 0 );
+        glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, nullptr );
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo_color);
+        glEnableVertexAttribArray( 2 );
+        glVertexAttribPointer( 2, 4, GL_FLOAT, GL_FALSE, 0, nullptr );
+
+        glGenBuffers(1, &data.vbo_texture_uv);
+        glBindBuffer(GL_ARRAY_BUFFER, data.vbo_texture_uv);
+        glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(N_vertex*sizeof(GLfloat)*2), &texture_uv[0], GL_STATIC_DRAW);
+        glEnableVertexAttribArray( 3 );
+        glVertexAttribPointer( 3, 2, GL_FLOAT, GL_FALSE, 0, nullptr );
+
+        // The index buffer is shared by all the levels and stored in each VAO
+        if(l==0) {
+            glGenBuffers(1, &vbo_index);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_index);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(index.size()*sizeof(GLuint)), &index[0], GL_STATIC_DRAW);
+        }
+        else
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_index);
+
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        gl_state().bind_vertex_array(0);
+        opengl_debug();
+    }
+}
+
+void clipmap_drawable::clear()
+{
+    for(level_data& data : level)
+    {
+        if(data.vao!=0 && gl_state().vertex_array()==data.vao)
+            gl_state().bind_vertex_array(0);
+        glDeleteVertexArrays(1, &data.vao);
+        glDeleteBuffers(1, &data.vbo_position);
+        glDeleteBuffers(1, &data.vbo_texture_uv);
+    }
+    glDeleteBuffers(1, &vbo_color);
+    glDeleteBuffers(1, &vbo_index);
+
+    level.clear();
+    index_offset.clear();
+    vbo_color = 0;
+    vbo_index = 0;
+}
+
+size_t clipmap_drawable::number_vertices() const
+{
+    return level.size()*size_t(grid_size+1)*(grid_size+1);
+}
+
+unsigned int clipmap_level_count(unsigned int grid_size, float spacing, float extent)
+{
+    // The level l extends to (grid_size/2)*spacing*2^l around its center (minus one coarser step when it is snapped)
+    unsigned int N = 1;
+    while(float(grid_size/2)*spacing*float(1u<<(N-1)) < extent && N<16)
+        ++N;
+    return N;
+}
+
+
+void draw(const clipmap_drawable& drawable, const camera_scene& camera)
+{
+    draw(drawable, camera, drawable.shader);
+}
+
+void draw(const clipmap_drawable& drawable, const camera_scene& camera, GLuint shader)
+{
+    if(shader==0 || drawable.level.size()==0)
+        return ;
+
+    if( shader!=gl_state().program() && glIsProgram(shader)==GL_FALSE ) {
+        std::cout<<"No valid shader set to display clipmap: skip display"<<std::endl;
+        return;
+    }
+    gl_state().use_program(shader); opengl_debug();
+
+    if(drawable.texture_id!=0) {
+        assert(glIsTexture(drawable.texture_id));
+        gl_state().bind_texture(GL_TEXTURE_2D, drawable.texture_id);  opengl_debug();
+    }
+    uniform(shader, camera); opengl_debug();
+
+    // Camera position in the coordinates of the surface (before its transformation)
+    const affine_transform& T = drawable.uniform.transform;
+    const vec3 s = T.scaling*T.scaling_axis;
+    const vec3 q = transpose(T.rotation)*(camera.camera_position()-T.translation);
+    const vec2 p = {q.x/s.x, q.y/s.y};
+
+    const frustum f = camera_frustum(camera);
+
+    const size_t N_level = drawable.level.size();
+    vec2 center_finer;
+    for(size_t l=0; l<N_level; ++l)
+    {
+        const clipmap_drawable::level_data& data = drawable.level[l];
+        const float spacing = data.spacing;
+
+        // Snapped on twice the step: the vertices of the level lie on the vertices of the coarser one
+        const vec2 center = { 2*spacing*std::round(p.x/(2*spacing)), 2*spacing*std::round(p.y/(2*spacing)) };
+
+        // Finest level: full grid. Others: grid with a hole at the position of the finer level
+        size_t grid = 0;
+        if(l>0) {
+            const int di = std::max(-1, std::min(1, int(std::round((center_finer.x-center.x)/spacing))));
+            const int dj = std::max(-1, std::min(1, int(std::round((center_finer.y-center.y)/spacing))));
+            grid = 1 + size_t((dj+1)*3+(di+1));
+        }
+        center_finer = center;
+
+        // Visible quadrants: the contiguous ones are drawn with a single call
+        const float half_size = float(drawable.grid_size/2)*spacing;
+        size_t draw_begin[4], draw_end[4];
+        size_t draw_count = 0;
+        for(unsigned int q=0; q<4; ++q)
+        {
+            const size_t begin = drawable.index_offset[5*grid+q];
+            const size_t end = drawable.index_offset[5*grid+q+1];
+            if(begin==end)
+                continue;
+            if(drawable.frustum_culling) {
+                const vec3 quadrant_center = {center.x + ((q&1)? 0.5f : -0.5f)*half_size, center.y + ((q&2)? 0.5f : -0.5f)*half_size, 0.0f};
+                const bounding_volume flat(quadrant_center, {0.5f*half_size, 0.5f*half_size, 0.0f});
+                if(!is_visible(f, transform(displaced_bounding_volume(flat, drawable.heightfield), T)))
+                    continue;
+            }
+            if(draw_count>0 && draw_end[draw_count-1]==begin)
+                draw_end[draw_count-1] = end;
+            else {
+                draw_begin[draw_count] = begin;
+                draw_end[draw_count] = end;
+                ++draw_count;
+            }
+        }
+        if(draw_count==0)
+            continue;
+
+        mesh_drawable_uniform level_uniform = drawable.uniform;
+        level_uniform.transform.translation = T.translation + T.rotation*vec3{s.x*center.x, s.y*center.y, 0.0f};
+
+        heightfield_uniform level_heightfield = drawable.heightfield;
+        level_heightfield.uv_offset = drawable.heightfield.uv_offset + drawable.heightfield.uv_scale*center;
+        level_heightfield.texture_uv_offset = drawable.heightfield.texture_uv_offset + drawable.texture_scale*center;
+        level_heightfield.normal_epsilon = spacing;
+        level_heightfield.seam_spacing = spacing;
+        level_heightfield.seam_half_size = float(drawable.grid_size/2)*spacing;
+
+        uniform(shader, level_uniform);     opengl_debug();
+        uniform(shader, level_heightfield); opengl_debug();
+
+        gl_state().bind_vertex_array(data.vao); opengl_debug();
+        for(size_t k=0; k<draw_count; ++k) {
+            const size_t count = draw_end[k]-draw_begin[k];
+            glDrawElements(GL_TRIANGLES, GLsizei(count), GL_UNSIGNED_INT, reinterpret_cast<void*>(draw_begin[k]*sizeof(GLuint))); opengl_debug();
+            gl_state().count_draw(count/3);
+        }
+    }
+}
+
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "vcl/shape/heightfield/heightfield_drawable/heightfield_drawable.hpp"
+
+#include <vector>
+
+namespace vcl
+{
+
+/** Unbounded heightfield (typically an ocean) drawn as a geometry clipmap centered on the camera.
+ *  - Level l is a grid of grid_size x grid_size cells of step spacing*2^l, the finer levels fill the hole of the coarser ones.
+ *  - Each level is snapped on a multiple of twice its step: the vertices stay at fixed (x,y) positions when the camera moves.
+ *  - The border of each level is matched to the edges of the coarser level in the shader (seam_spacing): no crack between the levels.
+ *  The number of vertices, number_levels*(grid_size+1)^2, doesn't depend on the visible extent (see clipmap_level_count).
+ *  - The triangles of each level are grouped by quadrant around its center: the quadrants outside of the view frustum are not drawn.
+ *  The heights are computed by the heightfield shader from the noise parameters (same convention as heightfield_drawable:
+ *  the (x,y) coordinates given to the noise are the ones of the whole surface, before the transformation in uniform). */
+struct clipmap_drawable
+{
+public:
+
+    clipmap_drawable();
+    /** Create the levels. grid_size is expected to be a multiple of 4, spacing is the step of the finest level.
+     *  The texture coordinates are texture_scale*(x,y) (offset by heightfield.texture_uv_offset). */
+    clipmap_drawable(unsigned int number_levels, unsigned int grid_size, float spacing, float texture_scale=1.0f, GLuint shader = 0, GLuint texture_id = 0);
+
+    /** Clear buffers (VBO, VAO, etc) */
+    void clear();
+
+    /** Total number of vertices of the levels */
+    size_t number_vertices() const;
+
+    struct level_data
+    {
+        GLuint vao;
+        GLuint vbo_position;
+        GLuint vbo_texture_uv;
+        float spacing;
+    };
+    std::vector<level_data> level;
+
+    GLuint vbo_color;           // White color shared by all the levels
+    GLuint vbo_index;           // Full grid (finest level) followed by the 9 possible positions of the hole (coarser levels)
+    std::vector<size_t> index_offset; // First index of the 4 quadrants of each of these 10 grids, and their end (5 values per grid)
+    unsigned int grid_size;
+    float texture_scale;
+
+    mesh_drawable_uniform uniform;
+    heightfield_uniform heightfield;
+    GLuint shader;
+    GLuint texture_id;
+    bool frustum_culling;       // Skip the quadrants outside of the view frustum (default: true)
+};
+
+/** Smallest number of levels whose coarsest one extends at least to the distance extent from the camera
+ *  (ex. the half size of a skybox: the levels beyond would be hidden behind it) */
+unsigned int clipmap_level_count(unsigned int grid_size, float spacing, float extent);
+
+/** Draw all the levels snapped around the camera */
+void draw(const clipmap_drawable& drawable, const camera_scene& camera);
+void draw(const clipmap_drawable& drawable, const camera_scene& camera, GLuint shader);
+
+}
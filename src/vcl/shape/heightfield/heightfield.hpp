@@ -0,0 +1,4 @@
+#pragma once
+
+#include "heightfield_drawable/heightfield_drawable.hpp"
+#include "clipmap_drawable/clipmap_drawable.hpp"
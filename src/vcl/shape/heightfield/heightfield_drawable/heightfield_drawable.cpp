@@ -0,0 +1,139 @@
+#include "heightfield_drawable.hpp"
+
+#include "vcl/opengl/opengl.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Permutation table of the simplex noise (third_party/simplexnoise)
+extern unsigned char perm[512];
+
+namespace vcl
+{
+
+// Interned names of the heightfield uniforms
+static const uniform_id id_perm_sampler = uniform_id_of("perm_sampler");
+static const uniform_id id_height = uniform_id_of("height");
+static const uniform_id id_noise_scaling = uniform_id_of("noise_scaling");
+static const uniform_id id_octave = uniform_id_of("octave");
+static const uniform_id id_persistency = uniform_id_of("persistency");
+static const uniform_id id_frequency_gain = uniform_id_of("frequency_gain");
+static const uniform_id id_uv_scale = uniform_id_of("uv_scale");
+static const uniform_id id_uv_offset = uniform_id_of("uv_offset");
+static const uniform_id id_normal_epsilon = uniform_id_of("normal_epsilon");
+static const uniform_id id_texture_uv_offset = uniform_id_of("texture_uv_offset");
+static const uniform_id id_seam_spacing = uniform_id_of("seam_spacing");
+static const uniform_id id_seam_half_size = uniform_id_of("seam_half_size");
+
+// Texture unit used for the permutation table (unit 0 is used by the color texture)
+static GLenum const heightfield_perm_unit = 1;
+
+// Permutation table of the simplex noise stored as an integer 1D texture (created once)
+static GLuint heightfield_perm_texture()
+{
+    static GLuint id = 0;
+    if(id==0)
+    {
+        glGenTextures(1, &id);
+        gl_state().bind_texture(GL_TEXTURE_1D, id);
+        glTexImage1D(GL_TEXTURE_1D, 0, GL_R8UI, 256, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, perm);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAX_LEVEL, 0);
+        gl_state().bind_texture(GL_TEXTURE_1D, 0);
+        opengl_debug();
+    }
+    return id;
+}
+
+
+heightfield_uniform::heightfield_uniform()
+    :height(1.0f), noise_scaling(1.0f), octave(5), persistency(0.3f), frequency_gain(2.0f),
+      uv_scale(1.0f,1.0f), uv_offset(0.0f,0.0f), normal_epsilon(0.05f),
+      texture_uv_offset(0.0f,0.0f), seam_spacing(0.0f), seam_half_size(0.0f)
+{}
+
+heightfield_drawable::heightfield_drawable()
+    :data(),uniform(),heightfield(),shader(0),texture_id(0)
+{}
+
+heightfield_drawable::heightfield_drawable(const mesh& grid_cpu, GLuint shader_arg, GLuint texture_id_arg)
+    :data(grid_cpu),uniform(),heightfield(),shader(shader_arg),texture_id(texture_id_arg)
+{}
+
+void heightfield_drawable::clear()
+{
+    data.clear();
+}
+
+
+void draw(const heightfield_drawable& drawable, const camera_scene& camera)
+{
+    draw(drawable, camera, drawable.shader);
+}
+
+void draw(const heightfield_drawable& drawable, const camera_scene& camera, GLuint shader)
+{
+    if(shader==0)
+        return ;
+
+    if( shader!=gl_state().program() && glIsProgram(shader)==GL_FALSE ) {
+        std::cout<<"No valid shader set to display heightfield: skip display"<<std::endl;
+        return;
+    }
+    gl_state().use_program(shader); opengl_debug();
+
+    if(drawable.texture_id!=0) {
+        assert(glIsTexture(drawable.texture_id));
+        gl_state().bind_texture(GL_TEXTURE_2D, drawable.texture_id);  opengl_debug();
+    }
+
+    // Same uniform values as mesh_drawable
+    uniform(shader, drawable.uniform);  opengl_debug();
+    uniform(shader, camera);            opengl_debug();
+    uniform(shader, drawable.heightfield);
+
+    vcl::draw(drawable.data); opengl_debug();
+}
+
+void uniform(GLuint shader, const heightfield_uniform& h)
+{
+    // Permutation table on its own texture unit
+    gl_state().bind_texture(GL_TEXTURE_1D, heightfield_perm_texture(), heightfield_perm_unit); opengl_debug();
+    uniform(shader, id_perm_sampler, int(heightfield_perm_unit)); opengl_debug();
+
+    uniform(shader, id_height, h.height);                   opengl_debug();
+    uniform(shader, id_noise_scaling, h.noise_scaling);     opengl_debug();
+    uniform(shader, id_octave, h.octave);                   opengl_debug();
+    uniform(shader, id_persistency, h.persistency);         opengl_debug();
+    uniform(shader, id_frequency_gain, h.frequency_gain);   opengl_debug();
+    uniform(shader, id_uv_scale, h.uv_scale);               opengl_debug();
+    uniform(shader, id_uv_offset, h.uv_offset);             opengl_debug();
+    uniform(shader, id_normal_epsilon, h.normal_epsilon);   opengl_debug();
+    uniform(shader, id_texture_uv_offset, h.texture_uv_offset); opengl_debug();
+    uniform(shader, id_seam_spacing, h.seam_spacing);       opengl_debug();
+    uniform(shader, id_seam_half_size, h.seam_half_size);   opengl_debug();
+}
+
+bounding_volume displaced_bounding_volume(const heightfield_drawable& drawable)
+{
+    return displaced_bounding_volume(drawable.data.bounds, drawable.heightfield);
+}
+
+bounding_volume displaced_bounding_volume(const bounding_volume& b, const heightfield_uniform& h)
+{
+    float amplitude = 0.0f;
+    float a = 1.0f;
+    for(int k=0; k<h.octave; ++k) {
+        amplitude += a;
+        a *= std::abs(h.persistency);
+    }
+
+    const float z0 = std::min(0.0f, h.height*amplitude);
+    const float z1 = std::max(0.0f, h.height*amplitude);
+    const vec3 p_min = b.center - b.half_extent + vec3(0,0,z0);
+    const vec3 p_max = b.center + b.half_extent + vec3(0,0,z1);
+    return bounding_volume( (p_min+p_max)/2.0f, (p_max-p_min)/2.0f );
+}
+
+}
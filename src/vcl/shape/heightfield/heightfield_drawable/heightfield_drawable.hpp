@@ -0,0 +1,63 @@
+#pragma once
+
+#include "vcl/shape/mesh/mesh_drawable/mesh_drawable.hpp"
+
+
+namespace vcl
+{
+
+/** Parameters of the Perlin noise evaluated in the heightfield shader.
+ *  The vertex (x,y,z) of the grid is displaced to (x, y, z + height*perlin(q.x,q.y,octave,persistency,frequency_gain))
+ *  with q = noise_scaling * (uv_scale*(x,y) + uv_offset). */
+struct heightfield_uniform
+{
+    heightfield_uniform();
+
+    float height;
+    float noise_scaling;
+    int octave;
+    float persistency;
+    float frequency_gain;
+    vec2 uv_scale;
+    vec2 uv_offset;
+    float normal_epsilon; // step of the finite differences used to compute the normals
+
+    vec2 texture_uv_offset; // added to the texture coordinates of the vertices
+    float seam_spacing;     // grid step of a clipmap level (0 for a regular heightfield)
+    float seam_half_size;   // half size of the clipmap level (its border is matched to the coarser level)
+};
+
+/** Surface displaced by a Perlin noise on the GPU.
+ *  The grid is sent once to the GPU: animating the surface only requires to change the uniform parameters.
+ *  Expects to be drawn with the heightfield shader (scenes/shared_assets/shaders/heightfield) */
+struct heightfield_drawable
+{
+public:
+
+    heightfield_drawable();
+    /** Initialize VAO and VBO from the (usually flat) grid */
+    heightfield_drawable(const mesh& grid_cpu, GLuint shader = 0, GLuint texture_id = 0);
+
+    /** Clear buffers (VBO, VAO, etc) */
+    void clear();
+
+    mesh_drawable_gpu_data data;
+    mesh_drawable_uniform uniform;
+    heightfield_uniform heightfield;
+    GLuint shader;
+    GLuint texture_id;
+};
+
+void draw(const heightfield_drawable& drawable, const camera_scene& camera);
+void draw(const heightfield_drawable& drawable, const camera_scene& camera, GLuint shader);
+
+/** Send the noise parameters to the shader and bind the permutation table of the noise (texture unit 1) */
+void uniform(GLuint shader, const heightfield_uniform& heightfield);
+
+/** Bounding volume of the grid once displaced by the noise (local coordinates).
+ *  The noise lies in [0, 1+persistency+...+persistency^(octave-1)]: the box of the grid is extended along z accordingly. */
+bounding_volume displaced_bounding_volume(const heightfield_drawable& drawable);
+/** Same extension along z of the volume of any flat part of a grid displaced with these parameters */
+bounding_volume displaced_bounding_volume(const bounding_volume& flat, const heightfield_uniform& heightfield);
+
+}
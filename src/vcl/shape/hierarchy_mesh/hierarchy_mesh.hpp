@@ -1,3 +1,4 @@
 #pragma once
 
 #include "hierarchy_mesh_drawable/hierarchy_mesh_drawable.hpp"
+#include "hierarchy_mesh_palette_drawable/hierarchy_mesh_palette_drawable.hpp"
@@ -1,21 +1,46 @@
 #include "hierarchy_mesh_drawable.hpp"
 
-#include <set>
+#include <algorithm>
 
 namespace vcl {
 
-static void assert_valid_hierarchy(const hierarchy_mesh_drawable& hierarchy);
-
-
 
+void hierarchy_mesh_drawable::add(const hierarchy_mesh_drawable_node& node)
+{
+    const int index_node = static_cast<int>(elements.size());
 
+    // The name of each node must be unique
+    if(name_map.find(node.name)!=name_map.end()) {
+        std::cerr<<"Error: Hierarchy not valid - Element ("<<node.name<<") is already defined"<<std::endl;
+        abort();
+    }
 
+    // The parent is either the root frame (the parent of the first node), or an already defined node
+    int index_parent = -1;
+    if(index_node==0) {
+        if(node.name_parent==node.name) {
+            std::cerr<<"Error: Hierarchy not valid - name of the root node ("<<node.name_parent<<") cannot be an element of the hierarchy"<<std::endl;
+            abort();
+        }
+    }
+    else if(node.name_parent!=elements[0].name_parent) {
+        const auto it = name_map.find(node.name_parent);
+        if(it==name_map.end()) {
+            std::cerr<<"Error: Hierarchy not valid"<<std::endl;
+            std::cerr<<"Element ("<<node.name<<","<<index_node<<") has parent name ("<<node.name_parent<<") used before being defined"<<std::endl;
+            abort();
+        }
+        index_parent = it->second;
+    }
+    else if(node.name==elements[0].name_parent) {
+        std::cerr<<"Error: Hierarchy not valid - name of the root node ("<<node.name<<") cannot be an element of the hierarchy"<<std::endl;
+        abort();
+    }
 
-void hierarchy_mesh_drawable::add(const hierarchy_mesh_drawable_node& node)
-{
-    name_map[node.name] = static_cast<int>(elements.size());
+    name_map[node.name] = index_node;
     elements.push_back(node);
-    assert_valid_hierarchy(*this);
+    parent_index.push_back(index_parent);
+    dirty.push_back(1);
 }
 
 
@@ -49,20 +74,14 @@ void hierarchy_mesh_drawable::set_shader_for_all_elements(GLuint shader)
 
 hierarchy_mesh_drawable_node& hierarchy_mesh_drawable::operator[](const std::string& name)
 {
-    auto it = name_map.find(name);
-    if(it==name_map.end())
-    {
-        std::cerr<<"Error: cannot find element ["<<name<<"] in hierarchy_mesh_drawable"<<std::endl;
-        std::cerr<<"Possibles element names are: ";
-        for( auto const& s : name_map ) { std::cerr<<"["<<s.first<<"] "; }
-        abort();
-    }
-    const size_t index = it->second;
-    assert_vcl_no_msg(index<elements.size());
-
-    return elements[index];
+    return node(index(name));
 }
 const hierarchy_mesh_drawable_node& hierarchy_mesh_drawable::operator[](const std::string& name) const
+{
+    return node(index(name));
+}
+
+int hierarchy_mesh_drawable::index(const std::string& name) const
 {
     auto it = name_map.find(name);
     if(it==name_map.end())
@@ -72,44 +91,53 @@ const hierarchy_mesh_drawable_node& hierarchy_mesh_drawable::operator[](const st
         for( auto const& s : name_map ) { std::cerr<<"["<<s.first<<"] "; }
         abort();
     }
+    return it->second;
+}
 
-    const size_t index = it->second;
-    assert_vcl_no_msg(index<elements.size());
-
+hierarchy_mesh_drawable_node& hierarchy_mesh_drawable::node(int index)
+{
+    assert_vcl_no_msg(index>=0 && size_t(index)<elements.size());
+    dirty[index] = 1;
     return elements[index];
 }
 
+const hierarchy_mesh_drawable_node& hierarchy_mesh_drawable::node(int index) const
+{
+    assert_vcl_no_msg(index>=0 && size_t(index)<elements.size());
+    return elements[index];
+}
 
+void hierarchy_mesh_drawable::mark_all_dirty()
+{
+    std::fill(dirty.begin(), dirty.end(), 1);
+}
 
 
 void hierarchy_mesh_drawable::update_local_to_global_coordinates()
 {
     assert_vcl_no_msg(elements.size()>0);
+    assert_vcl_no_msg(parent_index.size()==elements.size() && dirty.size()==elements.size());
 
-    assert_valid_hierarchy(*this);
-
-    const std::string name_root_parent = elements[0].name_parent;
-
-    const size_t N = static_cast<int>(elements.size());
+    // Parents are stored before their children: a single pass propagates the modifications to the descendants
+    const size_t N = elements.size();
     for(size_t k=0; k<N; ++k)
     {
-        hierarchy_mesh_drawable_node& element = elements[k];
+        const int parent = parent_index[k];
+        if(parent>=0 && dirty[parent])
+            dirty[k] = 1;
+        if(!dirty[k])
+            continue;
 
-        const std::string parent_name = element.name_parent;
+        hierarchy_mesh_drawable_node& element = elements[k];
 
         // Case of root element (or same parent) - local=global
-        if( parent_name == name_root_parent ) {
+        if( parent<0 )
             element.global_transform = element.transform;
-        }
         // Else apply hierarchical transformation
         else
-        {
-            const affine_transform& local = element.transform;
-            const affine_transform& global_parent = (*this)[parent_name].global_transform;
-
-            element.global_transform = global_parent * local;
-        }
+            element.global_transform = elements[parent].global_transform * element.transform;
     }
+    std::fill(dirty.begin(), dirty.end(), 0);
 }
 
 void draw(const hierarchy_mesh_drawable& hierarchy, const camera_scene& camera, int shader)
@@ -133,78 +161,6 @@ void draw(const hierarchy_mesh_drawable& hierarchy, const camera_scene& camera,
     }
 }
 
-void assert_valid_hierarchy(const hierarchy_mesh_drawable& hierarchy)
-{
-    if(hierarchy.elements.size()==0)
-        return ;
-
-    {
-        // Check that elements and name_map have the same size
-        const size_t N1 = hierarchy.elements.size();
-        const size_t N2 = hierarchy.name_map.size();
-        if(N1!=N2) {
-            std::cerr<<"Error: Hierarchy not valid - Number of element ("<<N1<<") != Name_map.size() ("<<N2<<")"<<std::endl;
-            abort();
-        }
-    }
-
-    {
-        // Check that the name of the parent of root node doesn't belong to the hierarchy
-        const std::string root_name_parent = hierarchy.elements[0].name_parent;
-        const auto it = hierarchy.name_map.find(root_name_parent);
-        if(it!=hierarchy.name_map.end()) {
-            std::cerr<<"Error: Hierarchy not valid - name of the root node ("<<root_name_parent<<") cannot be an element of the hierarchy"<<std::endl;
-            abort();
-        }
-    }
-
-    {
-        // Check that all names stored in map are designating the corresponding elements
-        for(const auto& e : hierarchy.name_map)
-        {
-            const std::string& name = e.first;
-            const int index = e.second;
-
-            if(index>=int(hierarchy.elements.size()) || index<0)
-            {
-                std::cerr<<"Error: Hierarchy not valid - Incorrect index stored in name_map: "<<name<<";"<<index<<std::endl;
-                abort();
-            }
-
-            const hierarchy_mesh_drawable_node& designated_element = hierarchy.elements[index];
-            if(designated_element.name != name)
-            {
-                std::cerr<<"Error: Hierarchy not valid - Incoherent name between map ("<<name<<";"<<index<<") and element ("<<designated_element.name<<") "<<std::endl;
-                abort();
-            }
-        }
-    }
-
-    {
-        // Check that all parents are defined before their children (excepted for root parent)
-        std::set<std::string> parent_names_visited;
-        parent_names_visited.insert(hierarchy.elements[0].name_parent);
-        const size_t N = hierarchy.elements.size();
-        for(size_t k=0; k<N; ++k)
-        {
-            const std::string& name = hierarchy.elements[k].name;
-            const std::string& parent_name = hierarchy.elements[k].name_parent;
-            if(parent_names_visited.find(parent_name)==parent_names_visited.end())
-            {
-
-                std::cerr<<"Error: Hierarchy not valid"<<std::endl;
-                std::cerr<<"Element ("<<name<<","<<k<<") has parent name ("<<parent_name<<") used before being defined"<<std::endl;
-                abort();
-            }
-            else
-                parent_names_visited.insert(name);
-        }
-    }
-
-
-}
-
-
 
 
 }
@@ -13,16 +13,25 @@ namespace vcl{
 
 
 
+/** Hierarchy of mesh_drawable. Each node has a local transform relative to its parent.
+ *  The parent of each node is resolved once when it is added and stored as an index (parent_index).
+ *  Nodes accessed through the non-const accessors are marked as modified (dirty):
+ *  update_local_to_global_coordinates() only recomputes the global transforms of the modified nodes and of their descendants.
+ *  For animations, resolve the node indices once with index(name) and access the nodes with node(index). */
 struct hierarchy_mesh_drawable
 {
 
     std::map<std::string, int> name_map;
     std::vector<hierarchy_mesh_drawable_node> elements;
 
+    std::vector<int> parent_index;      // Index of the parent node (-1 for the nodes attached to the root frame)
+    std::vector<unsigned char> dirty;   // Nodes whose local transform may have changed since the last update
+
 
     // Add new node to the hierarchy
     // Note: Parent node is expected to be already present in the hierarchy
     // The name of each node must be unique in the hierarchy
+    // Only the new node is validated
     void add(const hierarchy_mesh_drawable_node& node);
 
     // Shortcut to add a new node
@@ -37,13 +46,22 @@ struct hierarchy_mesh_drawable
              const std::string& name_parent,
              const vec3& translation);
 
-    // Get node by name
+    // Get node by name (the node is marked as modified)
     hierarchy_mesh_drawable_node& operator[](const std::string& name);
     // Get node by name
     const hierarchy_mesh_drawable_node& operator[](const std::string& name) const;
 
+    /** Index of the node from its name (to be resolved once) */
+    int index(const std::string& name) const;
+    /** Get node by index (the node is marked as modified) */
+    hierarchy_mesh_drawable_node& node(int index);
+    /** Get node by index */
+    const hierarchy_mesh_drawable_node& node(int index) const;
+
+    /** Mark all the nodes as modified (needed after a direct modification of elements) */
+    void mark_all_dirty();
 
-    // Fill global coordinates of the nodes given the local one
+    // Fill global coordinates of the modified nodes (and of their descendants) given the local one
     void update_local_to_global_coordinates();
 
     /** Set the same shader for all elements of the hierarchy */
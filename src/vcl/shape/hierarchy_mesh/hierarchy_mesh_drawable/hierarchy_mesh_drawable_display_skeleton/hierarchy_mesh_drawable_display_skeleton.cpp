@@ -52,10 +52,11 @@ void hierarchy_mesh_drawable_display_skeleton::draw(const hierarchy_mesh_drawabl
         vcl::draw(frame_visual, camera, shader_mesh);
 
         // Display the skeleton between parent-current position
-        if( k>0 ){
+        const int parent = hierarchy.parent_index[k];
+        if( parent>=0 ){
 
             // Get parent position
-            const hierarchy_mesh_drawable_node& node_parent = hierarchy[node.name_parent];
+            const hierarchy_mesh_drawable_node& node_parent = hierarchy.elements[parent];
             const affine_transform& T_parent = node_parent.global_transform;
             vec3 const p_parent = T_parent.translation + node_parent.element.uniform.transform.translation;
 
@@ -0,0 +1,217 @@
+#include "hierarchy_mesh_palette_drawable.hpp"
+
+#include "vcl/opengl/opengl.hpp"
+
+#include <algorithm>
+
+namespace vcl
+{
+
+static const uniform_id id_palette_sampler = uniform_id_of("palette_sampler");
+static const uniform_id id_number_parts = uniform_id_of("number_parts");
+
+// Texture unit of the palette (0: color texture, 1: heightfield permutation table)
+static GLenum const palette_unit = 2;
+
+// Copy the content of a VBO in a CPU buffer (bound to GL_COPY_READ_BUFFER to keep the bindings of the VAOs unchanged)
+template <typename T>
+static buffer<T> read_back(GLuint vbo)
+{
+    buffer<T> values;
+    if(vbo==0)
+        return values;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, vbo);
+    GLint size = 0;
+    glGetBufferParameteriv(GL_COPY_READ_BUFFER, GL_BUFFER_SIZE, &size);
+    values.resize(size_t(size)/sizeof(T));
+    if(values.size()>0)
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, GLsizeiptr(values.size()*sizeof(T)), &values[0]);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    return values;
+}
+
+// Mesh stored in the VBOs of a mesh_drawable
+static mesh read_back(const mesh_drawable_gpu_data& data)
+{
+    mesh m;
+    m.position = read_back<vec3>(data.vbo_position);
+    m.normal = read_back<vec3>(data.vbo_normal);
+    m.color = read_back<vec4>(data.vbo_color);
+    m.texture_uv = read_back<vec2>(data.vbo_texture_uv);
+    m.connectivity = read_back<uint3>(data.vbo_index);
+    m.connectivity.resize(data.number_triangles);
+    return m;
+}
+
+
+hierarchy_mesh_palette_drawable::hierarchy_mesh_palette_drawable()
+    :data(),vbo_part(0),palette(),palette_buffer(0),palette_texture(0),number_parts(0),number_instances(0),
+      part_bounds(),instance_bounds(),uniform(),shader(0),texture_id(0)
+{}
+
+hierarchy_mesh_palette_drawable::hierarchy_mesh_palette_drawable(const hierarchy_mesh_drawable& hierarchy, unsigned int number_instances_arg, GLuint shader_arg, GLuint texture_id_arg)
+    :data(),vbo_part(0),palette(),palette_buffer(0),palette_texture(0),number_parts(0),number_instances(number_instances_arg),
+      part_bounds(),instance_bounds(),uniform(),shader(shader_arg),texture_id(texture_id_arg)
+{
+    number_parts = static_cast<unsigned int>(hierarchy.elements.size());
+    if(number_parts==0 || number_instances==0)
+        return;
+
+    // Concatenate the meshes of all the nodes, the color of the node is applied to its vertices
+    mesh baked;
+    buffer<GLuint> part;
+    part_bounds.resize(number_parts);
+    for(unsigned int k=0; k<number_parts; ++k)
+    {
+        const mesh_drawable& element = hierarchy.elements[k].element;
+        mesh m = read_back(element.data);
+        m.fill_empty_fields();
+
+        const vec3& c = element.uniform.color;
+        for(vec4& color : m.color)
+            color = {color.x*c.x, color.y*c.y, color.z*c.z, color.w*element.uniform.color_alpha};
+
+        baked.push_back(m);
+        for(size_t i=0; i<m.position.size(); ++i)
+            part.push_back(k);
+        part_bounds[k] = element.data.bounds;
+    }
+    uniform.shading = hierarchy.elements[0].element.uniform.shading;
+
+    data = mesh_drawable_gpu_data(baked);
+    if(data.vao==0)
+        return;
+
+    // Part index at layout 4 (integer attribute)
+    gl_state().bind_vertex_array(data.vao);
+    glGenBuffers(1, &vbo_part);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_part);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(part.size()*sizeof(GLuint)), &part[0], GL_STATIC_DRAW);
+    glEnableVertexAttribArray( 4 );
+    glVertexAttribIPointer( 4, 1, GL_UNSIGNED_INT, 0, nullptr );
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl_state().bind_vertex_array(0);
+
+    // Palette: identity matrices until the first update
+    palette.resize(3*number_parts*number_instances);
+    for(size_t k=0; k<palette.size(); k+=3) {
+        palette[k]   = {1,0,0,0};
+        palette[k+1] = {0,1,0,0};
+        palette[k+2] = {0,0,1,0};
+    }
+
+    glGenBuffers(1, &palette_buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, palette_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, GLsizeiptr(palette.size()*sizeof(vec4)), &palette[0], GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glGenTextures(1, &palette_texture);
+    gl_state().bind_texture(GL_TEXTURE_BUFFER, palette_texture, palette_unit);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, palette_buffer);
+    opengl_debug();
+}
+
+void hierarchy_mesh_palette_drawable::clear()
+{
+    data.clear();
+    glDeleteBuffers(1, &vbo_part);
+    glDeleteBuffers(1, &palette_buffer);
+    if(palette_texture!=0)
+        gl_state().bind_texture(GL_TEXTURE_BUFFER, 0, palette_unit);
+    glDeleteTextures(1, &palette_texture);
+
+    vbo_part = 0;
+    palette_buffer = 0;
+    palette_texture = 0;
+    palette.clear();
+    number_parts = 0;
+    number_instances = 0;
+    part_bounds.clear();
+    instance_bounds = bounding_volume();
+}
+
+void hierarchy_mesh_palette_drawable::update_palette(const hierarchy_mesh_drawable& hierarchy, unsigned int instance)
+{
+    assert_vcl(instance<number_instances, "Incorrect instance index ("+str(instance)+") for palette of "+str(number_instances)+" instances");
+    assert_vcl(hierarchy.elements.size()==number_parts, "Hierarchy doesn't match the baked one");
+
+    vec4* rows = &palette[3*number_parts*instance];
+    for(unsigned int k=0; k<number_parts; ++k)
+    {
+        // Same transformation as draw(hierarchy): p -> R*(S*p)+t
+        const hierarchy_mesh_drawable_node& node = hierarchy.elements[k];
+        const affine_transform T = node.global_transform * node.element.uniform.transform;
+        const vec3 s = T.scaling*T.scaling_axis;
+        const mat3& R = T.rotation;
+        for(size_t i=0; i<3; ++i)
+            rows[3*k+i] = {R(i,0)*s.x, R(i,1)*s.y, R(i,2)*s.z, T.translation[i]};
+    }
+}
+
+void hierarchy_mesh_palette_drawable::upload_palette()
+{
+    if(palette_buffer==0)
+        return;
+
+    glBindBuffer(GL_TEXTURE_BUFFER, palette_buffer);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, GLsizeiptr(palette.size()*sizeof(vec4)), &palette[0]);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    // Box enclosing the part volumes in their current pose
+    vec3 p_min, p_max;
+    const size_t N = size_t(number_parts)*number_instances;
+    for(size_t k=0; k<N; ++k)
+    {
+        const bounding_volume& b = part_bounds[k%number_parts];
+        const vec4* rows = &palette[3*k];
+        vec3 c, h;
+        for(size_t i=0; i<3; ++i) {
+            const vec4& r = rows[i];
+            c[i] = r.x*b.center.x + r.y*b.center.y + r.z*b.center.z + r.w;
+            h[i] = std::abs(r.x)*b.half_extent.x + std::abs(r.y)*b.half_extent.y + std::abs(r.z)*b.half_extent.z;
+        }
+        p_min = (k==0)? c-h : vec3{std::min(p_min.x,c.x-h.x), std::min(p_min.y,c.y-h.y), std::min(p_min.z,c.z-h.z)};
+        p_max = (k==0)? c+h : vec3{std::max(p_max.x,c.x+h.x), std::max(p_max.y,c.y+h.y), std::max(p_max.z,c.z+h.z)};
+    }
+    instance_bounds = bounding_volume((p_min+p_max)/2.0f, (p_max-p_min)/2.0f);
+}
+
+
+void uniform(GLuint shader, const hierarchy_mesh_palette_drawable& drawable)
+{
+    gl_state().bind_texture(GL_TEXTURE_BUFFER, drawable.palette_texture, palette_unit); opengl_debug();
+    uniform(shader, id_palette_sampler, int(palette_unit)); opengl_debug();
+    uniform(shader, id_number_parts, int(drawable.number_parts)); opengl_debug();
+}
+
+void draw(const hierarchy_mesh_palette_drawable& drawable, const camera_scene& camera)
+{
+    draw(drawable, camera, drawable.shader);
+}
+
+void draw(const hierarchy_mesh_palette_drawable& drawable, const camera_scene& camera, GLuint shader)
+{
+    if(shader==0 || drawable.number_instances==0)
+        return ;
+
+    if( shader!=gl_state().program() && glIsProgram(shader)==GL_FALSE ) {
+        std::cout<<"No valid shader set to display hierarchy palette: skip display"<<std::endl;
+        return;
+    }
+    gl_state().use_program(shader); opengl_debug();
+
+    if(drawable.texture_id!=0) {
+        assert(glIsTexture(drawable.texture_id));
+        gl_state().bind_texture(GL_TEXTURE_2D, drawable.texture_id); opengl_debug();
+    }
+
+    uniform(shader, drawable.uniform); opengl_debug();
+    uniform(shader, camera);           opengl_debug();
+    uniform(shader, drawable);
+
+    // All the parts (and all the instances) in a single call
+    vcl::draw(drawable.data, drawable.number_instances);
+}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../hierarchy_mesh_drawable/hierarchy_mesh_drawable.hpp"
+
+namespace vcl
+{
+
+/** Rigid hierarchy drawn in a single call with a matrix-palette shader.
+ *  The meshes of all the nodes are baked once in a single vertex/index buffer where each vertex stores the index of its node (part).
+ *  At every frame, the global transforms of the nodes (one 3x4 matrix per part) are written in the palette and sent to the GPU
+ *  in a texture buffer: the vertex shader applies the matrix of the part of each vertex.
+ *  Several instances of the same hierarchy (with different poses) can be drawn at once: instance k reads the part matrices k*number_parts ...
+ *  Expected shader: shaders/mesh_palette (vertex attribute 4: part index, samplerBuffer palette_sampler).
+ *  Note: the color of each node is baked in the vertex colors, the shading parameters are the ones of the first node. */
+struct hierarchy_mesh_palette_drawable
+{
+    hierarchy_mesh_palette_drawable();
+    /** Bake the meshes of the hierarchy (read back from their VBOs) and allocate the palette for the given number of instances */
+    hierarchy_mesh_palette_drawable(const hierarchy_mesh_drawable& hierarchy, unsigned int number_instances=1, GLuint shader=0, GLuint texture_id=0);
+
+    /** Clear buffers (VBO, VAO, palette) */
+    void clear();
+
+    /** Fill the palette of one instance from the global coordinates of the hierarchy (expected to be up to date).
+     *  The hierarchy must have the same nodes as the baked one. */
+    void update_palette(const hierarchy_mesh_drawable& hierarchy, unsigned int instance=0);
+    /** Send the palette of all the instances to the GPU and update the bounding volume (once per frame, after update_palette) */
+    void upload_palette();
+
+    /** Baked meshes: per-vertex part index stored at layout 4 of the VAO */
+    mesh_drawable_gpu_data data;
+    GLuint vbo_part;
+
+    /** Rows of the 3x4 matrix of each part (3 vec4 per part), instances stored one after the other */
+    buffer<vec4> palette;
+    GLuint palette_buffer;   // GPU storage of the palette
+    GLuint palette_texture;  // Texture buffer (RGBA32F) reading palette_buffer
+
+    unsigned int number_parts;
+    unsigned int number_instances;
+
+    buffer<bounding_volume> part_bounds; // Bounding volume of the baked mesh of each part (local coordinates of the node)
+    bounding_volume instance_bounds;     // Volume of all the instances in their current pose (set by upload_palette)
+
+    mesh_drawable_uniform uniform;       // Transformation applied after the palette, shading parameters
+    GLuint shader;
+    GLuint texture_id;
+};
+
+/** Send the palette texture and the number of parts to the shader */
+void uniform(GLuint shader, const hierarchy_mesh_palette_drawable& drawable);
+
+void draw(const hierarchy_mesh_palette_drawable& drawable, const camera_scene& camera);
+void draw(const hierarchy_mesh_palette_drawable& drawable, const camera_scene& camera, GLuint shader);
+
+}
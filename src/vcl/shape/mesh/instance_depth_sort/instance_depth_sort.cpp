@@ -0,0 +1,45 @@
+#include "instance_depth_sort.hpp"
+
+#include "vcl/base/sort/sort.hpp"
+
+namespace vcl
+{
+
+instance_depth_sort::instance_depth_sort()
+    :reuse_threshold(0.05f),reused(false),key(),order(),sorted(),previous_position(),previous_direction()
+{}
+
+void instance_depth_sort::sort(buffer<mesh_instance>& instances, const camera_scene& camera, const affine_transform& T)
+{
+    const size_t N = instances.size();
+    const vec3 position = camera.camera_position();
+    const vec3 direction = camera.orientation*vec3{0,0,-1}; // the camera looks along its local -z axis
+
+    // Decreasing depth = increasing key of the opposite depth
+    key.resize(N);
+    for(size_t k=0; k<N; ++k)
+    {
+        const vec3& t = instances[k].translation;
+        const vec3 p = T.rotation*(T.scaling*vec3{T.scaling_axis.x*t.x, T.scaling_axis.y*t.y, T.scaling_axis.z*t.z}) + T.translation;
+        key[k] = float_sort_key(-dot(p-position, direction));
+    }
+
+    const float motion = norm(position-previous_position) + norm(direction-previous_direction);
+    reused = order.size()==N && motion<reuse_threshold;
+
+    // Fall back to the radix sort if the previous order is too far from the new one
+    if( !reused || !insertion_sort(key, order, 8*N) )
+    {
+        reused = false;
+        radix_sort(key, order);
+    }
+    previous_position = position;
+    previous_direction = direction;
+
+    sorted.resize(N);
+    for(size_t k=0; k<N; ++k)
+        sorted[k] = instances[order[k]];
+    instances.data.swap(sorted.data);
+}
+
+}
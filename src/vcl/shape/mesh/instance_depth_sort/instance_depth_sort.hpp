@@ -0,0 +1,35 @@
+#pragma once
+
+#include "vcl/shape/mesh/instanced_mesh_drawable/instanced_mesh_drawable.hpp"
+
+#include <vector>
+
+namespace vcl
+{
+
+/** Back-to-front ordering of the instances of a transparent instanced mesh.
+ *  Instances are sorted by their depth along the view direction (radix sort on the float depths).
+ *  When the camera barely moves and the number of instances is unchanged, the order of the previous frame
+ *  is refined with an insertion sort instead (linear time for an almost sorted order).
+ *  The instances are expected to be given in the same order at every frame for the previous order to be meaningful. */
+struct instance_depth_sort
+{
+    instance_depth_sort();
+
+    /** Reorder the instances from the furthest to the nearest one.
+     *  transform is the transformation of the drawable applied after the instance transformation (drawable.uniform.transform). */
+    void sort(buffer<mesh_instance>& instances, const camera_scene& camera, const affine_transform& transform=affine_transform());
+
+    /** Camera motion (translation + variation of the view direction) below which the previous order is reused */
+    float reuse_threshold;
+    /** True if the last call refined the previous order instead of sorting from scratch */
+    bool reused;
+
+    std::vector<uint32_t> key;      // Depth keys of the current frame (sorted in increasing order)
+    std::vector<unsigned int> order; // Index of the input instances in back-to-front order
+    buffer<mesh_instance> sorted;   // Temporary storage of the reordered instances
+    vec3 previous_position;
+    vec3 previous_direction;
+};
+
+}
@@ -0,0 +1,168 @@
+#include "instanced_mesh_drawable.hpp"
+
+#include "vcl/opengl/opengl.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace vcl
+{
+
+static_assert(sizeof(mesh_instance)==(3+9+1+4)*sizeof(float), "mesh_instance is expected to be tightly packed floats");
+
+mesh_instance::mesh_instance()
+    :translation(0,0,0),rotation(mat3::identity()),scaling(1.0f),color(1,1,1,1)
+{}
+
+mesh_instance::mesh_instance(const vec3& translation_arg, const mat3& rotation_arg, float scaling_arg, const vec4& color_arg)
+    :translation(translation_arg),rotation(rotation_arg),scaling(scaling_arg),color(color_arg)
+{}
+
+
+instanced_mesh_drawable::instanced_mesh_drawable()
+    :data(),uniform(),shader(0),texture_id(0),vbo_instance(0),number_instances(0),capacity_instances(0),instance_bounds()
+{}
+
+instanced_mesh_drawable::instanced_mesh_drawable(const mesh& mesh_cpu, GLuint shader_arg, GLuint texture_id_arg)
+    :data(mesh_cpu),uniform(),shader(shader_arg),texture_id(texture_id_arg),vbo_instance(0),number_instances(0),capacity_instances(0),instance_bounds()
+{
+    if(data.vao==0)
+        return;
+
+    glGenBuffers(1, &vbo_instance);
+
+    gl_state().bind_vertex_array(data.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_instance);
+
+    const GLsizei stride = sizeof(mesh_instance);
+    const size_t f = sizeof(float);
+
+    // translation at layout 4
+    glEnableVertexAttribArray( 4 );
+    glVertexAttribPointer( 4, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(0) );
+    // rotation rows at layout 5, 6, 7
+    for(GLuint k=0; k<3; ++k) {
+        glEnableVertexAttribArray( 5+k );
+        glVertexAttribPointer( 5+k, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>((3+3*k)*f) );
+    }
+    // scaling at layout 8
+    glEnableVertexAttribArray( 8 );
+    glVertexAttribPointer( 8, 1, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(12*f) );
+    // color at layout 9
+    glEnableVertexAttribArray( 9 );
+    glVertexAttribPointer( 9, 4, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<void*>(13*f) );
+
+    // One value per instance
+    for(GLuint k=4; k<=9; ++k)
+        glVertexAttribDivisor(k, 1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl_state().bind_vertex_array(0);
+    opengl_debug();
+}
+
+void instanced_mesh_drawable::clear()
+{
+    data.clear();
+    glDeleteBuffers(1,&vbo_instance);
+
+    vbo_instance = 0;
+    number_instances = 0;
+    capacity_instances = 0;
+    instance_bounds = bounding_volume();
+}
+
+void instanced_mesh_drawable::update_instances(const buffer<mesh_instance>& instances)
+{
+    assert_vcl(vbo_instance!=0, "Instanced mesh is not initialized");
+
+    number_instances = static_cast<unsigned int>(instances.size());
+    if(number_instances==0)
+        return;
+
+    // Box enclosing the bounding spheres of the instances
+    const bounding_volume& b = data.bounds;
+    vec3 p_min, p_max;
+    for(size_t k=0; k<number_instances; ++k)
+    {
+        const mesh_instance& instance = instances[k];
+        const vec3 c = instance.rotation*(instance.scaling*b.center) + instance.translation;
+        const float r = std::abs(instance.scaling)*b.radius;
+        const vec3 c_min = c-vec3(r,r,r);
+        const vec3 c_max = c+vec3(r,r,r);
+        p_min = (k==0)? c_min : vec3{std::min(p_min.x,c_min.x), std::min(p_min.y,c_min.y), std::min(p_min.z,c_min.z)};
+        p_max = (k==0)? c_max : vec3{std::max(p_max.x,c_max.x), std::max(p_max.y,c_max.y), std::max(p_max.z,c_max.z)};
+    }
+    instance_bounds = bounding_volume( (p_min+p_max)/2.0f, (p_max-p_min)/2.0f );
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_instance);
+    // Geometric growth: a slowly increasing number of instances doesn't reallocate at every update
+    if(number_instances > capacity_instances)
+        capacity_instances = std::max(number_instances, 2*capacity_instances);
+    // Allocate the new storage, or orphan the previous one to avoid waiting for the draw calls still using it
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(capacity_instances*sizeof(mesh_instance)), nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, GLsizeiptr(number_instances*sizeof(mesh_instance)), &instances[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    opengl_debug();
+}
+
+
+void draw(const instanced_mesh_drawable& drawable, const camera_scene& camera)
+{
+    draw(drawable, camera, drawable.shader);
+}
+
+void draw(const instanced_mesh_drawable& drawable, const camera_scene& camera, GLuint shader)
+{
+    if(shader==0 || drawable.number_instances==0 || drawable.data.number_triangles==0)
+        return ;
+
+    if( shader!=gl_state().program() && glIsProgram(shader)==GL_FALSE ) {
+        std::cout<<"No valid shader set to display instanced mesh: skip display"<<std::endl;
+        return;
+    }
+    gl_state().use_program(shader); opengl_debug();
+
+    if(drawable.texture_id!=0) {
+        assert(glIsTexture(drawable.texture_id));
+        gl_state().bind_texture(GL_TEXTURE_2D, drawable.texture_id);  opengl_debug();
+    }
+
+    // Uniform values are sent once for all the instances
+    uniform(shader, drawable.uniform);  opengl_debug();
+    uniform(shader, camera);            opengl_debug();
+
+    vcl::draw(drawable.data, drawable.number_instances); opengl_debug();
+}
+
+void cull_instances(buffer<mesh_instance>& instances, const bounding_volume& mesh_volume, const affine_transform& T, const frustum& f, culling_counters& counters)
+{
+    const size_t N = instances.size();
+    const vec3 s = T.scaling*T.scaling_axis;
+    const float s_max = std::max(std::abs(s.x), std::max(std::abs(s.y), std::abs(s.z)));
+
+    // Bounding sphere of each instance in world coordinates
+    std::vector<vec4> sphere(N);
+    for(size_t k=0; k<N; ++k)
+    {
+        const mesh_instance& instance = instances[k];
+        const vec3 c = instance.rotation*(instance.scaling*mesh_volume.center) + instance.translation;
+        const vec3 p = T.rotation*vec3{s.x*c.x, s.y*c.y, s.z*c.z} + T.translation;
+        sphere[k] = {p.x, p.y, p.z, s_max*std::abs(instance.scaling)*mesh_volume.radius};
+    }
+
+    std::vector<unsigned char> visible(N);
+    frustum_cull(f, sphere.data(), N, visible.data());
+
+    size_t count = 0;
+    for(size_t k=0; k<N; ++k)
+        if(visible[k])
+            instances[count++] = instances[k];
+    instances.resize(count);
+
+    counters.submitted += N;
+    counters.culled += N-count;
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "vcl/shape/mesh/mesh_drawable/mesh_drawable.hpp"
+
+
+namespace vcl
+{
+
+/** Transformation and color of one instance.
+ *  The vertex p of the mesh is placed at rotation*(scaling*p)+translation before the transformation of the drawable. */
+struct mesh_instance
+{
+    mesh_instance();
+    mesh_instance(const vec3& translation, const mat3& rotation=mat3::identity(), float scaling=1.0f, const vec4& color={1,1,1,1});
+
+    vec3 translation;
+    mat3 rotation;
+    float scaling;
+    vec4 color;
+};
+
+/** Mesh drawn several times with a single draw call.
+ *  The per-instance data (mesh_instance) is stored in a VBO attached to the VAO of the mesh (layout 4 to 9, divisor 1).
+ *  Expects to be drawn with the mesh_instanced, mesh_array_instanced or wireframe_instanced shaders. */
+struct instanced_mesh_drawable
+{
+public:
+
+    instanced_mesh_drawable();
+    /** Initialize VAO and VBO from the mesh (with no instance) */
+    instanced_mesh_drawable(const mesh& mesh_cpu, GLuint shader = 0, GLuint texture_id = 0);
+
+    /** Clear buffers (VBO, VAO, etc) */
+    void clear();
+
+    /** Replace the set of instances.
+     *  The instance VBO is only reallocated when it grows (to at least twice its capacity), otherwise it is orphaned and refilled.
+     *  The bounding volume of all the instances is updated as well. */
+    void update_instances(const buffer<mesh_instance>& instances);
+
+
+    mesh_drawable_gpu_data data;
+    mesh_drawable_uniform uniform;  // Transformation applied to all instances
+    GLuint shader;
+    GLuint texture_id;
+
+    GLuint vbo_instance;            // Per-instance data (mesh_instance)
+    unsigned int number_instances;
+    unsigned int capacity_instances; // Number of instances allocated in vbo_instance
+    bounding_volume instance_bounds; // Volume enclosing all the instances (before the transformation of the drawable)
+};
+
+void draw(const instanced_mesh_drawable& drawable, const camera_scene& camera);
+void draw(const instanced_mesh_drawable& drawable, const camera_scene& camera, GLuint shader);
+
+/** Remove the instances whose bounding sphere is outside of the frustum (the order of the remaining ones is preserved).
+ *  mesh_volume is the volume of the instanced mesh (drawable.data.bounds), transform the one of the drawable (drawable.uniform.transform).
+ *  The instances are tested by packets with frustum_cull. */
+void cull_instances(buffer<mesh_instance>& instances, const bounding_volume& mesh_volume, const affine_transform& transform, const frustum& f, culling_counters& counters);
+
+}
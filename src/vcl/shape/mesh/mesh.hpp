@@ -4,3 +4,5 @@
 #include "mesh_primitive/mesh_primitive.hpp"
 #include "mesh_loader/mesh_loader.hpp"
 #include "mesh_drawable/mesh_drawable.hpp"
+#include "instanced_mesh_drawable/instanced_mesh_drawable.hpp"
+#include "instance_depth_sort/instance_depth_sort.hpp"
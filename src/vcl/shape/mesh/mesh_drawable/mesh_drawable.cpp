@@ -2,9 +2,26 @@
 
 #include "vcl/opengl/opengl.hpp"
 
+#include <cstring>
+
 namespace vcl
 {
 
+// Interned names of the uniforms sent for every mesh
+static const uniform_id id_rotation = uniform_id_of("rotation");
+static const uniform_id id_translation = uniform_id_of("translation");
+static const uniform_id id_scaling = uniform_id_of("scaling");
+static const uniform_id id_scaling_axis = uniform_id_of("scaling_axis");
+static const uniform_id id_color = uniform_id_of("color");
+static const uniform_id id_color_alpha = uniform_id_of("color_alpha");
+static const uniform_id id_texture_layer = uniform_id_of("texture_layer");
+static const uniform_id id_ambiant = uniform_id_of("ambiant");
+static const uniform_id id_diffuse = uniform_id_of("diffuse");
+static const uniform_id id_specular = uniform_id_of("specular");
+static const uniform_id id_specular_exponent = uniform_id_of("specular_exponent");
+static const uniform_id id_perspective = uniform_id_of("perspective");
+static const uniform_id id_view = uniform_id_of("view");
+static const uniform_id id_camera_position = uniform_id_of("camera_position");
 
 
 mesh_drawable::mesh_drawable()
@@ -15,6 +32,10 @@ mesh_drawable::mesh_drawable(const mesh& mesh_arg, GLuint shader_arg, GLuint tex
     :data(mesh_arg),uniform(),shader(shader_arg),texture_id(texture_id_arg)
 {}
 
+mesh_drawable::mesh_drawable(const mesh_binary_file& file, GLuint shader_arg, GLuint texture_id_arg)
+    :data(file),uniform(),shader(shader_arg),texture_id(texture_id_arg)
+{}
+
 void mesh_drawable::clear()
 {
     data.clear();
@@ -25,6 +46,11 @@ void mesh_drawable::update_position(const vcl::buffer<vec3>& new_position)
     data.update_position(new_position);
 }
 
+void mesh_drawable::update_position(const vcl::buffer<vec3>& new_position, const bounding_volume& new_bounds)
+{
+    data.update_position(new_position, new_bounds);
+}
+
 void mesh_drawable::update_normal(const vcl::buffer<vec3>& new_normal)
 {
     data.update_normal(new_normal);
@@ -48,44 +74,75 @@ void draw(const mesh_drawable& drawable, const camera_scene& camera, GLuint shad
     if(shader==0)
         return ;
 
-    // Check that the shader is a valid one
-    if( glIsProgram(shader)==GL_FALSE ) {
+    // Check that the shader is a valid one (only needed when switching program)
+    if( shader!=gl_state().program() && glIsProgram(shader)==GL_FALSE ) {
         std::cout<<"No valid shader set to display mesh: skip display"<<std::endl;
         return;
     }
-
-    // Switch shader program only if necessary
-    GLint current_shader = 0;
-    glGetIntegerv(GL_CURRENT_PROGRAM, &current_shader); opengl_debug();
-    if(shader!=GLuint(current_shader))
-        glUseProgram(shader); opengl_debug();
+    gl_state().use_program(shader); opengl_debug();
 
     // Bind texture only if id != 0
     if(texture_id!=0) {
         assert(glIsTexture(texture_id));
-        glBindTexture(GL_TEXTURE_2D, texture_id);  opengl_debug();
+        gl_state().bind_texture(GL_TEXTURE_2D, texture_id);  opengl_debug();
     }
 
     // Send all uniform values to the shader
-    uniform(shader, "rotation", drawable.uniform.transform.rotation);            opengl_debug();
-    uniform(shader, "translation", drawable.uniform.transform.translation);      opengl_debug();
-    uniform(shader, "color", drawable.uniform.color);                            opengl_debug();
-    uniform(shader, "color_alpha", drawable.uniform.color_alpha);                opengl_debug();
-    uniform(shader, "scaling", drawable.uniform.transform.scaling);              opengl_debug();
-    uniform(shader, "scaling_axis", drawable.uniform.transform.scaling_axis);    opengl_debug();
-
-    uniform(shader,"perspective",camera.perspective.matrix());         opengl_debug();
-    uniform(shader,"view",camera.view_matrix());                       opengl_debug();
-    uniform(shader,"camera_position",camera.camera_position());        opengl_debug();
-
-    uniform(shader, "ambiant", drawable.uniform.shading.ambiant);      opengl_debug();
-    uniform(shader, "diffuse", drawable.uniform.shading.diffuse);      opengl_debug();
-    uniform(shader, "specular", drawable.uniform.shading.specular);    opengl_debug();
-    uniform(shader, "specular_exponent", drawable.uniform.shading.specular_exponent); opengl_debug();
+    uniform(shader, drawable.uniform);  opengl_debug();
+    uniform(shader, camera);            opengl_debug();
 
     vcl::draw(drawable.data); opengl_debug();
 
 
 }
 
+
+void uniform(GLuint shader, const mesh_drawable_uniform& drawable_uniform)
+{
+    uniform(shader, id_rotation, drawable_uniform.transform.rotation);
+    uniform(shader, id_translation, drawable_uniform.transform.translation);
+    uniform(shader, id_color, drawable_uniform.color);
+    uniform(shader, id_color_alpha, drawable_uniform.color_alpha);
+    uniform(shader, id_texture_layer, drawable_uniform.texture_layer);
+    uniform(shader, id_scaling, drawable_uniform.transform.scaling);
+    uniform(shader, id_scaling_axis, drawable_uniform.transform.scaling_axis);
+
+    uniform(shader, id_ambiant, drawable_uniform.shading.ambiant);
+    uniform(shader, id_diffuse, drawable_uniform.shading.diffuse);
+    uniform(shader, id_specular, drawable_uniform.shading.specular);
+    uniform(shader, id_specular_exponent, drawable_uniform.shading.specular_exponent);
+}
+
+void uniform(GLuint shader, const camera_scene& camera)
+{
+    update_camera_uniform_buffer(camera);
+
+    // Skip the computation of the matrices when the shader uses the camera_data block
+    if(uniform_location(shader, id_perspective)!=-1)
+        uniform(shader, id_perspective, camera.perspective.matrix());
+    if(uniform_location(shader, id_view)!=-1)
+        uniform(shader, id_view, camera.view_matrix());
+    if(uniform_location(shader, id_camera_position)!=-1)
+        uniform(shader, id_camera_position, camera.camera_position());
+}
+
+void update_camera_uniform_buffer(const camera_scene& camera)
+{
+    // Parameters of the camera uploaded by the last call, valid while no other upload replaced the buffer
+    static float uploaded[17] = {};
+    static size_t uploaded_version = 0;
+
+    float parameters[17] = {camera.scale, camera.translation.x, camera.translation.y, camera.translation.z,
+                            camera.perspective.angle_of_view, camera.perspective.image_aspect, camera.perspective.z_near, camera.perspective.z_far};
+    for(size_t k=0; k<9; ++k)
+        parameters[8+k] = camera.orientation[k];
+
+    if(uploaded_version!=0 && uploaded_version==camera_uniform_buffer_version() && std::memcmp(parameters, uploaded, sizeof(parameters))==0)
+        return;
+
+    update_camera_uniform_buffer(camera.perspective.matrix(), camera.view_matrix(), camera.camera_position());
+    std::memcpy(uploaded, parameters, sizeof(parameters));
+    uploaded_version = camera_uniform_buffer_version();
+}
+
 }
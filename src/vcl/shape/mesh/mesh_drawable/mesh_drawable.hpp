@@ -23,6 +23,8 @@ public:
     mesh_drawable();
     /** Initialize VAO and VBO from the mesh */
     mesh_drawable(const mesh& mesh_cpu, GLuint shader = 0, GLuint texture_id = 0);
+    /** Initialize VAO and VBO directly from a mapped binary mesh file */
+    mesh_drawable(const mesh_binary_file& file, GLuint shader = 0, GLuint texture_id = 0);
 
 
     /** Clear buffers (VBO, VAO, etc) */
@@ -31,6 +33,8 @@ public:
     /** Dynamically update the VBO with the new vector of position
      * Warning: new_position is expected to have the same size (or less) than the initialized one */
     void update_position(const vcl::buffer<vec3>& new_position);
+    /** Same update with the bounding volume of new_position given by the caller */
+    void update_position(const vcl::buffer<vec3>& new_position, const bounding_volume& new_bounds);
 
     /** Dynamically update the VBO with the new vector of normal
      * Warning: new_normal is expected to have the same size (or less) than the initialized one */
@@ -48,4 +52,15 @@ void draw(const mesh_drawable& drawable, const camera_scene& camera);
 void draw(const mesh_drawable& drawable, const camera_scene& camera, GLuint shader);
 void draw(const mesh_drawable& drawable, const camera_scene& camera, GLuint shader, GLuint texture_id);
 
+/** Send the transformation, color and shading parameters to the shader */
+void uniform(GLuint shader, const mesh_drawable_uniform& drawable_uniform);
+/** Send the perspective, view and camera position to the shader.
+ *  The camera_data uniform buffer is updated if it holds another camera (see update_camera_uniform_buffer),
+ *  the individual uniforms are only sent to the shaders which don't use the block. */
+void uniform(GLuint shader, const camera_scene& camera);
+
+/** Upload the camera in the uniform buffer read by the camera_data blocks.
+ *  The upload is skipped if the buffer already holds this camera: drawing with a second camera (ex. a mini-map) only costs two uploads. */
+void update_camera_uniform_buffer(const camera_scene& camera);
+
 }
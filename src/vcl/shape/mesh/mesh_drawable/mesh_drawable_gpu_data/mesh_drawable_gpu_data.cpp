@@ -6,77 +6,113 @@ namespace vcl
 {
 
 mesh_drawable_gpu_data::mesh_drawable_gpu_data()
-    :vao(0), number_triangles(0), vbo_index(0), vbo_position(0), vbo_normal(0), vbo_color(0), vbo_texture_uv(0)
+    :vao(0), number_triangles(0), vbo_index(0), vbo_position(0), vbo_normal(0), vbo_color(0), vbo_texture_uv(0), bounds()
 {}
 
-mesh_drawable_gpu_data::mesh_drawable_gpu_data(const mesh &mesh_cpu_arg)
+// Create the VBOs and the VAO from per-vertex attributes (all of them of size N) and T triangles
+static void upload(mesh_drawable_gpu_data& data, size_t N, const vec3* position, const vec3* normal, const vec4* color, const vec2* texture_uv,
+                   size_t T, const uint3* connectivity)
 {
-    // Doesn't assign anything if there is no position
-    if(mesh_cpu_arg.position.size()==0)
-        return;
-
-    // temp copy of the mesh to fill all empty fields
-    mesh mesh_cpu = mesh_cpu_arg;
-    mesh_cpu.fill_empty_fields();
-
     // Fill VBO for position
-    glGenBuffers(1, &vbo_position);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_position);
-    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(mesh_cpu.position.size()*sizeof(GLfloat)*3), &mesh_cpu.position[0], GL_DYNAMIC_DRAW );
+    glGenBuffers(1, &data.vbo_position);
+    glBindBuffer(GL_ARRAY_BUFFER, data.vbo_position);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(N*sizeof(GLfloat)*3), position, GL_DYNAMIC_DRAW );
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     // Fill VBO for normal
-    glGenBuffers(1, &vbo_normal);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_normal);
-    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(mesh_cpu.normal.size()*sizeof(GLfloat)*3), &mesh_cpu.normal[0], GL_DYNAMIC_DRAW );
+    glGenBuffers(1, &data.vbo_normal);
+    glBindBuffer(GL_ARRAY_BUFFER, data.vbo_normal);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(N*sizeof(GLfloat)*3), normal, GL_DYNAMIC_DRAW );
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     // Fill VBO for color
-    glGenBuffers(1, &vbo_color);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_color);
-    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(mesh_cpu.color.size()*sizeof(GLfloat)*4), &mesh_cpu.color[0], GL_DYNAMIC_DRAW );
+    glGenBuffers(1, &data.vbo_color);
+    glBindBuffer(GL_ARRAY_BUFFER, data.vbo_color);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(N*sizeof(GLfloat)*4), color, GL_DYNAMIC_DRAW );
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     // Fill VBO for texture uv
-    glGenBuffers(1, &vbo_texture_uv);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_texture_uv);
-    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(mesh_cpu.texture_uv.size()*sizeof(GLfloat)*2), &mesh_cpu.texture_uv[0], GL_DYNAMIC_DRAW );
+    glGenBuffers(1, &data.vbo_texture_uv);
+    glBindBuffer(GL_ARRAY_BUFFER, data.vbo_texture_uv);
+    glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(N*sizeof(GLfloat)*2), texture_uv, GL_DYNAMIC_DRAW );
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    // Fill VBO for index
-    glGenBuffers(1, &vbo_index);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo_index);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(mesh_cpu.connectivity.size()*sizeof(GLuint)*3), &mesh_cpu.connectivity[0], GL_DYNAMIC_DRAW );
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    data.number_triangles = static_cast<unsigned int>(T);
 
-    number_triangles = static_cast<unsigned int>(mesh_cpu.connectivity.size());
+    glGenVertexArrays(1,&data.vao);
+    gl_state().bind_vertex_array(data.vao);
 
-    glGenVertexArrays(1,&vao);
-    glBindVertexArray(vao);
+    // Fill VBO for index: the binding is stored in the VAO and doesn't need to be set again at draw time
+    glGenBuffers(1, &data.vbo_index);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, data.vbo_index);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(T*sizeof(GLuint)*3), connectivity, GL_DYNAMIC_DRAW );
 
     // position at layout 0
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_position);
+    glBindBuffer(GL_ARRAY_BUFFER, data.vbo_position);
     glEnableVertexAttribArray( 0 );
     glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, nullptr );
 
     // normals at layout 1
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_normal);
+    glBindBuffer(GL_ARRAY_BUFFER, data.vbo_normal);
     glEnableVertexAttribArray( 1 );
     glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, 0, nullptr );
 
     // colors at layout 2
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_color);
+    glBindBuffer(GL_ARRAY_BUFFER, data.vbo_color);
     glEnableVertexAttribArray( 2 );
     glVertexAttribPointer( 2, 4, GL_FLOAT, GL_FALSE, 0, nullptr );
 
     // texture uv at layout 3
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_texture_uv);
+    glBindBuffer(GL_ARRAY_BUFFER, data.vbo_texture_uv);
     glEnableVertexAttribArray( 3 );
     glVertexAttribPointer( 3, 2, GL_FLOAT, GL_FALSE, 0, nullptr );
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    gl_state().bind_vertex_array(0);
+}
 
+mesh_drawable_gpu_data::mesh_drawable_gpu_data(const mesh &mesh_cpu_arg)
+    :vao(0), number_triangles(0), vbo_index(0), vbo_position(0), vbo_normal(0), vbo_color(0), vbo_texture_uv(0), bounds()
+{
+    // Doesn't assign anything if there is no position
+    if(mesh_cpu_arg.position.size()==0)
+        return;
+
+    // temp copy of the mesh to fill all empty fields
+    mesh mesh_cpu = mesh_cpu_arg;
+    mesh_cpu.fill_empty_fields();
+
+    upload(*this, mesh_cpu.position.size(), &mesh_cpu.position[0], &mesh_cpu.normal[0], &mesh_cpu.color[0], &mesh_cpu.texture_uv[0],
+           mesh_cpu.connectivity.size(), &mesh_cpu.connectivity[0]);
+    bounds = compute_bounding_volume(mesh_cpu.position);
+}
+
+mesh_drawable_gpu_data::mesh_drawable_gpu_data(const mesh_binary_file& file)
+    :vao(0), number_triangles(0), vbo_index(0), vbo_position(0), vbo_normal(0), vbo_color(0), vbo_texture_uv(0), bounds()
+{
+    const size_t N = file.vertex_count();
+    if(N==0)
+        return;
+
+    // The stored streams are sent from the mapped file, the missing ones are filled as in mesh::fill_empty_fields
+    mesh missing;
+    if(file.normal==nullptr) {
+        mesh shape;
+        shape.position.data.assign(file.position, file.position+N);
+        shape.connectivity.data.assign(file.connectivity, file.connectivity+file.triangle_count());
+        missing.normal = normal(shape.position, shape.connectivity);
+    }
+    if(file.color==nullptr)
+        missing.color.data.assign(N, vec4(1,1,1,1));
+    if(file.texture_uv==nullptr)
+        missing.texture_uv.data.assign(N, vec2(0,0));
+
+    upload(*this, N, file.position,
+           file.normal!=nullptr? file.normal : &missing.normal[0],
+           file.color!=nullptr? file.color : &missing.color[0],
+           file.texture_uv!=nullptr? file.texture_uv : &missing.texture_uv[0],
+           file.triangle_count(), file.connectivity);
+    bounds = file.bounds();
 }
 
 void mesh_drawable_gpu_data::clear()
@@ -86,14 +122,33 @@ void mesh_drawable_gpu_data::clear()
     glDeleteBuffers(1,&vbo_color);
     glDeleteBuffers(1,&vbo_texture_uv);
     glDeleteBuffers(1,&vbo_index);
+    // The id may be reused by a new VAO: don't let the cache consider it as bound
+    if(vao!=0 && gl_state().vertex_array()==vao)
+        gl_state().bind_vertex_array(0);
+    glDeleteVertexArrays(1,&vao);
+
+    vao = 0;
+    number_triangles = 0;
+    vbo_index = 0;
+    vbo_position = 0;
+    vbo_normal = 0;
+    vbo_color = 0;
+    vbo_texture_uv = 0;
+    bounds = bounding_volume();
 }
 
 void mesh_drawable_gpu_data::update_position(const buffer<vec3>& new_position)
+{
+    update_position(new_position, compute_bounding_volume(new_position));
+}
+
+void mesh_drawable_gpu_data::update_position(const buffer<vec3>& new_position, const bounding_volume& new_bounds)
 {
     glBindBuffer(GL_ARRAY_BUFFER,vbo_position);
     assert(glIsBuffer(vbo_position));
 
     glBufferSubData(GL_ARRAY_BUFFER,0,GLsizeiptr(new_position.size()*sizeof(float)*3),&new_position[0]);
+    bounds = new_bounds;
 }
 
 void mesh_drawable_gpu_data::update_normal(const buffer<vec3>& new_normal)
@@ -117,10 +172,20 @@ void draw(const mesh_drawable_gpu_data& gpu_data )
     assert(glIsVertexArray(gpu_data.vao));
     assert(glIsBuffer(gpu_data.vbo_index));
 
-    glBindVertexArray(gpu_data.vao); opengl_debug();
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu_data.vbo_index); opengl_debug();
+    gl_state().bind_vertex_array(gpu_data.vao); opengl_debug();
     glDrawElements(GL_TRIANGLES, GLsizei(gpu_data.number_triangles*3), GL_UNSIGNED_INT, nullptr); opengl_debug();
-    glBindVertexArray(0);
+    gl_state().count_draw(gpu_data.number_triangles);
+}
+
+void draw(const mesh_drawable_gpu_data& gpu_data, unsigned int number_instances)
+{
+    if(gpu_data.number_triangles==0 || number_instances==0)
+        return ;
+    assert(glIsVertexArray(gpu_data.vao));
+
+    gl_state().bind_vertex_array(gpu_data.vao); opengl_debug();
+    glDrawElementsInstanced(GL_TRIANGLES, GLsizei(gpu_data.number_triangles*3), GL_UNSIGNED_INT, nullptr, GLsizei(number_instances)); opengl_debug();
+    gl_state().count_draw(gpu_data.number_triangles*number_instances);
 }
 
 
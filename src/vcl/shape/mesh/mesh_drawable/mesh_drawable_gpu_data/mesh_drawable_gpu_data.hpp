@@ -3,6 +3,8 @@
 
 #include "vcl/wrapper/glad/glad.hpp"
 #include "../../mesh_structure/mesh.hpp"
+#include "../../mesh_loader/mesh_binary/mesh_binary.hpp"
+#include "vcl/shape/culling/culling.hpp"
 
 
 namespace vcl
@@ -12,13 +14,17 @@ struct mesh_drawable_gpu_data {
 
     mesh_drawable_gpu_data();
     mesh_drawable_gpu_data(const mesh& mesh_cpu);
+    /** Upload the streams of a mapped binary mesh file without intermediate copy (missing attributes are filled with default values) */
+    mesh_drawable_gpu_data(const mesh_binary_file& file);
 
-    /** Clear buffers */
+    /** Clear buffers (VBO and VAO) and reset the ids to 0 */
     void clear();
 
-    /** Dynamically update the VBO with the new vector of position
+    /** Dynamically update the VBO with the new vector of position (the bounding volume is updated as well)
      * Warning: new_position is expected to have the same size (or less) than the initialized one */
     void update_position(const buffer<vec3>& new_position);
+    /** Same update with the bounding volume of new_position given by the caller (no pass over the positions, ex. for a mesh updated at every frame) */
+    void update_position(const buffer<vec3>& new_position, const bounding_volume& new_bounds);
 
     /** Dynamically update the VBO with the new vector of normal
      * Warning: new_normal is expected to have the same size (or less) than the initialized one */
@@ -34,9 +40,13 @@ struct mesh_drawable_gpu_data {
     GLuint vbo_normal;     // (nx,ny,nz) normals coordinates (unit length)
     GLuint vbo_color;      // (r,g,b) values
     GLuint vbo_texture_uv; // (u,v) texture coordinates
+
+    bounding_volume bounds; // Bounding volume of the positions (local coordinates), computed at upload
 };
 
 /** Call raw OpenGL draw */
 void draw(const mesh_drawable_gpu_data& gpu_data);
+/** Call raw OpenGL instanced draw (the per-instance attributes are expected to be attached to the VAO) */
+void draw(const mesh_drawable_gpu_data& gpu_data, unsigned int number_instances);
 
 }
@@ -9,7 +9,7 @@ shading_mesh::shading_mesh(float ambiant_arg, float diffuse_arg, float specular_
 {}
 
 mesh_drawable_uniform::mesh_drawable_uniform()
-    :transform(), color({1,1,1}), shading(), color_alpha(1.0f)
+    :transform(), color({1,1,1}), shading(), color_alpha(1.0f), texture_layer(0.0f)
 {}
 
 
@@ -24,6 +24,7 @@ struct mesh_drawable_uniform {
     vec3 color;
     shading_mesh shading;
     float color_alpha;
+    float texture_layer; // Layer sampled by the texture array shaders
 
 };
 
@@ -0,0 +1,289 @@
+#include "mesh_binary.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+namespace vcl
+{
+
+static const char mesh_binary_magic[8] = {'V','C','L','M','E','S','H','\0'};
+static const uint32_t mesh_binary_version = 2;
+static const size_t mesh_binary_alignment = 16;
+
+static_assert(sizeof(mesh_binary_header)%mesh_binary_alignment==0, "The first stream must be aligned after the header");
+
+// Hash of the payload by 64 bits words (the bytes are accumulated until a word is complete)
+struct payload_checksum
+{
+    payload_checksum() :hash(0xcbf29ce484222325ull),word(0),word_size(0) {}
+
+    void update(const char* bytes, size_t size)
+    {
+        size_t k = 0;
+        while(word_size>0 && k<size)
+            push_byte(bytes[k++]);
+        for(; k+8<=size; k+=8) {
+            uint64_t w;
+            std::memcpy(&w, bytes+k, 8);
+            hash = (hash ^ w) * 0x100000001b3ull;
+        }
+        while(k<size)
+            push_byte(bytes[k++]);
+    }
+
+    uint64_t value() const
+    {
+        return word_size==0? hash : (hash ^ word) * 0x100000001b3ull;
+    }
+
+    uint64_t hash;
+private:
+    void push_byte(char c)
+    {
+        word |= uint64_t(static_cast<unsigned char>(c)) << (8*word_size);
+        if(++word_size==8) {
+            hash = (hash ^ word) * 0x100000001b3ull;
+            word = 0;
+            word_size = 0;
+        }
+    }
+    uint64_t word;
+    size_t word_size;
+};
+
+static uint64_t aligned(uint64_t offset)
+{
+    return (offset + mesh_binary_alignment - 1) & ~uint64_t(mesh_binary_alignment - 1);
+}
+
+
+bool mesh_save_file_binary(const std::string& filename, const mesh& m, const buffer<buffer<int>>& vertex_correspondance, const file_stamp& source, uint32_t source_version)
+{
+    const size_t N = m.position.size();
+    assert_vcl(m.normal.size()==0 || m.normal.size()==N, "Incoherent number of normals ("+str(m.normal.size())+") and positions ("+str(N)+")");
+    assert_vcl(m.color.size()==0 || m.color.size()==N, "Incoherent number of colors ("+str(m.color.size())+") and positions ("+str(N)+")");
+    assert_vcl(m.texture_uv.size()==0 || m.texture_uv.size()==N, "Incoherent number of texture uv ("+str(m.texture_uv.size())+") and positions ("+str(N)+")");
+
+    // Vertex correspondance in compressed rows
+    std::vector<uint32_t> correspondance_offset;
+    std::vector<int32_t> correspondance_vertex;
+    if(vertex_correspondance.size()>0) {
+        correspondance_offset.push_back(0);
+        for(const buffer<int>& vertices : vertex_correspondance) {
+            for(int v : vertices)
+                correspondance_vertex.push_back(v);
+            correspondance_offset.push_back(uint32_t(correspondance_vertex.size()));
+        }
+    }
+
+    const void* stream_data[mesh_binary_stream_count] = {
+        m.position.data.data(), m.normal.data.data(), m.color.data.data(), m.texture_uv.data.data(), m.connectivity.data.data(),
+        correspondance_offset.data(), correspondance_vertex.data() };
+    const size_t stream_size[mesh_binary_stream_count] = {
+        m.position.size()*sizeof(vec3), m.normal.size()*sizeof(vec3), m.color.size()*sizeof(vec4), m.texture_uv.size()*sizeof(vec2),
+        m.connectivity.size()*sizeof(uint3), correspondance_offset.size()*sizeof(uint32_t), correspondance_vertex.size()*sizeof(int32_t) };
+
+    mesh_binary_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, mesh_binary_magic, sizeof(mesh_binary_magic));
+    header.version = mesh_binary_version;
+    header.vertex_count = N;
+    header.triangle_count = m.connectivity.size();
+    header.source_vertex_count = vertex_correspondance.size();
+    header.correspondance_count = correspondance_vertex.size();
+    header.source = source;
+    header.source_version = source_version;
+
+    const bounding_volume bounds = compute_bounding_volume(m.position);
+    for(size_t i=0; i<3; ++i) {
+        header.bounds_center[i] = bounds.center[i];
+        header.bounds_half_extent[i] = bounds.half_extent[i];
+    }
+
+    uint64_t offset = sizeof(mesh_binary_header);
+    for(size_t k=0; k<mesh_binary_stream_count; ++k) {
+        if(stream_size[k]==0)
+            continue;
+        header.streams |= 1u << k;
+        header.offset[k] = offset;
+        offset = aligned(offset + stream_size[k]);
+    }
+    header.payload_size = offset - sizeof(mesh_binary_header);
+
+    // Checksum of the streams and of the padding (zeros)
+    static const char padding[mesh_binary_alignment] = {};
+    payload_checksum checksum;
+    for(size_t k=0; k<mesh_binary_stream_count; ++k) {
+        if(stream_size[k]==0)
+            continue;
+        checksum.update(static_cast<const char*>(stream_data[k]), stream_size[k]);
+        checksum.update(padding, size_t(aligned(stream_size[k])-stream_size[k]));
+    }
+    header.checksum = checksum.value();
+
+    // Temporary name specific to the thread: the same file can be cached by several loading tasks
+    const std::string temporary = filename+".tmp"+std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream stream(temporary, std::ios::binary);
+        if(!stream.is_open())
+            return false;
+        stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for(size_t k=0; k<mesh_binary_stream_count; ++k) {
+            if(stream_size[k]==0)
+                continue;
+            stream.write(static_cast<const char*>(stream_data[k]), std::streamsize(stream_size[k]));
+            stream.write(padding, std::streamsize(aligned(stream_size[k])-stream_size[k]));
+        }
+        if(!stream.good()) {
+            stream.close();
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+
+    // rename doesn't replace an existing file on Windows
+    std::remove(filename.c_str());
+    if(std::rename(temporary.c_str(), filename.c_str())!=0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+mesh_binary_file::mesh_binary_file()
+    :header(nullptr),position(nullptr),normal(nullptr),color(nullptr),texture_uv(nullptr),connectivity(nullptr),
+      correspondance_offset(nullptr),correspondance_vertex(nullptr),file()
+{}
+
+bool mesh_binary_file::open(const std::string& filename, bool verify_checksum)
+{
+    close();
+    if(!file.open(filename) || file.size()<sizeof(mesh_binary_header)) {
+        close();
+        return false;
+    }
+
+    const char* data = file.data();
+    const mesh_binary_header* h = reinterpret_cast<const mesh_binary_header*>(data);
+    if(std::memcmp(h->magic, mesh_binary_magic, sizeof(mesh_binary_magic))!=0 || h->version!=mesh_binary_version
+            || h->payload_size!=file.size()-sizeof(mesh_binary_header)) {
+        close();
+        return false;
+    }
+
+    // Each stored stream must lie in the file
+    const uint64_t element_count[mesh_binary_stream_count] = {
+        h->vertex_count, h->vertex_count, h->vertex_count, h->vertex_count, h->triangle_count,
+        h->source_vertex_count+1, h->correspondance_count };
+    const uint64_t element_size[mesh_binary_stream_count] = {
+        sizeof(vec3), sizeof(vec3), sizeof(vec4), sizeof(vec2), sizeof(uint3), sizeof(uint32_t), sizeof(int32_t) };
+    const void* stream[mesh_binary_stream_count] = {};
+    for(size_t k=0; k<mesh_binary_stream_count; ++k)
+    {
+        if((h->streams & (1u << k))==0)
+            continue;
+        const uint64_t begin = h->offset[k];
+        if(begin<sizeof(mesh_binary_header) || begin>file.size() || begin%mesh_binary_alignment!=0 || element_count[k] > (file.size()-begin)/element_size[k]) {
+            close();
+            return false;
+        }
+        stream[k] = data+begin;
+    }
+    if(stream[mesh_binary_position]==nullptr || stream[mesh_binary_connectivity]==nullptr) {
+        close();
+        return false;
+    }
+
+    if(verify_checksum) {
+        payload_checksum checksum;
+        checksum.update(data+sizeof(mesh_binary_header), size_t(h->payload_size));
+        if(checksum.value()!=h->checksum) {
+            close();
+            return false;
+        }
+    }
+
+    // Pointers to the streams in the mapped file
+    header = h;
+    position = static_cast<const vec3*>(stream[mesh_binary_position]);
+    normal = static_cast<const vec3*>(stream[mesh_binary_normal]);
+    color = static_cast<const vec4*>(stream[mesh_binary_color]);
+    texture_uv = static_cast<const vec2*>(stream[mesh_binary_texture_uv]);
+    connectivity = static_cast<const uint3*>(stream[mesh_binary_connectivity]);
+    correspondance_offset = static_cast<const uint32_t*>(stream[mesh_binary_correspondance_offset]);
+    correspondance_vertex = static_cast<const int32_t*>(stream[mesh_binary_correspondance_vertex]);
+    return true;
+}
+
+void mesh_binary_file::close()
+{
+    file.close();
+    header = nullptr;
+    position = nullptr;
+    normal = nullptr;
+    color = nullptr;
+    texture_uv = nullptr;
+    connectivity = nullptr;
+    correspondance_offset = nullptr;
+    correspondance_vertex = nullptr;
+}
+
+bool mesh_binary_file::is_open() const
+{
+    return header!=nullptr;
+}
+
+size_t mesh_binary_file::vertex_count() const
+{
+    return header!=nullptr? size_t(header->vertex_count) : 0;
+}
+
+size_t mesh_binary_file::triangle_count() const
+{
+    return header!=nullptr? size_t(header->triangle_count) : 0;
+}
+
+bounding_volume mesh_binary_file::bounds() const
+{
+    if(header==nullptr)
+        return bounding_volume();
+    const float* c = header->bounds_center;
+    const float* h = header->bounds_half_extent;
+    return bounding_volume({c[0],c[1],c[2]}, {h[0],h[1],h[2]});
+}
+
+mesh mesh_binary_file::to_mesh() const
+{
+    mesh m;
+    const size_t N = vertex_count();
+    if(position!=nullptr)     m.position.data.assign(position, position+N);
+    if(normal!=nullptr)       m.normal.data.assign(normal, normal+N);
+    if(color!=nullptr)        m.color.data.assign(color, color+N);
+    if(texture_uv!=nullptr)   m.texture_uv.data.assign(texture_uv, texture_uv+N);
+    if(connectivity!=nullptr) m.connectivity.data.assign(connectivity, connectivity+triangle_count());
+    return m;
+}
+
+buffer<buffer<int>> mesh_binary_file::vertex_correspondance() const
+{
+    buffer<buffer<int>> correspondance;
+    if(correspondance_offset==nullptr)
+        return correspondance;
+
+    const size_t N = size_t(header->source_vertex_count);
+    correspondance.resize(N);
+    for(size_t k=0; k<N; ++k) {
+        const uint32_t begin = correspondance_offset[k];
+        const uint32_t end = correspondance_offset[k+1];
+        assert_vcl_no_msg(begin<=end && end<=header->correspondance_count);
+        if(correspondance_vertex!=nullptr)
+            correspondance[k].data.assign(correspondance_vertex+begin, correspondance_vertex+end);
+    }
+    return correspondance;
+}
+
+}
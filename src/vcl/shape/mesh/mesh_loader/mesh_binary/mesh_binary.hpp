@@ -0,0 +1,90 @@
+#pragma once
+
+#include "../../mesh_structure/mesh.hpp"
+#include "vcl/shape/culling/culling.hpp"
+
+#include <cstdint>
+
+namespace vcl
+{
+
+/** Streams of a binary mesh file */
+enum mesh_binary_stream
+{
+    mesh_binary_position,              // vec3 per vertex
+    mesh_binary_normal,                // vec3 per vertex
+    mesh_binary_color,                 // vec4 per vertex
+    mesh_binary_texture_uv,            // vec2 per vertex
+    mesh_binary_connectivity,          // uint3 per triangle
+    mesh_binary_correspondance_offset, // uint32 per source vertex + 1
+    mesh_binary_correspondance_vertex, // int32 per entry of the vertex correspondance
+    mesh_binary_stream_count
+};
+
+/** Header at the beginning of a binary mesh file.
+ *  The streams follow the header, each one starting on a 16 bytes boundary: they are used in place once the file is mapped.
+ *  The checksum covers all the bytes after the header. Values are stored with the byte order of the machine that wrote the file. */
+struct mesh_binary_header
+{
+    char magic[8];                  // "VCLMESH" followed by '\0'
+    uint32_t version;
+    uint32_t streams;               // Bit k set if the stream k is stored
+    uint32_t source_version;        // Version of the code that produced the mesh from the source file (ex. the OBJ parser)
+    uint32_t reserved[3];
+    uint64_t vertex_count;
+    uint64_t triangle_count;
+    uint64_t source_vertex_count;   // Vertices of the source file (size of the vertex correspondance)
+    uint64_t correspondance_count;  // Total number of entries of the vertex correspondance
+    file_stamp source;              // Stamp of the source file (zero if none)
+    float bounds_center[3];
+    float bounds_half_extent[3];
+    uint64_t offset[mesh_binary_stream_count]; // Byte offset of each stream from the beginning of the file (0 if not stored)
+    uint64_t payload_size;          // Bytes after the header
+    uint64_t checksum;
+};
+
+/** Write a mesh in a binary file. Empty per-vertex attributes are not stored.
+ *  vertex_correspondance (vertices of a source file -> vertices of the mesh, see mesh_load_file_obj), the stamp of the source file
+ *  and the version of the code that converted it are optional.
+ *  The file is written under a temporary name specific to the thread then renamed: a partially written file is never read,
+ *  even when several threads write the same file. Return false if it cannot be written. */
+bool mesh_save_file_binary(const std::string& filename, const mesh& m,
+                           const buffer<buffer<int>>& vertex_correspondance = buffer<buffer<int>>(),
+                           const file_stamp& source = file_stamp{0,0}, uint32_t source_version = 0);
+
+/** Binary mesh file mapped in memory.
+ *  The stream pointers refer directly to the mapped file (nullptr for a stream that is not stored), they are valid until close().
+ *  Usage: open(filename) then to_mesh() for a CPU copy, or mesh_drawable_gpu_data(file) to upload the streams without intermediate copy. */
+struct mesh_binary_file
+{
+    mesh_binary_file();
+
+    /** Map the file and set the stream pointers.
+     *  Return false (and leave the object closed) if the file is missing, truncated, from another version or if its checksum doesn't match. */
+    bool open(const std::string& filename, bool verify_checksum=true);
+    void close();
+    bool is_open() const;
+
+    size_t vertex_count() const;
+    size_t triangle_count() const;
+    bounding_volume bounds() const;
+
+    /** Copy of the streams in a mesh */
+    mesh to_mesh() const;
+    /** Copy of the stored vertex correspondance (empty if none) */
+    buffer<buffer<int>> vertex_correspondance() const;
+
+    const mesh_binary_header* header;
+    const vec3* position;
+    const vec3* normal;
+    const vec4* color;
+    const vec2* texture_uv;
+    const uint3* connectivity;
+    const uint32_t* correspondance_offset;
+    const int32_t* correspondance_vertex;
+
+private:
+    file_mapping file;
+};
+
+}
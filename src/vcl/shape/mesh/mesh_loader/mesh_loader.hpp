@@ -1,3 +1,4 @@
 #pragma once
 
 #include "obj/obj.hpp"
+#include "mesh_binary/mesh_binary.hpp"
@@ -3,10 +3,13 @@
 #endif 
 
 #include "obj.hpp"
+#include "../mesh_binary/mesh_binary.hpp"
 
 #include "vcl/base/base.hpp"
 
-#include <map>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 
 #include <fstream>
 #include <sstream>
@@ -15,31 +18,35 @@ namespace vcl
 {
 
 
-// Comparator of triplet of integer for std::map
-struct comparator_int3 {
-    long int N; // number of vertices
+static mesh parse_file_obj(const std::string& filename, buffer<buffer<int> >& vertex_correspondance);
 
-    comparator_int3(int N_arg=0) :N(N_arg) {}
-
-    // compute a<b
-    bool operator()(int3 const& a, int3 const& b) const
-    {
-        long int const offset_a = long(a[0]) + N*(long(a[1]) + N*long(a[2]));
-        long int const offset_b = long(b[0]) + N*(long(b[1]) + N*long(b[2]));
-        return offset_a < offset_b;
-    }
-};
+static bool obj_cache_enabled = true;
 
+// Version of the parser stored in the caches: to be increased when the mesh produced from a file changes
+// 2: block-parallel parser (trailing comments, merged vertex keys and invalid indices are handled differently)
+static const uint32_t obj_parser_version = 2;
 
-static buffer<buffer_stack<int3,3>> triangulate_faces(buffer<buffer<int3>> faces);
+void mesh_obj_cache_enable(bool enabled)
+{
+    obj_cache_enabled = enabled;
+}
 
+std::string mesh_obj_cache_filename(const std::string& filename)
+{
+    return filename+".vclmesh";
+}
 
-static std::pair<mesh, std::map<int3, int, comparator_int3>>
-    make_unique_parameter_per_value(buffer<vec3> const& positions,
-                                    buffer<vec2> const& texture_uv,
-                                    buffer<vec3> const& normals,
-                                    buffer<buffer_stack<int3,3>> const& faces,
-                                    loader::obj_type const type);
+// Map the cache of the file if it has been written from the current version of the file by the current parser
+static bool open_obj_cache(const std::string& filename, const file_stamp& stamp, mesh_binary_file& cache)
+{
+    if(!cache.open(mesh_obj_cache_filename(filename)))
+        return false;
+    if(cache.header->source!=stamp || cache.header->source_version!=obj_parser_version) {
+        cache.close();
+        return false;
+    }
+    return true;
+}
 
 
 mesh mesh_load_file_obj(const std::string& filename)
@@ -50,118 +57,425 @@ mesh mesh_load_file_obj(const std::string& filename)
 }
 mesh mesh_load_file_obj(const std::string& filename, buffer<buffer<int> >& vertex_correspondance)
 {
+    VCL_TRACE_ZONE_DETAIL("mesh_load_file_obj", filename);
     assert_file_exist(filename);
 
-    // Load parameters
-    buffer<vec3> positions = loader::obj_read_positions(filename);
-    buffer<vec2> texture_uv = loader::obj_read_texture_uv(filename);
-    buffer<vec3> normals = loader::obj_read_normals(filename);
+    file_stamp stamp;
+    const bool use_cache = obj_cache_enabled && read_file_stamp(filename, stamp);
+    if(use_cache)
+    {
+        mesh_binary_file cache;
+        if(open_obj_cache(filename, stamp, cache)) {
+            vertex_correspondance = cache.vertex_correspondance();
+            return cache.to_mesh();
+        }
+    }
+
+    mesh m = parse_file_obj(filename, vertex_correspondance);
 
-    assert_vcl(positions.size()>0, str("File ")+filename+" has 0 vertices");
+    // The cache is optional (ex. read-only directory): a failure is ignored
+    if(use_cache)
+        mesh_save_file_binary(mesh_obj_cache_filename(filename), m, vertex_correspondance, stamp, obj_parser_version);
+    return m;
+}
+
+bool mesh_load_file_obj(const std::string& filename, mesh_binary_file& cache)
+{
+    VCL_TRACE_ZONE_DETAIL("mesh_load_file_obj", filename);
+    assert_file_exist(filename);
 
-    // set obj type
-    loader::obj_type type = loader::obj_type::vertex;
-    if(texture_uv.size()>0 && normals.size()>0)
-        type = loader::obj_type::vertex_texture_normal;
-    else if( texture_uv.size()>0 )
-        type = loader::obj_type::vertex_texture;
-    else if( normals.size()>0 )
-        type = loader::obj_type::vertex_normal;
+    file_stamp stamp;
+    if(!read_file_stamp(filename, stamp))
+        return false;
+    if(open_obj_cache(filename, stamp, cache))
+        return true;
+
+    buffer<buffer<int>> vertex_correspondance;
+    const mesh m = parse_file_obj(filename, vertex_correspondance);
+    if(!mesh_save_file_binary(mesh_obj_cache_filename(filename), m, vertex_correspondance, stamp, obj_parser_version))
+        return false;
+    return open_obj_cache(filename, stamp, cache);
+}
 
-    // Load connectivity and triangulate
-    buffer<buffer_stack<int3,3>> faces = triangulate_faces( loader::obj_read_faces(filename, type) );
 
-    // Set unique per-vertex value for texture and normals (duplicate vertices if necessary)
-    mesh m;
-    std::map<int3, int, comparator_int3> connectivity_map;
-    std::tie(m,connectivity_map) = make_unique_parameter_per_value(positions, texture_uv, normals, faces, type);
+// Parsing of the OBJ files
+//  The mapped file is split in blocks of whole lines parsed in parallel, the blocks are then concatenated in the order of the file.
+//  The vertices (triplets position/texture/normal indices) are then welded with a hash table in the order of their first use by a triangle.
 
-    // Retrieve correspondance between initial vertices in files and new ones
-    vertex_correspondance.resize(positions.size());
-    for(auto const& it : connectivity_map)
-    {
-        int const vertex_in = it.first[0];
-        int const vertex_out = it.second;
+namespace
+{
 
-        vertex_correspondance[vertex_in].push_back(vertex_out);
+// Elements read in a block of lines
+struct obj_block
+{
+    std::vector<vec3> position;
+    std::vector<vec2> texture_uv;
+    std::vector<vec3> normal;
+    std::vector<int3> corner;            // Indices (starting at 0) of position/texture/normal of the face vertices, -1 if not given
+    std::vector<unsigned int> face_size; // Number of corners of each face
+};
+
+// Size of the blocks parsed by one task
+const size_t obj_block_size = size_t(1)<<20;
+
+// Exact powers of ten in single precision
+const float obj_power_of_ten[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+}
+
+static bool obj_is_space(char c)
+{
+    return c==' ' || c=='\t' || c=='\r' || c=='\v' || c=='\f';
+}
+static bool obj_is_digit(char c)
+{
+    return c>='0' && c<='9';
+}
+static void obj_skip_space(const char*& it, const char* end)
+{
+    while(it<end && obj_is_space(*it))
+        ++it;
+}
+
+// Read a float after optional spaces (same value as strtof). Return false if there is no number.
+static bool obj_read_float(const char*& it, const char* end, float& value)
+{
+    obj_skip_space(it, end);
+    const char* const first = it;
+    const char* s = it;
+
+    const bool negative = s<end && *s=='-';
+    if(s<end && (*s=='-' || *s=='+'))
+        ++s;
+
+    // Significant digits of the mantissa, and power of ten applied to them
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool has_digit = false;
+    for(; s<end && obj_is_digit(*s); ++s) {
+        has_digit = true;
+        if(mantissa!=0 || *s!='0') {
+            if(digits<18) mantissa = 10*mantissa + uint64_t(*s-'0');
+            else ++exponent;
+            ++digits;
+        }
+    }
+    if(s<end && *s=='.') {
+        for(++s; s<end && obj_is_digit(*s); ++s) {
+            has_digit = true;
+            if(mantissa!=0 || *s!='0') {
+                if(digits<18) { mantissa = 10*mantissa + uint64_t(*s-'0'); --exponent; }
+                ++digits;
+            }
+            else
+                --exponent;
+        }
+    }
+    if(!has_digit)
+        return false;
+
+    if(s<end && (*s=='e' || *s=='E')) {
+        const char* e = s+1;
+        const bool negative_exponent = e<end && *e=='-';
+        if(e<end && (*e=='-' || *e=='+'))
+            ++e;
+        if(e<end && obj_is_digit(*e)) {
+            int value_exponent = 0;
+            for(; e<end && obj_is_digit(*e); ++e)
+                value_exponent = std::min(10*value_exponent + (*e-'0'), 100000);
+            exponent += negative_exponent? -value_exponent : value_exponent;
+            s = e;
+        }
     }
+    it = s;
 
-    return m;
+    // Exact mantissa and power of ten: a single rounded operation gives the correctly rounded value
+    if(mantissa==0) {
+        value = negative? -0.0f : 0.0f;
+        return true;
+    }
+    if(mantissa<=(uint64_t(1)<<24) && exponent>=-10 && exponent<=10) {
+        const float m = float(mantissa);
+        value = exponent<0? m/obj_power_of_ten[-exponent] : m*obj_power_of_ten[exponent];
+        if(negative)
+            value = -value;
+        return true;
+    }
+
+    // Other cases (long mantissa, large exponent)
+    const std::string number(first, s);
+    value = std::strtof(number.c_str(), nullptr);
+    return true;
+}
+
+// Read an integer (no spaces are skipped). Return false if there is no integer.
+static bool obj_read_int(const char*& it, const char* end, int& value)
+{
+    const char* s = it;
+    const bool negative = s<end && *s=='-';
+    if(s<end && (*s=='-' || *s=='+'))
+        ++s;
+    if(s==end || !obj_is_digit(*s))
+        return false;
+    long long v = 0;
+    for(; s<end && obj_is_digit(*s); ++s)
+        v = std::min(10*v + (*s-'0'), 1ll<<32);
+    value = int(std::max(std::min(negative? -v : v, 1ll<<30), -(1ll<<30)));
+    it = s;
+    return true;
 }
 
+// Read the n coordinates of a vertex (values after an invalid coordinate are kept to 0, as with a std::istream)
+template <typename VEC>
+static VEC obj_read_vec(const char* it, const char* end, size_t N)
+{
+    VEC v;
+    for(size_t k=0; k<N && obj_read_float(it, end, v[k]); ++k) {}
+    return v;
+}
 
-buffer<buffer_stack<int3,3>> triangulate_faces(buffer<buffer<int3>> faces)
+// Read the corners %d[/[%d][/%d]] of a face
+static void obj_read_face(const char* it, const char* end, obj_block& block)
 {
-    buffer<buffer_stack<int3,3>> faces_triangulation;
-    size_t const N_face = faces.size();
-    for(size_t k_face=0; k_face<N_face; ++k_face)
+    unsigned int N = 0;
+    while(true)
     {
-        buffer<int3> const& current_polygon = faces[k_face];
-        int const N_polygon = int(current_polygon.size());
+        obj_skip_space(it, end);
+        if(it==end || *it=='#')
+            break;
+
+        int3 corner = {0,0,0};
+        obj_read_int(it, end, corner[0]);
+        if(it<end && *it=='/') {
+            ++it;
+            obj_read_int(it, end, corner[1]);
+            if(it<end && *it=='/') {
+                ++it;
+                obj_read_int(it, end, corner[2]);
+            }
+        }
+        for(int k=0; k<3; ++k)
+            corner[k]--;    // obj indices starts at 1
+
+        // End of the word
+        while(it<end && !obj_is_space(*it))
+            ++it;
 
-        for(int k=0; k<N_polygon-2; ++k) {
-            // triangulation
-            int3 const& f0 = current_polygon[0];
-            int3 const& f1 = current_polygon[k+1];
-            int3 const& f2 = current_polygon[k+2];
+        block.corner.push_back(corner);
+        ++N;
+    }
+    block.face_size.push_back(N);
+}
 
-            faces_triangulation.push_back({f0,f1,f2});
+static void obj_parse_block(const char* it, const char* end, obj_block& block)
+{
+    while(it<end)
+    {
+        const char* line_end = static_cast<const char*>(std::memchr(it, '\n', size_t(end-it)));
+        if(line_end==nullptr)
+            line_end = end;
+
+        // First word of the line
+        obj_skip_space(it, line_end);
+        const char* word = it;
+        while(it<line_end && !obj_is_space(*it))
+            ++it;
+        const size_t word_size = size_t(it-word);
+
+        if(word_size==1 && word[0]=='v')
+            block.position.push_back(obj_read_vec<vec3>(it, line_end, 3));
+        else if(word_size==2 && word[0]=='v' && word[1]=='t') {
+            const vec2 uv = obj_read_vec<vec2>(it, line_end, 2);
+            block.texture_uv.push_back({uv.x, 1.0f-uv.y});
         }
+        else if(word_size==2 && word[0]=='v' && word[1]=='n')
+            block.normal.push_back(obj_read_vec<vec3>(it, line_end, 3));
+        else if(word_size==1 && word[0]=='f')
+            obj_read_face(it, line_end, block);
+
+        it = line_end<end? line_end+1 : end;
     }
-    return faces_triangulation;
 }
 
-std::pair<mesh, std::map<int3, int, comparator_int3>>
-    make_unique_parameter_per_value(buffer<vec3> const& positions,
-                                    buffer<vec2> const& texture_uv,
-                                    buffer<vec3> const& normals,
-                                    buffer<buffer_stack<int3,3>> const& faces,
-                                    loader::obj_type const type)
+template <typename T>
+static void obj_append(std::vector<T>& a, const std::vector<T>& b)
 {
-    mesh m;
-    comparator_int3 comparator(int(positions.size()));
-    std::map<int3, int, comparator_int3> connectivity_map(comparator); // stores map between original face index and final offset
+    a.insert(a.end(), b.begin(), b.end());
+}
 
+static uint32_t obj_hash(const int3& v)
+{
+    uint32_t h = uint32_t(v[0])*0x9E3779B1u ^ uint32_t(v[1])*0x85EBCA77u ^ uint32_t(v[2])*0xC2B2AE3Du;
+    h ^= h>>15;
+    h *= 0x2C1B3C6Du;
+    h ^= h>>16;
+    return h;
+}
 
-    size_t const N_triangle = faces.size();
-    for(size_t k_triangle=0; k_triangle<N_triangle; ++k_triangle)
+// Open addressing table of the welded vertices (value: index of the vertex)
+namespace
+{
+struct obj_vertex_table
+{
+    explicit obj_vertex_table(size_t expected_size)
+        :slot(),mask(0)
     {
-        buffer_stack<int3,3> const& tri = faces[k_triangle];
-        uint3 new_triangle_index;
-        for(int k=0; k<3; ++k)
-        {
-            int3 const& index = tri[k];
-            auto const it = connectivity_map.find( index );
-            if( it==connectivity_map.end() ) {
+        size_t N = 16;
+        while(N<2*expected_size)
+            N *= 2;
+        slot.assign(N, -1);
+        mask = N-1;
+    }
 
-                size_t const offset = m.position.size();
-                connectivity_map[index] = int(offset);
-                new_triangle_index[k] = int(offset);
+    // Index of the vertex v, added at the end of vertices if it is new
+    int insert(const int3& v, std::vector<int3>& vertices)
+    {
+        if(2*(vertices.size()+1)>slot.size())
+            grow(vertices);
+
+        size_t k = obj_hash(v) & mask;
+        while(slot[k]>=0) {
+            if(vertices[size_t(slot[k])]==v)
+                return slot[k];
+            k = (k+1) & mask;
+        }
+        slot[k] = int(vertices.size());
+        vertices.push_back(v);
+        return slot[k];
+    }
 
-                int const idx_position = index[0];
+private:
+    void grow(const std::vector<int3>& vertices)
+    {
+        slot.assign(2*slot.size(), -1);
+        mask = slot.size()-1;
+        for(size_t i=0; i<vertices.size(); ++i) {
+            size_t k = obj_hash(vertices[i]) & mask;
+            while(slot[k]>=0)
+                k = (k+1) & mask;
+            slot[k] = int(i);
+        }
+    }
 
-                assert_vcl_no_msg( idx_position<int(positions.size()));
-                m.position.push_back( positions[idx_position] );
+    std::vector<int> slot;
+    size_t mask;
+};
+}
 
-                if(type==loader::obj_type::vertex_texture_normal || type==loader::obj_type::vertex_texture) {
-                    int const idx_uv = index[1];
-                    assert_vcl_no_msg( idx_uv<int(texture_uv.size()) );
-                    m.texture_uv.push_back( texture_uv[ idx_uv ] );
-                }
-                if(type==loader::obj_type::vertex_texture_normal || type==loader::obj_type::vertex_normal) {
-                    int const idx_normal = index[2];
-                    assert_vcl_no_msg( idx_normal<int(normals.size()) );
-                    m.normal.push_back( normals[index[2]] );
-                }
 
+mesh parse_file_obj(const std::string& filename, buffer<buffer<int> >& vertex_correspondance)
+{
+    file_mapping file;
+    assert_vcl(file.open(filename), "Cannot open file "+str(filename));
+    const char* const data = file.data();
+    const size_t size = file.size();
+
+    // Parse blocks of whole lines in parallel
+    std::vector<const char*> block_begin;
+    for(size_t offset=0; offset<size; )
+    {
+        block_begin.push_back(data+offset);
+        offset = std::min(offset+obj_block_size, size);
+        const char* line_end = static_cast<const char*>(std::memchr(data+offset, '\n', size-offset));
+        offset = line_end==nullptr? size : size_t(line_end-data)+1;
+    }
+    block_begin.push_back(data+size);
+
+    std::vector<obj_block> blocks(block_begin.size()-1);
+    {
+        VCL_TRACE_ZONE("parse_file_obj/lines");
+        parallel_for(0, blocks.size(), 1, [&](size_t k_begin, size_t k_end){
+            for(size_t k=k_begin; k<k_end; ++k)
+                obj_parse_block(block_begin[k], block_begin[k+1], blocks[k]);
+        });
+    }
+
+    obj_block all;
+    if(blocks.size()==1)
+        std::swap(all, blocks[0]);
+    else {
+        for(const obj_block& block : blocks) {
+            obj_append(all.position, block.position);
+            obj_append(all.texture_uv, block.texture_uv);
+            obj_append(all.normal, block.normal);
+            obj_append(all.corner, block.corner);
+            obj_append(all.face_size, block.face_size);
+        }
+        blocks.clear();
+    }
+
+    const std::vector<vec3>& positions = all.position;
+    const std::vector<vec2>& texture_uv = all.texture_uv;
+    const std::vector<vec3>& normals = all.normal;
+    assert_vcl(positions.size()>0, str("File ")+filename+" has 0 vertices");
+
+    // Indices used by the faces (as with loader::obj_read_faces, the texture and normal indices are ignored if the file doesn't define them)
+    const bool has_texture = texture_uv.size()>0;
+    const bool has_normal = normals.size()>0;
+
+    VCL_TRACE_ZONE("parse_file_obj/weld");
+    mesh m;
+    std::vector<int3> vertices; // Indices position/texture/normal of each vertex of the mesh
+    obj_vertex_table table(positions.size());
+    std::vector<int> corner_vertex;
+    size_t k_corner = 0;
+    for(const unsigned int N : all.face_size)
+    {
+        // Polygons are triangulated as a fan around their first corner (faces with less than 3 corners are ignored)
+        if(N<3) {
+            k_corner += N;
+            continue;
+        }
+        corner_vertex.clear();
+        for(unsigned int k=0; k<N; ++k)
+        {
+            int3 index = all.corner[k_corner+k];
+            if(!has_texture) index[1] = -1;
+            if(!has_normal)  index[2] = -1;
+
+            const size_t vertex_count = vertices.size();
+            const int vertex = table.insert(index, vertices);
+            corner_vertex.push_back(vertex);
+            if(size_t(vertex)<vertex_count)
+                continue;
+
+            assert_vcl_no_msg( index[0]>=0 && index[0]<int(positions.size()) );
+            m.position.push_back( positions[size_t(index[0])] );
+            if(has_texture) {
+                assert_vcl_no_msg( index[1]>=0 && index[1]<int(texture_uv.size()) );
+                m.texture_uv.push_back( texture_uv[size_t(index[1])] );
+            }
+            if(has_normal) {
+                assert_vcl_no_msg( index[2]>=0 && index[2]<int(normals.size()) );
+                m.normal.push_back( normals[size_t(index[2])] );
             }
-            else
-                new_triangle_index[k] = it->second;
         }
-        m.connectivity.push_back(new_triangle_index);
+        for(size_t k=2; k<corner_vertex.size(); ++k)
+            m.connectivity.push_back({ unsigned(corner_vertex[0]), unsigned(corner_vertex[k-1]), unsigned(corner_vertex[k]) });
+        k_corner += N;
+    }
+
+    // Correspondance between initial vertices in files and new ones, sorted by (texture, normal) indices
+    const long long N_position = (long long)(positions.size());
+    vertex_correspondance.clear();
+    vertex_correspondance.resize(positions.size());
+    for(size_t k=0; k<vertices.size(); ++k)
+        vertex_correspondance[size_t(vertices[k][0])].push_back(int(k));
+    for(buffer<int>& duplicates : vertex_correspondance)
+    {
+        if(duplicates.size()<2)
+            continue;
+        std::sort(duplicates.data.begin(), duplicates.data.end(), [&](int a, int b){
+            const int3& va = vertices[size_t(a)];
+            const int3& vb = vertices[size_t(b)];
+            const long long offset_a = va[1] + N_position*va[2];
+            const long long offset_b = vb[1] + N_position*vb[2];
+            return offset_a<offset_b || (offset_a==offset_b && va[2]<vb[2]);
+        });
     }
 
-    return {m, connectivity_map};
+    return m;
 }
 
 
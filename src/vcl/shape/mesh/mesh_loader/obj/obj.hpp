@@ -5,9 +5,23 @@
 namespace vcl
 {
 
+struct mesh_binary_file;
+
+/** Load an OBJ file (polygons are triangulated, vertices with several texture coordinates or normals are duplicated).
+ *  vertex_correspondance[k] contains the vertices of the mesh created from the vertex k of the file.
+ *  The result is stored in a binary cache next to the file (filename.vclmesh), reused as long as the size and modification time of the OBJ file (and the version of the parser) are unchanged. */
 mesh mesh_load_file_obj(const std::string& filename);
 mesh mesh_load_file_obj(const std::string& filename, buffer<buffer<int>>& vertex_correspondance);
 
+/** Map the binary cache of an OBJ file (the OBJ file is parsed and the cache written first if needed).
+ *  The streams can then be sent directly to the GPU with mesh_drawable_gpu_data(cache). Return false if the cache cannot be written. */
+bool mesh_load_file_obj(const std::string& filename, mesh_binary_file& cache);
+
+/** Enable/disable the binary cache of the OBJ files (enabled by default) */
+void mesh_obj_cache_enable(bool enabled);
+/** Name of the binary cache of an OBJ file */
+std::string mesh_obj_cache_filename(const std::string& filename);
+
 
 namespace loader{
 
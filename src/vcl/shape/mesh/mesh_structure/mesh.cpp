@@ -1,6 +1,9 @@
 #include "mesh.hpp"
 
 #include "vcl/math/math.hpp"
+#include "vcl/base/parallel/parallel.hpp"
+
+#include <algorithm>
 
 namespace vcl
 {
@@ -63,46 +66,110 @@ void mesh::fill_empty_fields()
 
 void normal(const buffer<vec3>& position, const buffer<uint3>& connectivity, buffer<vec3>& normals,bool invert)
 {
+    const vertex_triangle_adjacency adjacency = compute_vertex_triangle_adjacency(position.size(), connectivity);
+    normal(position, connectivity, adjacency, normals, invert);
+}
 
-    const size_t N = position.size();
-    if(normals.size() != N)
-        normals.resize(N);
-    else
-    {
-        for(size_t k=0; k<N; ++k)
-            normals[k] = vec3(0,0,0);
-    }
-
+vertex_triangle_adjacency compute_vertex_triangle_adjacency(size_t N_vertex, const buffer<uint3>& connectivity)
+{
     const size_t N_tri = connectivity.size();
-    for(size_t k_tri=0; k_tri<N_tri; ++k_tri)
-    {
-        const uint3& f = connectivity[k_tri];
-        assert_vcl_no_msg(f[0]<N);
-        assert_vcl_no_msg(f[1]<N);
-        assert_vcl_no_msg(f[2]<N);
 
-        const vec3& p0 = position[f[0]];
-        const vec3& p1 = position[f[1]];
-        const vec3& p2 = position[f[2]];
+    vertex_triangle_adjacency adjacency;
+    adjacency.offset.resize(N_vertex+1);
+    adjacency.triangle.resize(3*N_tri);
 
-        // Compute normal of the triangle
-        const vec3& p10 = normalize(p1-p0);
-        const vec3& p20 = normalize(p2-p0);
-        const vec3& n = normalize( cross(p10,p20) );
+    // Count the triangles incident to each vertex
+    for(size_t k_tri=0; k_tri<N_tri; ++k_tri) {
+        const uint3& f = connectivity[k_tri];
+        for(size_t k=0; k<3; ++k) {
+            assert_vcl_no_msg(f[k]<N_vertex);
+            adjacency.offset[f[k]+1]++;
+        }
+    }
+    for(size_t k=0; k<N_vertex; ++k)
+        adjacency.offset[k+1] += adjacency.offset[k];
 
-        // Add normal direction to all vertices of this triangle
+    // Store the incident triangles (in increasing order as triangles are visited in order)
+    buffer<unsigned int> fill = adjacency.offset;
+    for(size_t k_tri=0; k_tri<N_tri; ++k_tri) {
+        const uint3& f = connectivity[k_tri];
         for(size_t k=0; k<3; ++k)
-            normals[f[k]] += n;
+            adjacency.triangle[fill[f[k]]++] = static_cast<unsigned int>(k_tri);
     }
 
-    // Normalize all normals
-    for(size_t k=0; k<N; ++k)
-        normals[k] = normalize(normals[k]);
+    return adjacency;
+}
 
-    if(invert)
-        for(size_t k=0; k<N; ++k)
-            normals[k] = -normals[k];
+void normal(const buffer<vec3>& position, const buffer<uint3>& connectivity, const vertex_triangle_adjacency& adjacency, buffer<vec3>& normals, bool invert)
+{
+    const size_t N = position.size();
+    assert_vcl(adjacency.offset.size()==N+1, "Adjacency doesn't match the number of vertices");
+    if(normals.size() != N)
+        normals.resize(N);
 
+    // Compute the normal of each triangle
+    const size_t N_tri = connectivity.size();
+    buffer<vec3> triangle_normal(N_tri);
+    parallel_for(0, N_tri, 4096, [&](size_t k_begin, size_t k_end)
+    {
+        for(size_t k_tri=k_begin; k_tri<k_end; ++k_tri)
+        {
+            const uint3& f = connectivity[k_tri];
+            assert_vcl_no_msg(f[0]<N);
+            assert_vcl_no_msg(f[1]<N);
+            assert_vcl_no_msg(f[2]<N);
+
+            const vec3& p0 = position[f[0]];
+            const vec3& p1 = position[f[1]];
+            const vec3& p2 = position[f[2]];
+
+            const vec3& p10 = normalize(p1-p0);
+            const vec3& p20 = normalize(p2-p0);
+            triangle_normal[k_tri] = normalize( cross(p10,p20) );
+        }
+    });
+
+    // Each vertex sums the normals of its incident triangles, then normalizes the result
+    //  Triangles are summed by increasing index: the result doesn't depend on the number of threads
+    const float sign = invert? -1.0f : 1.0f;
+    parallel_for(0, N, 4096, [&](size_t k_begin, size_t k_end)
+    {
+        for(size_t k=k_begin; k<k_end; ++k)
+        {
+            vec3 n = {0,0,0};
+            const unsigned int end = adjacency.offset[k+1];
+            for(unsigned int i=adjacency.offset[k]; i<end; ++i)
+                n += triangle_normal[adjacency.triangle[i]];
+            normals[k] = sign*normalize(n);
+        }
+    });
+}
+
+void normal_grid(const buffer<vec3>& position, size_t Nu, size_t Nv, buffer<vec3>& normals, bool invert)
+{
+    assert_vcl(position.size()==Nu*Nv, "Grid size doesn't match the number of vertices");
+    assert_vcl(Nu>=2 && Nv>=2, "Grid should have at least 2x2 vertices");
+    if(normals.size() != Nu*Nv)
+        normals.resize(Nu*Nv);
+
+    const float sign = invert? -1.0f : 1.0f;
+    parallel_for(0, Nu, std::max<size_t>(1,4096/Nv), [&](size_t ku_begin, size_t ku_end)
+    {
+        for(size_t ku=ku_begin; ku<ku_end; ++ku)
+        {
+            const size_t ku0 = ku>0? ku-1 : ku;
+            const size_t ku1 = ku<Nu-1? ku+1 : ku;
+            for(size_t kv=0; kv<Nv; ++kv)
+            {
+                const size_t kv0 = kv>0? kv-1 : kv;
+                const size_t kv1 = kv<Nv-1? kv+1 : kv;
+
+                const vec3 dpdu = position[kv+Nv*ku1] - position[kv+Nv*ku0];
+                const vec3 dpdv = position[kv1+Nv*ku] - position[kv0+Nv*ku];
+                normals[kv+Nv*ku] = sign*normalize(cross(dpdu,dpdv));
+            }
+        }
+    });
 }
 
 buffer<vec3> normal(const buffer<vec3>& position, const buffer<uint3>& connectivity)
@@ -49,6 +49,30 @@ buffer<vec3> normal(const buffer<vec3>& position, const buffer<uint3>& connectiv
 void normal(const buffer<vec3>& position, const buffer<uint3>& connectivity, buffer<vec3>& normals, bool invert=false);
 
 
+/** Vertex to triangle adjacency stored in compressed rows (CSR).
+ *  The triangles incident to the vertex k are triangle[offset[k]] ... triangle[offset[k+1]-1], sorted by increasing index.
+ *  It only depends on the connectivity: it can be computed once and reused as long as the topology doesn't change. */
+struct vertex_triangle_adjacency
+{
+    buffer<unsigned int> offset;   // size: number of vertices + 1
+    buffer<unsigned int> triangle; // size: 3 x number of triangles
+};
+
+/** Compute the vertex to triangle adjacency of a mesh with N_vertex vertices */
+vertex_triangle_adjacency compute_vertex_triangle_adjacency(size_t N_vertex, const buffer<uint3>& connectivity);
+
+/** Compute per-vertex normals using a precomputed adjacency.
+ *  Each vertex gathers the normals of its incident triangles: vertices are processed independently and in parallel.
+ *  The result is identical to normal(position, connectivity, normals, invert). */
+void normal(const buffer<vec3>& position, const buffer<uint3>& connectivity, const vertex_triangle_adjacency& adjacency, buffer<vec3>& normals, bool invert=false);
+
+/** Compute per-vertex normals of a regular grid surface without going through its triangles.
+ *  The vertex (ku,kv) is stored at position[kv+Nv*ku], ku in [0,Nu[, kv in [0,Nv[.
+ *  The normal is the cross product of the central differences along u and v (one-sided differences on the border).
+ *  Its orientation matches the triangulation {idx, idx+1+Nv, idx+1}, {idx, idx+Nv, idx+1+Nv}. */
+void normal_grid(const buffer<vec3>& position, size_t Nu, size_t Nv, buffer<vec3>& normals, bool invert=false);
+
+
 vec3 center_of_mass(const mesh& shape);
 vec3 center_of_mass(const buffer<vec3>& position, const buffer<uint3>& connectivity);
 
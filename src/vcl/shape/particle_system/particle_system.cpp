@@ -0,0 +1,185 @@
+#include "particle_system.hpp"
+
+#include "vcl/base/rand/rand.hpp"
+#include "vcl/base/parallel/parallel.hpp"
+
+#include <limits>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VCL_PARTICLE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace vcl
+{
+
+// Particles integrated by a single task (multiple of 4)
+static size_t const particle_grain = 16384;
+
+// Integrate the particles [begin,end[ (begin is a multiple of 4, the arrays are padded to a multiple of 4)
+static void integrate_range(particle_system& s, size_t begin, size_t end, float dt)
+{
+    const float damping = 1.0f - dt*s.drag;
+    const vec3 dv = dt*s.gravity;
+
+    float* px = s.px.data(); float* py = s.py.data(); float* pz = s.pz.data();
+    float* vx = s.vx.data(); float* vy = s.vy.data(); float* vz = s.vz.data();
+    float* age = s.age.data();
+
+#ifdef VCL_PARTICLE_SSE
+    const __m128 m_damping = _mm_set1_ps(damping);
+    const __m128 m_dt = _mm_set1_ps(dt);
+    const __m128 m_dvx = _mm_set1_ps(dv.x);
+    const __m128 m_dvy = _mm_set1_ps(dv.y);
+    const __m128 m_dvz = _mm_set1_ps(dv.z);
+    for(size_t k=begin; k<end; k+=4)
+    {
+        // v = (1-dt*drag)*v + dt*g
+        const __m128 x = _mm_add_ps(_mm_mul_ps(_mm_load_ps(vx+k), m_damping), m_dvx);
+        const __m128 y = _mm_add_ps(_mm_mul_ps(_mm_load_ps(vy+k), m_damping), m_dvy);
+        const __m128 z = _mm_add_ps(_mm_mul_ps(_mm_load_ps(vz+k), m_damping), m_dvz);
+        _mm_store_ps(vx+k, x);
+        _mm_store_ps(vy+k, y);
+        _mm_store_ps(vz+k, z);
+
+        // p = p + dt*v
+        _mm_store_ps(px+k, _mm_add_ps(_mm_load_ps(px+k), _mm_mul_ps(m_dt, x)));
+        _mm_store_ps(py+k, _mm_add_ps(_mm_load_ps(py+k), _mm_mul_ps(m_dt, y)));
+        _mm_store_ps(pz+k, _mm_add_ps(_mm_load_ps(pz+k), _mm_mul_ps(m_dt, z)));
+        _mm_store_ps(age+k, _mm_add_ps(_mm_load_ps(age+k), m_dt));
+    }
+#else
+    for(size_t k=begin; k<end; ++k)
+    {
+        vx[k] = vx[k]*damping + dv.x;
+        vy[k] = vy[k]*damping + dv.y;
+        vz[k] = vz[k]*damping + dv.z;
+        px[k] += dt*vx[k];
+        py[k] += dt*vy[k];
+        pz[k] += dt*vz[k];
+        age[k] += dt;
+    }
+#endif
+}
+
+
+particle_system::particle_system(size_t capacity_arg)
+    :gravity(0.0f,0.0f,-9.81f),drag(0.0f),lifetime(0.0f),z_min(-std::numeric_limits<float>::infinity()),
+      px(),py(),pz(),vx(),vy(),vz(),age(),number_particles(0),max_particles(0)
+{
+    set_capacity(capacity_arg);
+}
+
+void particle_system::set_capacity(size_t capacity_arg)
+{
+    // Padded to a multiple of 4: the last packet can always be processed entirely
+    const size_t N = (capacity_arg+3) & ~size_t(3);
+    for(aligned_float_array* a : {&px,&py,&pz,&vx,&vy,&vz,&age}) {
+        a->assign(N, 0.0f);
+        a->shrink_to_fit();
+    }
+    number_particles = 0;
+    max_particles = capacity_arg;
+}
+
+size_t particle_system::capacity() const
+{
+    return max_particles;
+}
+
+size_t particle_system::size() const
+{
+    return number_particles;
+}
+
+void particle_system::clear()
+{
+    number_particles = 0;
+}
+
+bool particle_system::emit(const vec3& p, const vec3& v)
+{
+    if(number_particles>=capacity())
+        return false;
+
+    const size_t k = number_particles++;
+    px[k] = p.x; py[k] = p.y; pz[k] = p.z;
+    vx[k] = v.x; vy[k] = v.y; vz[k] = v.z;
+    age[k] = 0.0f;
+    return true;
+}
+
+void particle_system::integrate(float dt)
+{
+    const size_t N = (number_particles+3) & ~size_t(3);
+    if(N<=particle_grain)
+        integrate_range(*this, 0, N, dt);
+    else
+        default_task_pool().parallel_for(0, N/4, particle_grain/4, [this,dt](size_t begin, size_t end){
+            integrate_range(*this, 4*begin, 4*end, dt);
+        });
+}
+
+void particle_system::remove_dead()
+{
+    const bool check_age = lifetime>0.0f;
+    size_t k = 0;
+    while(k<number_particles)
+    {
+        if(pz[k]>=z_min && (!check_age || age[k]<=lifetime)) {
+            ++k;
+            continue;
+        }
+
+        // Move the last particle in the free slot (it is tested in the next iteration)
+        const size_t last = --number_particles;
+        px[k] = px[last]; py[k] = py[last]; pz[k] = pz[last];
+        vx[k] = vx[last]; vy[k] = vy[last]; vz[k] = vz[last];
+        age[k] = age[last];
+    }
+}
+
+vec3 particle_system::position(size_t k) const
+{
+    assert_vcl_no_msg(k<number_particles);
+    return {px[k], py[k], pz[k]};
+}
+
+vec3 particle_system::velocity(size_t k) const
+{
+    assert_vcl_no_msg(k<number_particles);
+    return {vx[k], vy[k], vz[k]};
+}
+
+
+particle_emitter::particle_emitter()
+    :position(),velocity(),velocity_spread(0.0f),rate(0.0f),accumulated(0.0f)
+{}
+
+size_t emit(particle_system& particles, particle_emitter& emitter, float dt)
+{
+    emitter.accumulated += emitter.rate*dt;
+    const size_t requested = static_cast<size_t>(emitter.accumulated);
+    emitter.accumulated -= float(requested);
+
+    // The new particles are written contiguously at the end of the arrays
+    const size_t begin = particles.size();
+    const size_t N = std::min(requested, particles.capacity()-begin);
+    const vec3& p = emitter.position;
+    const vec3& v = emitter.velocity;
+    const float r = emitter.velocity_spread;
+    for(size_t k=0; k<N; ++k)
+        particles.emit(p, {v.x+rand_interval(-r,r), v.y+rand_interval(-r,r), v.z+rand_interval(-r,r)});
+    return N;
+}
+
+void fill_instances(const particle_system& particles, buffer<mesh_instance>& instances, const mat3& rotation, float scaling)
+{
+    const size_t N = particles.size();
+    instances.resize(N);
+    for(size_t k=0; k<N; ++k)
+        instances[k] = mesh_instance({particles.px[k], particles.py[k], particles.pz[k]}, rotation, scaling);
+}
+
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "vcl/math/math.hpp"
+#include "vcl/containers/containers.hpp"
+#include "vcl/shape/mesh/instanced_mesh_drawable/instanced_mesh_drawable.hpp"
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace vcl
+{
+
+/** Allocator returning memory aligned on Alignment bytes (used for the SIMD particle arrays) */
+template <typename T, size_t Alignment>
+struct aligned_allocator
+{
+    typedef T value_type;
+    template <typename U> struct rebind { typedef aligned_allocator<U,Alignment> other; };
+
+    aligned_allocator() {}
+    template <typename U> aligned_allocator(const aligned_allocator<U,Alignment>&) {}
+
+    T* allocate(size_t n);
+    void deallocate(T* p, size_t n);
+};
+template <typename T, typename U, size_t A> bool operator==(const aligned_allocator<T,A>&, const aligned_allocator<U,A>&) { return true; }
+template <typename T, typename U, size_t A> bool operator!=(const aligned_allocator<T,A>&, const aligned_allocator<U,A>&) { return false; }
+
+/** Array of float aligned on 32 bytes */
+typedef std::vector<float, aligned_allocator<float,32> > aligned_float_array;
+
+
+/** Set of point particles with a fixed capacity, stored as structure of arrays.
+ *  Each coordinate of the positions and velocities, as well as the age, is stored in its own contiguous aligned array:
+ *  the integration step processes the particles by packets of 4 (SSE) and is spread over the default task pool for large sets.
+ *  Dead particles are removed by moving the last particle in their slot (the order of the particles is not preserved).
+ *  No allocation happens after set_capacity: emission fails silently when the system is full. */
+struct particle_system
+{
+    particle_system(size_t capacity=0);
+
+    /** Allocate the storage for the given number of particles (existing particles are removed) */
+    void set_capacity(size_t capacity);
+    /** Maximal number of particles, as given to set_capacity (the arrays are padded beyond it) */
+    size_t capacity() const;
+    /** Number of live particles */
+    size_t size() const;
+    /** Remove all the particles (the storage is kept) */
+    void clear();
+
+    /** Add a particle with the given position and velocity. Return false if the system is full. */
+    bool emit(const vec3& p, const vec3& v);
+
+    /** Semi-implicit Euler step for all the particles: v += dt*(gravity - drag*v), p += dt*v, age += dt */
+    void integrate(float dt);
+    /** Remove the particles below z_min or older than lifetime (if lifetime>0) */
+    void remove_dead();
+
+    /** Position/velocity of the particle k */
+    vec3 position(size_t k) const;
+    vec3 velocity(size_t k) const;
+
+    vec3 gravity;    // Acceleration applied to all the particles (default: (0,0,-9.81))
+    float drag;      // Linear drag coefficient (default: 0)
+    float lifetime;  // Maximal age of a particle, 0 for no limit (default: 0)
+    float z_min;     // Particles below this height are removed (default: -infinity)
+
+    aligned_float_array px, py, pz; // Positions
+    aligned_float_array vx, vy, vz; // Velocities
+    aligned_float_array age;        // Time since emission
+
+private:
+    size_t number_particles;
+    size_t max_particles;
+};
+
+/** Continuous source of particles: rate particles per second at position, with the velocity perturbed uniformly in a cube of half size velocity_spread */
+struct particle_emitter
+{
+    particle_emitter();
+
+    vec3 position;
+    vec3 velocity;
+    float velocity_spread;
+    float rate;
+
+    float accumulated;  // Fraction of particle not yet emitted
+};
+
+/** Emit the particles of the emitter for a time step dt. Return the number of emitted particles. */
+size_t emit(particle_system& particles, particle_emitter& emitter, float dt);
+
+/** Fill one instance per live particle (instances is resized to the number of particles) */
+void fill_instances(const particle_system& particles, buffer<mesh_instance>& instances, const mat3& rotation=mat3::identity(), float scaling=1.0f);
+
+}
+
+
+// Template implementation
+
+namespace vcl
+{
+
+template <typename T, size_t Alignment>
+T* aligned_allocator<T,Alignment>::allocate(size_t n)
+{
+    // The pointer returned by operator new is stored just before the aligned block
+    const size_t size = n*sizeof(T) + Alignment + sizeof(void*);
+    void* raw = ::operator new(size);
+    const uintptr_t start = reinterpret_cast<uintptr_t>(raw) + sizeof(void*);
+    const uintptr_t aligned = (start + Alignment - 1) & ~uintptr_t(Alignment - 1);
+    reinterpret_cast<void**>(aligned)[-1] = raw;
+    return reinterpret_cast<T*>(aligned);
+}
+
+template <typename T, size_t Alignment>
+void aligned_allocator<T,Alignment>::deallocate(T* p, size_t )
+{
+    if(p!=nullptr)
+        ::operator delete(reinterpret_cast<void**>(p)[-1]);
+}
+
+}
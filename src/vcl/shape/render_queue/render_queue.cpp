@@ -0,0 +1,287 @@
+#include "render_queue.hpp"
+
+#include "vcl/opengl/opengl.hpp"
+#include "vcl/base/sort/sort.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace vcl
+{
+
+static uint64_t opaque_key(const render_item& item)
+{
+    return (uint64_t(item.shader & 0x7FFFu) << 48) | (uint64_t(item.texture.id & 0xFFFFu) << 32) | uint64_t(item.data->vao);
+}
+
+static uint64_t transparent_key(const render_item& item)
+{
+    // Largest depth first: the depth bits are inverted
+    const uint32_t depth = ~float_sort_key(item.depth);
+    return (uint64_t(1) << 63) | (uint64_t(depth) << 31) | (uint64_t(item.shader & 0x7FFFu) << 16) | uint64_t(item.texture.id & 0xFFFFu);
+}
+
+static void apply_blend(render_blend blend)
+{
+    if(blend==render_blend::alpha) {
+        gl_state().set_capability(GL_BLEND, true);
+        gl_state().blend_function(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        gl_state().depth_mask(false);
+    }
+    else {
+        gl_state().set_capability(GL_BLEND, false);
+        gl_state().depth_mask(true);
+    }
+}
+
+// Switch to a new program, return false if it is not valid
+static bool use_program(GLuint shader, const camera_scene& camera)
+{
+    if( shader==0 || (shader!=gl_state().program() && glIsProgram(shader)==GL_FALSE) ) {
+        std::cout<<"Invalid shader ("<<shader<<") in render queue: skip display"<<std::endl;
+        return false;
+    }
+    gl_state().use_program(shader); opengl_debug();
+    uniform(shader, camera);         opengl_debug();
+    return true;
+}
+
+static void draw_item(const render_item& item, GLuint shader)
+{
+    uniform(shader, item.uniform); opengl_debug();
+    if(item.number_instances>0)
+        draw(*item.data, item.number_instances);
+    else
+        draw(*item.data);
+    opengl_debug();
+}
+
+
+render_texture::render_texture(GLuint id_arg)
+    :target(GL_TEXTURE_2D),id(id_arg)
+{}
+
+render_texture::render_texture(GLenum target_arg, GLuint id_arg)
+    :target(target_arg),id(id_arg)
+{}
+
+
+render_queue::render_queue()
+    :items(),order(),default_texture(0),default_texture_array(0),frustum_culling(true),counters()
+{}
+
+void render_queue::clear()
+{
+    items.clear();
+    order.clear();
+    counters.clear();
+}
+
+void render_queue::submit(const mesh_drawable& drawable, GLuint shader, render_texture texture, render_blend blend)
+{
+    submit(drawable, drawable.uniform.transform, shader, texture, blend);
+}
+
+void render_queue::submit(const mesh_drawable& drawable, const affine_transform& transform, GLuint shader, render_texture texture, render_blend blend)
+{
+    if(drawable.data.number_triangles==0)
+        return ;
+
+    render_item item;
+    item.data = &drawable.data;
+    item.uniform = drawable.uniform;
+    item.uniform.transform = transform;
+    item.heightfield = nullptr;
+    item.palette = nullptr;
+    item.number_instances = 0;
+    item.shader = (shader!=0)? shader : drawable.shader;
+    item.texture = texture;
+    item.blend = blend;
+    item.bounds = drawable.data.bounds;
+    item.depth = 0.0f;
+    item.key = 0;
+    items.push_back(item);
+}
+
+void render_queue::submit(const instanced_mesh_drawable& drawable, GLuint shader, render_texture texture, render_blend blend)
+{
+    if(drawable.data.number_triangles==0 || drawable.number_instances==0)
+        return ;
+
+    render_item item;
+    item.data = &drawable.data;
+    item.uniform = drawable.uniform;
+    item.heightfield = nullptr;
+    item.palette = nullptr;
+    item.number_instances = drawable.number_instances;
+    item.shader = (shader!=0)? shader : drawable.shader;
+    item.texture = texture;
+    item.blend = blend;
+    item.bounds = drawable.instance_bounds;
+    item.depth = 0.0f;
+    item.key = 0;
+    items.push_back(item);
+}
+
+void render_queue::submit(const heightfield_drawable& drawable, GLuint shader, render_texture texture, render_blend blend)
+{
+    if(drawable.data.number_triangles==0)
+        return ;
+
+    render_item item;
+    item.data = &drawable.data;
+    item.uniform = drawable.uniform;
+    item.heightfield = &drawable.heightfield;
+    item.palette = nullptr;
+    item.number_instances = 0;
+    item.shader = (shader!=0)? shader : drawable.shader;
+    item.texture = texture;
+    item.blend = blend;
+    item.bounds = displaced_bounding_volume(drawable);
+    item.depth = 0.0f;
+    item.key = 0;
+    items.push_back(item);
+}
+
+void render_queue::submit(const hierarchy_mesh_drawable& hierarchy, GLuint shader, render_texture texture, render_blend blend)
+{
+    for(const hierarchy_mesh_drawable_node& node : hierarchy.elements)
+        submit(node.element, node.global_transform * node.element.uniform.transform, shader, texture, blend);
+}
+
+void render_queue::submit(const hierarchy_mesh_palette_drawable& drawable, GLuint shader, render_texture texture, render_blend blend)
+{
+    if(drawable.data.number_triangles==0 || drawable.number_instances==0)
+        return ;
+
+    render_item item;
+    item.data = &drawable.data;
+    item.uniform = drawable.uniform;
+    item.heightfield = nullptr;
+    item.palette = &drawable;
+    item.number_instances = drawable.number_instances;
+    item.shader = (shader!=0)? shader : drawable.shader;
+    item.texture = texture;
+    item.blend = blend;
+    item.bounds = drawable.instance_bounds;
+    item.depth = 0.0f;
+    item.key = 0;
+    items.push_back(item);
+}
+
+void render_queue::sort(const camera_scene& camera)
+{
+    const vec3 camera_position = camera.camera_position();
+    const size_t N = items.size();
+
+    // Bounding volumes in world coordinates: spheres are tested in batch, the box test refines the remaining ones
+    std::vector<bounding_volume> volume(N);
+    std::vector<vec4> sphere(N);
+    std::vector<unsigned char> visible(N, 1);
+    if(frustum_culling)
+    {
+        const frustum f = camera_frustum(camera);
+        for(size_t k=0; k<N; ++k) {
+            volume[k] = transform(items[k].bounds, items[k].uniform.transform);
+            sphere[k] = {volume[k].center.x, volume[k].center.y, volume[k].center.z, volume[k].radius};
+        }
+        frustum_cull(f, sphere.data(), N, visible.data());
+        for(size_t k=0; k<N; ++k)
+            if(visible[k] && !is_visible(f, volume[k]))
+                visible[k] = 0;
+    }
+
+    order.clear();
+    for(size_t k=0; k<N; ++k)
+    {
+        counters.submitted++;
+        if(!visible[k]) {
+            counters.culled++;
+            continue;
+        }
+
+        render_item& item = items[k];
+        if(item.texture.id==0)
+            item.texture.id = (item.texture.target==GL_TEXTURE_2D_ARRAY)? default_texture_array : default_texture;
+
+        if(item.blend==render_blend::opaque)
+            item.key = opaque_key(item);
+        else {
+            const vec3 d = item.uniform.transform.translation - camera_position;
+            item.depth = dot(d,d);
+            item.key = transparent_key(item);
+        }
+        order.push_back(k);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b){ return items[a].key < items[b].key; });
+}
+
+size_t render_queue::size() const
+{
+    return items.size();
+}
+
+
+void draw(const render_queue& queue, const camera_scene& camera)
+{
+    draw(queue, camera, render_blend::opaque);
+    draw(queue, camera, render_blend::alpha);
+}
+
+void draw(const render_queue& queue, const camera_scene& camera, render_blend blend)
+{
+    GLuint current_shader = 0;
+    bool valid_shader = false;
+    for(size_t k : queue.order)
+    {
+        const render_item& item = queue.items[k];
+        if(item.blend!=blend)
+            continue;
+
+        if(item.shader!=current_shader || current_shader==0) {
+            current_shader = item.shader;
+            valid_shader = use_program(item.shader, camera);
+        }
+        if(!valid_shader)
+            continue;
+
+        gl_state().bind_texture(item.texture.target, item.texture.id); opengl_debug();
+        apply_blend(item.blend);
+        if(item.heightfield!=nullptr)
+            uniform(item.shader, *item.heightfield);
+        if(item.palette!=nullptr)
+            uniform(item.shader, *item.palette);
+
+        draw_item(item, item.shader);
+    }
+
+    // Leave the default opaque state
+    apply_blend(render_blend::opaque);
+}
+
+void draw(const render_queue& queue, const camera_scene& camera, GLuint shader, GLuint shader_instanced, GLuint shader_palette)
+{
+    GLuint current_shader = 0;
+    bool valid_shader = false;
+    for(size_t k : queue.order)
+    {
+        const render_item& item = queue.items[k];
+        if(item.heightfield!=nullptr || (item.palette!=nullptr && shader_palette==0))
+            continue;
+
+        const GLuint item_shader = (item.palette!=nullptr)? shader_palette : ((item.number_instances>0)? shader_instanced : shader);
+        if(item_shader!=current_shader || current_shader==0) {
+            current_shader = item_shader;
+            valid_shader = use_program(item_shader, camera);
+        }
+        if(!valid_shader)
+            continue;
+
+        if(item.palette!=nullptr)
+            uniform(item_shader, *item.palette);
+        draw_item(item, item_shader);
+    }
+}
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "vcl/shape/mesh/mesh_drawable/mesh_drawable.hpp"
+#include "vcl/shape/mesh/instanced_mesh_drawable/instanced_mesh_drawable.hpp"
+#include "vcl/shape/heightfield/heightfield_drawable/heightfield_drawable.hpp"
+#include "vcl/shape/hierarchy_mesh/hierarchy_mesh_drawable/hierarchy_mesh_drawable.hpp"
+#include "vcl/shape/hierarchy_mesh/hierarchy_mesh_palette_drawable/hierarchy_mesh_palette_drawable.hpp"
+#include "vcl/shape/culling/culling.hpp"
+
+#include <cstdint>
+
+namespace vcl
+{
+
+/** How an item is combined with the framebuffer
+ *  - opaque: no blending, writes the depth buffer
+ *  - alpha: color = alpha*current + (1-alpha)*previous, doesn't write the depth buffer */
+enum class render_blend {opaque, alpha};
+
+/** Texture bound for an item: a GL_TEXTURE_2D (implicit conversion from its id) or a GL_TEXTURE_2D_ARRAY.
+ *  Items sampling layers of the same texture array share the same binding: their layer is given by
+ *  mesh_drawable_uniform::texture_layer (shared by all the instances of an instanced drawable). */
+struct render_texture
+{
+    render_texture(GLuint id=0);
+    render_texture(GLenum target, GLuint id);
+
+    GLenum target;
+    GLuint id;
+};
+
+/** One draw call recorded in a render_queue.
+ *  The gpu data (and heightfield parameters) are referenced: the drawable must stay alive until the queue is drawn. */
+struct render_item
+{
+    const mesh_drawable_gpu_data* data;
+    mesh_drawable_uniform uniform;          // Copy of the uniform parameters, with the transformation of the item
+    const heightfield_uniform* heightfield; // Noise parameters of a heightfield (nullptr otherwise)
+    const hierarchy_mesh_palette_drawable* palette; // Matrix palette of a baked hierarchy (nullptr otherwise)
+    unsigned int number_instances;          // 0 for a non-instanced drawable
+    GLuint shader;
+    render_texture texture;
+    render_blend blend;
+    bounding_volume bounds;                 // Volume of the drawable before the item transformation
+
+    float depth;        // Squared distance to the camera (set by sort)
+    uint64_t key;       // Sort key (set by sort)
+};
+
+/** List of draw calls submitted by a scene, drawn in an order minimizing the state changes.
+ *  Usage at every frame: clear(), submit(...) all the objects, sort(camera), then draw(queue, camera).
+ *  Items outside of the view frustum of the camera are removed from the draw order by sort (if frustum_culling is true).
+ *  The sort key packs in 64 bits:
+ *   - Opaque items: [0 | shader (15 bits) | texture (16 bits) | vao (32 bits)], drawn first, grouped by shader, texture then VAO
+ *   - Transparent items: [1 | inverted depth (32 bits) | shader (15 bits) | texture (16 bits)], drawn afterwards from back to front
+ *  Items with equal keys are drawn in submission order. */
+struct render_queue
+{
+    render_queue();
+
+    /** Remove all the items (the storage is kept for the next frame) */
+    void clear();
+
+    /** Record a drawable with its own transformation, or with the one given as argument.
+     *  A shader equal to 0 uses the shader of the drawable, a texture equal to 0 uses default_texture (or default_texture_array). */
+    void submit(const mesh_drawable& drawable, GLuint shader, render_texture texture, render_blend blend=render_blend::opaque);
+    void submit(const mesh_drawable& drawable, const affine_transform& transform, GLuint shader, render_texture texture, render_blend blend=render_blend::opaque);
+    void submit(const instanced_mesh_drawable& drawable, GLuint shader, render_texture texture, render_blend blend=render_blend::opaque);
+    void submit(const heightfield_drawable& drawable, GLuint shader, render_texture texture, render_blend blend=render_blend::opaque);
+    /** Record every element of the hierarchy (global coordinates are expected to be up to date) */
+    void submit(const hierarchy_mesh_drawable& hierarchy, GLuint shader, render_texture texture, render_blend blend=render_blend::opaque);
+    /** Record all the instances of a baked hierarchy as a single item (the palette is expected to be uploaded) */
+    void submit(const hierarchy_mesh_palette_drawable& drawable, GLuint shader, render_texture texture, render_blend blend=render_blend::opaque);
+
+    /** Cull the items outside of the camera frustum, compute the depth and the key of the remaining ones and sort the draw order */
+    void sort(const camera_scene& camera);
+
+    /** Number of recorded items */
+    size_t size() const;
+
+    buffer<render_item> items;  // Items in submission order
+    buffer<size_t> order;       // Indices of the visible items in draw order (filled by sort)
+    GLuint default_texture;     // Texture bound for items without texture (typically a white image)
+    GLuint default_texture_array; // Same for the items without texture array (typically a single white layer)
+    bool frustum_culling;       // Skip the items outside of the view frustum (default: true)
+    culling_counters counters;  // Items submitted/culled since the last clear() (instances culled by the scene can be added)
+};
+
+/** Execute the sorted queue: the program, texture and blend state are only changed between items that differ */
+void draw(const render_queue& queue, const camera_scene& camera);
+/** Execute only the items with the given blend mode (draw(queue,camera) is the opaque pass followed by the alpha pass) */
+void draw(const render_queue& queue, const camera_scene& camera, render_blend blend);
+
+/** Replay the same list with override shaders (typically for a wireframe pass)
+ *  - Baked hierarchies are drawn with shader_palette (skipped if it is 0), instanced items with shader_instanced, the others with shader
+ *  - Heightfields are skipped (their displacement is computed by their own shader)
+ *  - Textures and blending are not modified */
+void draw(const render_queue& queue, const camera_scene& camera, GLuint shader, GLuint shader_instanced, GLuint shader_palette=0);
+
+}
@@ -1,10 +1,17 @@
 #include "segment_drawable_immediate_mode.hpp"
 
 #include "vcl/opengl/opengl.hpp"
+#include "vcl/shape/mesh/mesh_drawable/mesh_drawable.hpp"
 
 namespace vcl
 {
 
+// Interned names of the uniforms sent at each draw
+static const uniform_id id_color = uniform_id_of("color");
+static const uniform_id id_p1 = uniform_id_of("p1");
+static const uniform_id id_p2 = uniform_id_of("p2");
+
+
 segment_drawable_immediate_mode::segment_drawable_immediate_mode()
     :uniform_parameter({{0,0,0},{1,0,0},{1,0,0}}),data_gpu(),initialized(false)
 {}
@@ -26,19 +33,13 @@ void segment_drawable_immediate_mode::draw(GLuint shader, const camera_scene& ca
         exit(1);
     }
 
-                                                                    opengl_debug();
-    GLint current_shader = 0;                                       opengl_debug();
-    glGetIntegerv(GL_CURRENT_PROGRAM, &current_shader);             opengl_debug();
-
-    if(shader!=GLuint(current_shader))
-        glUseProgram(shader);                                       opengl_debug();
+    gl_state().use_program(shader);                                 opengl_debug();
 
-    uniform(shader, "color", uniform_parameter.color);              opengl_debug();
-    uniform(shader, "p1", uniform_parameter.p1);                    opengl_debug();
-    uniform(shader, "p2", uniform_parameter.p2);                    opengl_debug();
+    uniform(shader, id_color, uniform_parameter.color);             opengl_debug();
+    uniform(shader, id_p1, uniform_parameter.p1);                   opengl_debug();
+    uniform(shader, id_p2, uniform_parameter.p2);                   opengl_debug();
 
-    uniform(shader,"perspective",camera.perspective.matrix());      opengl_debug();
-    uniform(shader,"view",camera.view_matrix());                    opengl_debug();
+    uniform(shader, camera);                                        opengl_debug();
 
     vcl::draw(data_gpu);                                            opengl_debug();
 }
@@ -1,10 +1,18 @@
 #include "segments_drawable.hpp"
 
 #include "vcl/opengl/opengl.hpp"
+#include "vcl/shape/mesh/mesh_drawable/mesh_drawable.hpp"
 
 namespace vcl
 {
 
+// Interned names of the uniforms sent at each draw
+static const uniform_id id_rotation = uniform_id_of("rotation");
+static const uniform_id id_translation = uniform_id_of("translation");
+static const uniform_id id_scaling = uniform_id_of("scaling");
+static const uniform_id id_color = uniform_id_of("color");
+
+
 segments_drawable::segments_drawable()
     :uniform(),data(),shader(0)
 {}
@@ -22,28 +30,21 @@ void draw(const segments_drawable& shape, const camera_scene& camera)
 }
 void draw(const segments_drawable& shape, const camera_scene& camera, GLuint shader)
 {
-    // Check shader and only switch if necessary
-    if( glIsProgram(shader)==GL_FALSE ) {
+    // Check shader (only needed when switching program)
+    if( shader!=gl_state().program() && glIsProgram(shader)==GL_FALSE ) {
         std::cout<<"Try to display a mesh with invalid shader ("<<shader<<"): skip display"<<std::endl;
         return ;
     }
+    gl_state().use_program(shader);                                       opengl_debug();
 
-                                                                          opengl_debug();
-    GLint current_shader = 0;                                             opengl_debug();
-    glGetIntegerv(GL_CURRENT_PROGRAM, &current_shader);                   opengl_debug();
-
-    if(shader!=GLuint(current_shader))
-        glUseProgram(shader);                                             opengl_debug();
-
-    uniform(shader, "rotation", shape.uniform.transform.rotation);        opengl_debug();
-    uniform(shader, "translation", shape.uniform.transform.translation);  opengl_debug();
-    uniform(shader, "scaling", shape.uniform.transform.scaling);          opengl_debug();
+    uniform(shader, id_rotation, shape.uniform.transform.rotation);       opengl_debug();
+    uniform(shader, id_translation, shape.uniform.transform.translation); opengl_debug();
+    uniform(shader, id_scaling, shape.uniform.transform.scaling);         opengl_debug();
 
-    uniform(shader, "color", shape.uniform.color);                        opengl_debug();
+    uniform(shader, id_color, shape.uniform.color);                       opengl_debug();
 
 
-    uniform(shader,"perspective",camera.perspective.matrix());            opengl_debug();
-    uniform(shader,"view",camera.view_matrix());                          opengl_debug();
+    uniform(shader, camera);                                              opengl_debug();
 
     vcl::draw(shape.data);                                                opengl_debug();
 }
@@ -4,3 +4,8 @@
 #include "segment/segment.hpp"
 #include "curve/curve.hpp"
 #include "hierarchy_mesh/hierarchy_mesh.hpp"
+#include "heightfield/heightfield.hpp"
+#include "culling/culling.hpp"
+#include "render_queue/render_queue.hpp"
+#include "particle_system/particle_system.hpp"
+#include "asset_loader/asset_loader.hpp"
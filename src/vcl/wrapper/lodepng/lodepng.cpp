@@ -1,5 +1,7 @@
 #include "lodepng.hpp"
 
+#include "vcl/base/trace/trace.hpp"
+
 #include <iostream>
 
 namespace vcl
@@ -8,6 +10,7 @@ namespace vcl
 
 image_raw image_load_png(const std::string& filename, image_color_type color_type)
 {
+    VCL_TRACE_ZONE_DETAIL("image_load_png", filename);
     assert_file_exist(filename);
 
     LodePNGColorType lodepng_color_type;
@@ -1,7 +1,30 @@
 #include "perlin.hpp"
 
+#include "vcl/base/parallel/parallel.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define VCL_PERLIN_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(VCL_PERLIN_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define VCL_PERLIN_AVX2
+#define VCL_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+
+// Permutation table of the simplex noise (third_party/simplexnoise)
+extern unsigned char perm[512];
+
 namespace  vcl {
 
+// Simplex noise of snoise2 with indices wrapped by &255, shared by perlin() and the batched evaluation (defined below)
+static double simplex2(double x, double y);
+
 float perlin(float x, int octave, float persistency, float frequency_gain)
 {
     float value = 0.0f;
@@ -24,7 +47,7 @@ float perlin(float x, float y, int octave, float persistency, float frequency_ga
     float f = 1.0f; // current frequency
     for(int k=0;k<octave;k++)
     {
-        const float n = static_cast<float>(snoise2(x*f, y*f));
+        const float n = static_cast<float>(simplex2(x*f, y*f));
         value += a*(0.5f+0.5f*n );
         f *= frequency_gain;
         a *= persistency;
@@ -46,4 +69,398 @@ float perlin(float x, float y, float z, int octave, float persistency, float fre
     return value;
 }
 
+
+
+
+/* ************************************************** */
+/*           Batched 2D evaluation                    */
+/* ************************************************** */
+
+// The batched evaluation follows exactly the arithmetic of snoise2 (double precision, same operation order),
+//  such that scalar and SIMD paths produce bit-identical values.
+// The only difference with snoise2 is the wrapping of the lattice indices (i&255 instead of i%256),
+//  which avoids out of bound accesses of the permutation table when the floor is negative (negative coordinates, and 0 whose floor is -1).
+// perlin(x,y) uses the same function: the batched results are equal to it for every coordinate.
+
+static double const simplex_F2 = 0.366025403; // 0.5*(sqrt(3.0)-1.0)
+static double const simplex_G2 = 0.211324865; // (3.0-sqrt(3.0))/6.0
+
+static inline int simplex_floor(double x)
+{
+    return x>0 ? int(x) : int(x)-1;
+}
+
+static inline double simplex_grad2(int hash, double x, double y)
+{
+    int const h = hash & 7;
+    double const u = h<4 ? x : y;
+    double const v = h<4 ? y : x;
+    return ((h&1)? -u : u) + ((h&2)? -2.0*v : 2.0*v);
+}
+
+static double simplex2(double x, double y)
+{
+    double const s = (x+y)*simplex_F2;
+    int const i = simplex_floor(x + s);
+    int const j = simplex_floor(y + s);
+
+    double const t = double(i+j)*simplex_G2;
+    double const x0 = x-(i-t);
+    double const y0 = y-(j-t);
+
+    int const i1 = x0>y0 ? 1 : 0;
+    int const j1 = 1-i1;
+
+    double const x1 = x0 - i1 + simplex_G2;
+    double const y1 = y0 - j1 + simplex_G2;
+    double const x2 = x0 - 1.0 + 2.0*simplex_G2;
+    double const y2 = y0 - 1.0 + 2.0*simplex_G2;
+
+    int const ii = i & 255;
+    int const jj = j & 255;
+
+    double n0 = 0.0, n1 = 0.0, n2 = 0.0;
+    double t0 = 0.5 - x0*x0 - y0*y0;
+    if(t0 >= 0.0) {
+        t0 *= t0;
+        n0 = t0 * t0 * simplex_grad2(perm[ii+perm[jj]], x0, y0);
+    }
+    double t1 = 0.5 - x1*x1 - y1*y1;
+    if(t1 >= 0.0) {
+        t1 *= t1;
+        n1 = t1 * t1 * simplex_grad2(perm[ii+i1+perm[jj+j1]], x1, y1);
+    }
+    double t2 = 0.5 - x2*x2 - y2*y2;
+    if(t2 >= 0.0) {
+        t2 *= t2;
+        n2 = t2 * t2 * simplex_grad2(perm[ii+1+perm[jj+1]], x2, y2);
+    }
+
+    return 40.0 * (n0 + n1 + n2);
+}
+
+static void perlin_kernel_scalar(const float* x, const float* y, float* out, size_t N, int octave, float persistency, float frequency_gain)
+{
+    for(size_t k=0; k<N; ++k)
+        out[k] = perlin(x[k], y[k], octave, persistency, frequency_gain);
+}
+
+
+#ifdef VCL_PERLIN_SSE2
+
+// Permutation table stored as int (allows direct gather)
+static int const* perm_int()
+{
+    static std::vector<int> const table(perm, perm+512);
+    return table.data();
+}
+
+static inline __m128d sse2_select(__m128d mask, __m128d a, __m128d b) // mask ? a : b
+{
+    return _mm_or_pd(_mm_and_pd(mask,a), _mm_andnot_pd(mask,b));
+}
+
+static inline __m128d sse2_floor(__m128d x)
+{
+    __m128d const r = _mm_cvtepi32_pd(_mm_cvttpd_epi32(x));
+    return _mm_sub_pd(r, _mm_and_pd(_mm_cmple_pd(x,_mm_setzero_pd()), _mm_set1_pd(1.0)));
+}
+
+static inline __m128d sse2_grad2(__m128i hash, __m128d x, __m128d y)
+{
+    __m128i const h = _mm_and_si128(hash, _mm_set1_epi32(7));
+    __m128d const h_lt4 = _mm_cmplt_pd(_mm_cvtepi32_pd(h), _mm_set1_pd(4.0));
+    __m128d const h_1 = _mm_cmpneq_pd(_mm_cvtepi32_pd(_mm_and_si128(h,_mm_set1_epi32(1))), _mm_setzero_pd());
+    __m128d const h_2 = _mm_cmpneq_pd(_mm_cvtepi32_pd(_mm_and_si128(h,_mm_set1_epi32(2))), _mm_setzero_pd());
+    __m128d const sign = _mm_set1_pd(-0.0);
+
+    __m128d const u = sse2_select(h_lt4, x, y);
+    __m128d const v = _mm_mul_pd(_mm_set1_pd(2.0), sse2_select(h_lt4, y, x));
+    return _mm_add_pd(_mm_xor_pd(u, _mm_and_pd(h_1,sign)), _mm_xor_pd(v, _mm_and_pd(h_2,sign)));
+}
+
+static inline __m128i sse2_lookup(int const* table, __m128i index)
+{
+    alignas(16) int k[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(k), index);
+    return _mm_setr_epi32(table[k[0]], table[k[1]], 0, 0);
+}
+
+static inline __m128d sse2_corner(__m128d x, __m128d y, __m128i hash)
+{
+    __m128d t = _mm_sub_pd(_mm_sub_pd(_mm_set1_pd(0.5), _mm_mul_pd(x,x)), _mm_mul_pd(y,y));
+    __m128d const outside = _mm_cmplt_pd(t, _mm_setzero_pd());
+    t = _mm_mul_pd(t,t);
+    __m128d const n = _mm_mul_pd(_mm_mul_pd(t,t), sse2_grad2(hash,x,y));
+    return _mm_andnot_pd(outside, n);
+}
+
+// Simplex noise on 2 lanes
+static __m128d sse2_simplex2(__m128d x, __m128d y)
+{
+    int const* table = perm_int();
+    __m128d const one = _mm_set1_pd(1.0);
+    __m128d const G2 = _mm_set1_pd(simplex_G2);
+
+    __m128d const s = _mm_mul_pd(_mm_add_pd(x,y), _mm_set1_pd(simplex_F2));
+    __m128d const i = sse2_floor(_mm_add_pd(x,s));
+    __m128d const j = sse2_floor(_mm_add_pd(y,s));
+
+    __m128d const t = _mm_mul_pd(_mm_add_pd(i,j), G2);
+    __m128d const x0 = _mm_sub_pd(x, _mm_sub_pd(i,t));
+    __m128d const y0 = _mm_sub_pd(y, _mm_sub_pd(j,t));
+
+    __m128d const lower = _mm_cmpgt_pd(x0,y0);
+    __m128d const i1 = _mm_and_pd(lower, one);
+    __m128d const j1 = _mm_andnot_pd(lower, one);
+
+    __m128d const x1 = _mm_add_pd(_mm_sub_pd(x0,i1), G2);
+    __m128d const y1 = _mm_add_pd(_mm_sub_pd(y0,j1), G2);
+    __m128d const x2 = _mm_add_pd(_mm_sub_pd(x0,one), _mm_set1_pd(2.0*simplex_G2));
+    __m128d const y2 = _mm_add_pd(_mm_sub_pd(y0,one), _mm_set1_pd(2.0*simplex_G2));
+
+    __m128i const mask = _mm_set1_epi32(255);
+    __m128i const ii = _mm_and_si128(_mm_cvttpd_epi32(i), mask);
+    __m128i const jj = _mm_and_si128(_mm_cvttpd_epi32(j), mask);
+    __m128i const i1i = _mm_cvttpd_epi32(i1);
+    __m128i const j1i = _mm_cvttpd_epi32(j1);
+    __m128i const one_i = _mm_set1_epi32(1);
+
+    __m128i const h0 = sse2_lookup(table, _mm_add_epi32(ii, sse2_lookup(table, jj)));
+    __m128i const h1 = sse2_lookup(table, _mm_add_epi32(_mm_add_epi32(ii,i1i), sse2_lookup(table, _mm_add_epi32(jj,j1i))));
+    __m128i const h2 = sse2_lookup(table, _mm_add_epi32(_mm_add_epi32(ii,one_i), sse2_lookup(table, _mm_add_epi32(jj,one_i))));
+
+    __m128d const n0 = sse2_corner(x0,y0,h0);
+    __m128d const n1 = sse2_corner(x1,y1,h1);
+    __m128d const n2 = sse2_corner(x2,y2,h2);
+
+    return _mm_mul_pd(_mm_set1_pd(40.0), _mm_add_pd(_mm_add_pd(n0,n1),n2));
+}
+
+static void perlin_kernel_sse2(const float* x, const float* y, float* out, size_t N, int octave, float persistency, float frequency_gain)
+{
+    size_t k=0;
+    for(; k+4<=N; k+=4)
+    {
+        __m128 const px = _mm_loadu_ps(x+k);
+        __m128 const py = _mm_loadu_ps(y+k);
+        __m128 const half = _mm_set1_ps(0.5f);
+        __m128 value = _mm_setzero_ps();
+        float a = 1.0f;
+        float f = 1.0f;
+        for(int o=0; o<octave; ++o)
+        {
+            __m128 const fx = _mm_mul_ps(px, _mm_set1_ps(f));
+            __m128 const fy = _mm_mul_ps(py, _mm_set1_ps(f));
+            __m128d const n_low  = sse2_simplex2(_mm_cvtps_pd(fx), _mm_cvtps_pd(fy));
+            __m128d const n_high = sse2_simplex2(_mm_cvtps_pd(_mm_movehl_ps(fx,fx)), _mm_cvtps_pd(_mm_movehl_ps(fy,fy)));
+            __m128 const n = _mm_movelh_ps(_mm_cvtpd_ps(n_low), _mm_cvtpd_ps(n_high));
+
+            value = _mm_add_ps(value, _mm_mul_ps(_mm_set1_ps(a), _mm_add_ps(half, _mm_mul_ps(half,n))));
+            f *= frequency_gain;
+            a *= persistency;
+        }
+        _mm_storeu_ps(out+k, value);
+    }
+    perlin_kernel_scalar(x+k, y+k, out+k, N-k, octave, persistency, frequency_gain);
+}
+#endif
+
+
+#ifdef VCL_PERLIN_AVX2
+
+VCL_TARGET_AVX2 static inline __m256d avx2_floor(__m256d x)
+{
+    __m256d const r = _mm256_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    return _mm256_sub_pd(r, _mm256_and_pd(_mm256_cmp_pd(x,_mm256_setzero_pd(),_CMP_LE_OQ), _mm256_set1_pd(1.0)));
+}
+
+VCL_TARGET_AVX2 static inline __m256d avx2_grad2(__m128i hash, __m256d x, __m256d y)
+{
+    __m128i const h = _mm_and_si128(hash, _mm_set1_epi32(7));
+    __m256d const h_lt4 = _mm256_cmp_pd(_mm256_cvtepi32_pd(h), _mm256_set1_pd(4.0), _CMP_LT_OQ);
+    __m256d const h_1 = _mm256_cmp_pd(_mm256_cvtepi32_pd(_mm_and_si128(h,_mm_set1_epi32(1))), _mm256_setzero_pd(), _CMP_NEQ_OQ);
+    __m256d const h_2 = _mm256_cmp_pd(_mm256_cvtepi32_pd(_mm_and_si128(h,_mm_set1_epi32(2))), _mm256_setzero_pd(), _CMP_NEQ_OQ);
+    __m256d const sign = _mm256_set1_pd(-0.0);
+
+    __m256d const u = _mm256_blendv_pd(y, x, h_lt4);
+    __m256d const v = _mm256_mul_pd(_mm256_set1_pd(2.0), _mm256_blendv_pd(x, y, h_lt4));
+    return _mm256_add_pd(_mm256_xor_pd(u, _mm256_and_pd(h_1,sign)), _mm256_xor_pd(v, _mm256_and_pd(h_2,sign)));
+}
+
+VCL_TARGET_AVX2 static inline __m256d avx2_corner(__m256d x, __m256d y, __m128i hash)
+{
+    __m256d t = _mm256_sub_pd(_mm256_sub_pd(_mm256_set1_pd(0.5), _mm256_mul_pd(x,x)), _mm256_mul_pd(y,y));
+    __m256d const outside = _mm256_cmp_pd(t, _mm256_setzero_pd(), _CMP_LT_OQ);
+    t = _mm256_mul_pd(t,t);
+    __m256d const n = _mm256_mul_pd(_mm256_mul_pd(t,t), avx2_grad2(hash,x,y));
+    return _mm256_andnot_pd(outside, n);
+}
+
+// Simplex noise on 4 lanes
+VCL_TARGET_AVX2 static __m256d avx2_simplex2(__m256d x, __m256d y)
+{
+    int const* table = perm_int();
+    __m256d const one = _mm256_set1_pd(1.0);
+    __m256d const G2 = _mm256_set1_pd(simplex_G2);
+
+    __m256d const s = _mm256_mul_pd(_mm256_add_pd(x,y), _mm256_set1_pd(simplex_F2));
+    __m256d const i = avx2_floor(_mm256_add_pd(x,s));
+    __m256d const j = avx2_floor(_mm256_add_pd(y,s));
+
+    __m256d const t = _mm256_mul_pd(_mm256_add_pd(i,j), G2);
+    __m256d const x0 = _mm256_sub_pd(x, _mm256_sub_pd(i,t));
+    __m256d const y0 = _mm256_sub_pd(y, _mm256_sub_pd(j,t));
+
+    __m256d const lower = _mm256_cmp_pd(x0,y0,_CMP_GT_OQ);
+    __m256d const i1 = _mm256_and_pd(lower, one);
+    __m256d const j1 = _mm256_andnot_pd(lower, one);
+
+    __m256d const x1 = _mm256_add_pd(_mm256_sub_pd(x0,i1), G2);
+    __m256d const y1 = _mm256_add_pd(_mm256_sub_pd(y0,j1), G2);
+    __m256d const x2 = _mm256_add_pd(_mm256_sub_pd(x0,one), _mm256_set1_pd(2.0*simplex_G2));
+    __m256d const y2 = _mm256_add_pd(_mm256_sub_pd(y0,one), _mm256_set1_pd(2.0*simplex_G2));
+
+    __m128i const mask = _mm_set1_epi32(255);
+    __m128i const ii = _mm_and_si128(_mm256_cvttpd_epi32(i), mask);
+    __m128i const jj = _mm_and_si128(_mm256_cvttpd_epi32(j), mask);
+    __m128i const i1i = _mm256_cvttpd_epi32(i1);
+    __m128i const j1i = _mm256_cvttpd_epi32(j1);
+    __m128i const one_i = _mm_set1_epi32(1);
+
+    __m128i const h0 = _mm_i32gather_epi32(table, _mm_add_epi32(ii, _mm_i32gather_epi32(table, jj, 4)), 4);
+    __m128i const h1 = _mm_i32gather_epi32(table, _mm_add_epi32(_mm_add_epi32(ii,i1i), _mm_i32gather_epi32(table, _mm_add_epi32(jj,j1i), 4)), 4);
+    __m128i const h2 = _mm_i32gather_epi32(table, _mm_add_epi32(_mm_add_epi32(ii,one_i), _mm_i32gather_epi32(table, _mm_add_epi32(jj,one_i), 4)), 4);
+
+    __m256d const n0 = avx2_corner(x0,y0,h0);
+    __m256d const n1 = avx2_corner(x1,y1,h1);
+    __m256d const n2 = avx2_corner(x2,y2,h2);
+
+    return _mm256_mul_pd(_mm256_set1_pd(40.0), _mm256_add_pd(_mm256_add_pd(n0,n1),n2));
+}
+
+VCL_TARGET_AVX2 static void perlin_kernel_avx2(const float* x, const float* y, float* out, size_t N, int octave, float persistency, float frequency_gain)
+{
+    size_t k=0;
+    for(; k+4<=N; k+=4)
+    {
+        __m128 const px = _mm_loadu_ps(x+k);
+        __m128 const py = _mm_loadu_ps(y+k);
+        __m128 const half = _mm_set1_ps(0.5f);
+        __m128 value = _mm_setzero_ps();
+        float a = 1.0f;
+        float f = 1.0f;
+        for(int o=0; o<octave; ++o)
+        {
+            __m128 const fx = _mm_mul_ps(px, _mm_set1_ps(f));
+            __m128 const fy = _mm_mul_ps(py, _mm_set1_ps(f));
+            __m128 const n = _mm256_cvtpd_ps(avx2_simplex2(_mm256_cvtps_pd(fx), _mm256_cvtps_pd(fy)));
+
+            value = _mm_add_ps(value, _mm_mul_ps(_mm_set1_ps(a), _mm_add_ps(half, _mm_mul_ps(half,n))));
+            f *= frequency_gain;
+            a *= persistency;
+        }
+        _mm_storeu_ps(out+k, value);
+    }
+    perlin_kernel_scalar(x+k, y+k, out+k, N-k, octave, persistency, frequency_gain);
+}
+#endif
+
+
+perlin_simd perlin_simd_supported()
+{
+#if defined(VCL_PERLIN_AVX2)
+    if(__builtin_cpu_supports("avx2"))
+        return perlin_simd::avx2;
+#endif
+#if defined(VCL_PERLIN_SSE2)
+    return perlin_simd::sse2;
+#else
+    return perlin_simd::scalar;
+#endif
+}
+
+// Can be changed by perlin_set_simd while a batched evaluation runs on other threads
+static std::atomic<perlin_simd> perlin_simd_level(perlin_simd_supported());
+
+perlin_simd perlin_simd_current()
+{
+    return perlin_simd_level.load();
+}
+
+void perlin_set_simd(perlin_simd level)
+{
+    perlin_simd const supported = perlin_simd_supported();
+    perlin_simd_level = int(level)<=int(supported) ? level : supported;
+}
+
+static void perlin_kernel(perlin_simd level, const float* x, const float* y, float* out, size_t N, int octave, float persistency, float frequency_gain)
+{
+    switch(level)
+    {
+#ifdef VCL_PERLIN_AVX2
+    case perlin_simd::avx2:
+        perlin_kernel_avx2(x, y, out, N, octave, persistency, frequency_gain);
+        return;
+#endif
+#ifdef VCL_PERLIN_SSE2
+    case perlin_simd::sse2:
+        perlin_kernel_sse2(x, y, out, N, octave, persistency, frequency_gain);
+        return;
+#endif
+    default:
+        perlin_kernel_scalar(x, y, out, N, octave, persistency, frequency_gain);
+    }
+}
+
+// Approximate number of points evaluated by one task of the pool
+static size_t const perlin_parallel_grain = 4096;
+
+void perlin_grid(buffer2D<float>& out, float u0, float v0, float du, float dv, int octave, float persistency, float frequency_gain)
+{
+    size_t const Nu = out.dimension[0];
+    size_t const Nv = out.dimension[1];
+    if(Nu==0 || Nv==0)
+        return;
+
+    // The grid is evaluated by tiles of rows (contiguous along the first dimension) spread over the task pool,
+    //  all with the instruction set selected at the call
+    perlin_simd const level = perlin_simd_level.load();
+    std::vector<float> x(Nu);
+    for(size_t ku=0; ku<Nu; ++ku)
+        x[ku] = u0 + ku*du;
+
+    size_t const grain = std::max<size_t>(1, perlin_parallel_grain/Nu);
+    parallel_for(0, Nv, grain, [&](size_t kv_begin, size_t kv_end)
+    {
+        std::vector<float> y(Nu);
+        for(size_t kv=kv_begin; kv<kv_end; ++kv)
+        {
+            std::fill(y.begin(), y.end(), v0 + kv*dv);
+            perlin_kernel(level, x.data(), y.data(), &out.data[Nu*kv], Nu, octave, persistency, frequency_gain);
+        }
+    });
+}
+
+void perlin_points(const buffer<vec2>& p, buffer<float>& out, int octave, float persistency, float frequency_gain)
+{
+    size_t const N = p.size();
+    if(out.size()!=N)
+        out.resize(N);
+    if(N==0)
+        return;
+
+    perlin_simd const level = perlin_simd_level.load();
+    std::vector<float> x(N);
+    std::vector<float> y(N);
+    for(size_t k=0; k<N; ++k) {
+        x[k] = p[k].x;
+        y[k] = p[k].y;
+    }
+    parallel_for(0, N, perlin_parallel_grain, [&](size_t k_begin, size_t k_end)
+    {
+        perlin_kernel(level, &x[k_begin], &y[k_begin], &out[k_begin], k_end-k_begin, octave, persistency, frequency_gain);
+    });
+}
+
 }
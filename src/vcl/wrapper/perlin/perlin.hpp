@@ -2,10 +2,39 @@
 
 #include "third_party/simplexnoise/simplexnoise1234.hpp"
 
+#include "vcl/containers/buffer/buffer.hpp"
+#include "vcl/math/vec/vec2/vec2.hpp"
+
 namespace  vcl {
 
 float perlin(float x, int octave=5, float persistency=0.3f, float frequency_gain=2.0f);
 float perlin(float x, float y, int octave=5, float persistency=0.3f, float frequency_gain=2.0f);
 float perlin(float x, float y, float z, int octave=5, float persistency=0.3f, float frequency_gain=2.0f);
 
+
+/** Instruction set used by the batched 2D Perlin evaluation (perlin_grid, perlin_points) */
+enum class perlin_simd {scalar, sse2, avx2};
+
+/** Best instruction set available on the current CPU */
+perlin_simd perlin_simd_supported();
+/** Instruction set currently used by the batched evaluation (default: perlin_simd_supported()) */
+perlin_simd perlin_simd_current();
+/** Force the instruction set used by the batched evaluation (clamped to the supported one).
+ *  All levels return bit-identical results, this is mostly used for testing and benchmarking. */
+void perlin_set_simd(perlin_simd level);
+
+
+/** Evaluate 2D Perlin noise on a regular grid in a single call
+ *  out(ku,kv) = perlin(u0+ku*du, v0+kv*dv, octave, persistency, frequency_gain)
+ *  The dimension of the grid is given by out.dimension.
+ *  Points are evaluated by packets of 4 using SSE2/AVX2 when available (selected at runtime),
+ *  tiles of rows are spread over the default task pool.
+ *  Results are bit-identical to perlin(x,y) for all coordinates. */
+void perlin_grid(buffer2D<float>& out, float u0, float v0, float du, float dv, int octave=5, float persistency=0.3f, float frequency_gain=2.0f);
+
+/** Evaluate 2D Perlin noise on a list of points
+ *  out[k] = perlin(p[k].x, p[k].y, octave, persistency, frequency_gain)
+ *  out is resized to the number of points if needed. */
+void perlin_points(const buffer<vec2>& p, buffer<float>& out, int octave=5, float persistency=0.3f, float frequency_gain=2.0f);
+
 }